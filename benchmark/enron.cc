@@ -1,17 +1,39 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <random>
 #include <set>
+#include <vector>
 #include <string>
 #include <fstream>
 #include <chrono>
+#include <thread>
 
 #include <cedar_config.h>
 #include <cedar.h>
+#include <cedar_aho.h>
+#include <cedar_concurrent.h>
+#include <cedar_sharded.h>
+
+#include <gflags/gflags.h>
+
+DEFINE_bool(batch, false, "compare batched and one-at-a-time exactMatchSearch ()");
+DEFINE_int32(threads, 0, "also time ingest into sharded_da with 1, 2, 4, ... up to"
+		" this many threads");
+DEFINE_int32(readers, 0, "also time lookups in concurrent_da by 1, 2, 4, ... up to"
+		" this many readers while a writer keeps inserting");
+DEFINE_bool(scan, false, "find every unique word in the files by aho_corasick::scan ()"
+		" and by commonPrefixSearch () at each byte");
 
 using Trie = cedar::da<int>;
+using ShardedTrie = cedar::sharded_da<int, 64>;
+using ConcurrentTrie = cedar::concurrent_da<int>;
 
 void usage(const char* namep) {
 	std::cerr << "Usage:" << std::endl
-		<< "\t" << namep << " <file containing list of files>"
+		<< "\t" << namep << " [--batch] [--threads=N] [--readers=N] [--scan] <file containing list of files>"
 		<< std::endl;
 }
 
@@ -59,7 +81,190 @@ int add_in_trie(Trie& trie, std::set<std::string>& words,
 	return 0;
 }
 
+/*
+ * File contents are read up front so that only tokenizing and insertion are
+ * timed; thread i ingests files i, i + nthreads, i + 2 * nthreads, ...
+ */
+int64_t sharded_insert_time(const std::vector<std::string>& contents,
+		const int nthreads, size_t& nkeys) {
+	ShardedTrie trie;
+	auto s = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < nthreads; ++i) {
+		threads.emplace_back([&contents, &trie, nthreads, i] () {
+			for (size_t f = i; f < contents.size(); f += nthreads) {
+				const auto& content = contents[f];
+				size_t b = 0;
+				while (b < content.size()) {
+					size_t e = content.find_first_of(" \n", b);
+					if (e == std::string::npos) {
+						e = content.size();
+					}
+					if (e != b) {
+						trie.update(content.data() + b, e - b);
+					}
+					b = e + 1;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	auto e = std::chrono::high_resolution_clock::now();
+	nkeys = trie.num_keys();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+}
+
+void report_sharded(const std::string& filename) {
+	std::vector<std::string> contents;
+	std::ifstream ifs(filename);
+	for (std::string line; std::getline(ifs, line); ) {
+		std::ifstream file(line);
+		contents.emplace_back(std::istreambuf_iterator<char>(file),
+			std::istreambuf_iterator<char>());
+	}
+
+	int64_t base_time = 0;
+	for (int nthreads = 1; ; nthreads = std::min(nthreads * 2, FLAGS_threads)) {
+		size_t nkeys = 0;
+		auto t = sharded_insert_time(contents, nthreads, nkeys);
+		if (nthreads == 1) {
+			base_time = t;
+		}
+		std::cout << "Sharded insertion time with " << nthreads
+			<< " threads in nanoseconds " << t << " (speedup "
+			<< static_cast<double>(base_time) / t << ", " << nkeys
+			<< " unique words)" << std::endl;
+		if (nthreads == FLAGS_threads) {
+			break;
+		}
+	}
+}
+
+/*
+ * Half of the unique words are inserted up front, and each reader looks
+ * all of them up once, starting at its own offset, while the writer keeps
+ * inserting the other half (and adding to their values once all are in)
+ */
+int64_t concurrent_lookup_time(const std::vector<std::string>& keys,
+		const int nreaders, size_t& nupdates) {
+	ConcurrentTrie trie;
+	const size_t half = keys.size() / 2;
+	for (size_t i = 0; i < half; ++i) {
+		trie.update(keys[i].c_str(), keys[i].length(), 1);
+	}
+	std::atomic<bool> done{false};
+	nupdates = 0;
+	std::thread writer([&keys, &trie, &done, &nupdates, half] () {
+		for (size_t i = half; ! done.load(); i = i + 1 < keys.size() ? i + 1 : half) {
+			trie.update(keys[i].c_str(), keys[i].length(), 1);
+			++nupdates;
+		}
+	});
+
+	std::atomic<size_t> nfound{0};
+	auto s = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> readers;
+	for (int r = 0; r < nreaders; ++r) {
+		readers.emplace_back([&keys, &trie, &nfound, half, nreaders, r] () {
+			size_t n = 0;
+			for (size_t j = 0, i = half * r / nreaders; j < half; ++j, i = i + 1 < half ? i + 1 : 0) {
+				n += trie.exactMatchSearch<int>(keys[i].c_str(), keys[i].length()) >= 0;
+			}
+			nfound += n;
+		});
+	}
+	for (auto& reader : readers) {
+		reader.join();
+	}
+	auto e = std::chrono::high_resolution_clock::now();
+	done.store(true);
+	writer.join();
+	if (nfound != half * nreaders) {
+		std::cerr << "Only " << nfound << " of " << half * nreaders
+			<< " concurrent lookups found" << std::endl;
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+}
+
+void report_concurrent(const std::set<std::string>& words) {
+	/* in random order, so that halves do not split the trie by prefix */
+	std::vector<std::string> keys(words.begin(), words.end());
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+
+	double base_rate = 0;
+	for (int nreaders = 1; ; nreaders = std::min(nreaders * 2, FLAGS_readers)) {
+		size_t nupdates = 0;
+		auto t = concurrent_lookup_time(keys, nreaders, nupdates);
+		const double rate = static_cast<double>(keys.size() / 2) * nreaders * 1e9 / t;
+		if (nreaders == 1) {
+			base_rate = rate;
+		}
+		std::cout << "Concurrent lookups per second with " << nreaders
+			<< " readers " << rate << " (speedup " << rate / base_rate
+			<< ", " << nupdates << " updates by the writer meanwhile)" << std::endl;
+		if (nreaders == FLAGS_readers) {
+			break;
+		}
+	}
+}
+
+/*
+ * Every unique word is a pattern, and the files are the text: each byte
+ * ends several of them, so this mostly times reporting occurrences.
+ */
+void report_scan(const Trie& trie, const std::string& filename) {
+	std::vector<std::string> contents;
+	std::ifstream ifs(filename);
+	size_t nbytes = 0;
+	for (std::string line; std::getline(ifs, line); ) {
+		std::ifstream file(line);
+		contents.emplace_back(std::istreambuf_iterator<char>(file),
+			std::istreambuf_iterator<char>());
+		nbytes += contents.back().size();
+	}
+
+	auto s = std::chrono::high_resolution_clock::now();
+	cedar::aho_corasick<Trie> aho(trie);
+	auto e = std::chrono::high_resolution_clock::now();
+	auto build_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+
+	size_t nscan = 0;
+	s = std::chrono::high_resolution_clock::now();
+	for (const auto& content : contents) {
+		nscan += aho.scan(content.data(), content.size(),
+			[] (size_t, size_t, int) { return true; });
+	}
+	e = std::chrono::high_resolution_clock::now();
+	auto scan_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+
+	size_t nsearch = 0;
+	s = std::chrono::high_resolution_clock::now();
+	for (const auto& content : contents) {
+		for (size_t i = 0; i < content.size(); ++i) {
+			nsearch += trie.commonPrefixSearch(content.data() + i, content.size() - i,
+				[] (int, size_t, size_t) { return true; });
+		}
+	}
+	e = std::chrono::high_resolution_clock::now();
+	auto search_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+	if (nscan != nsearch) {
+		std::cerr << "scan () found " << nscan << " occurrences, commonPrefixSearch () "
+			<< nsearch << std::endl;
+	}
+
+	std::cout << "Aho-Corasick links in bytes " << aho.total_size()
+			<< " (built in nanoseconds " << build_time << ")" << std::endl
+		<< "Scan time for " << nbytes << " bytes (" << nscan
+			<< " occurrences) in nanoseconds " << scan_time << " ("
+			<< nbytes * 1e3 / scan_time << " MB/s)" << std::endl
+		<< "commonPrefixSearch () at each byte in nanoseconds " << search_time << " ("
+			<< nbytes * 1e3 / search_time << " MB/s)" << std::endl;
+}
+
 int main(int argc, char *argv[]) {
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
 	if (argc != 2) {
 		usage(argv[0]);
 		return EINVAL;
@@ -85,16 +290,86 @@ int main(int argc, char *argv[]) {
 		unique_chars += word.size();
 	}
 
+	size_t nfound = 0;
 	s = std::chrono::high_resolution_clock::now();
 	for (const auto& word : words) {
 		Trie::result_triple_type r;
 		r = trie.exactMatchSearch<decltype(r)>(word.c_str());
-		assert(r.length == word.length());
+		nfound += r.value >= 0 && r.length == word.length();
 	}
 	e = std::chrono::high_resolution_clock::now();
 	auto query_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+	/* uses the results, so that release builds keep the lookups */
+	if (nfound != words.size()) {
+		std::cerr << "Only " << nfound << " of " << words.size()
+			<< " unique words found" << std::endl;
+	}
+
+	/* the same lookups in the read-only trie made by freeze () */
+	Trie::frozen_type frozen;
+	s = std::chrono::high_resolution_clock::now();
+	if (trie.freeze(frozen) != 0) {
+		std::cerr << "freeze () failed" << std::endl;
+		return 1;
+	}
+	e = std::chrono::high_resolution_clock::now();
+	auto freeze_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+	nfound = 0;
+	s = std::chrono::high_resolution_clock::now();
+	for (const auto& word : words) {
+		nfound += frozen.exactMatchSearch<int>(word.c_str(), word.length()) >= 0;
+	}
+	e = std::chrono::high_resolution_clock::now();
+	auto frozen_query_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+	if (nfound != words.size()) {
+		std::cerr << "Only " << nfound << " of " << words.size()
+			<< " unique words found in frozen trie" << std::endl;
+	}
 
-	std::cout << "Trie size in bytes " << trie.all_combined_size() << std::endl
+	/* and in the one whose equal subtrees are merged, freeze (t, true) */
+	Trie::frozen_type minimized;
+	s = std::chrono::high_resolution_clock::now();
+	if (trie.freeze(minimized, true) != 0) {
+		std::cerr << "freeze (t, true) failed" << std::endl;
+		return 1;
+	}
+	e = std::chrono::high_resolution_clock::now();
+	auto minimize_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+	nfound = 0;
+	s = std::chrono::high_resolution_clock::now();
+	for (const auto& word : words) {
+		nfound += minimized.exactMatchSearch<int>(word.c_str(), word.length()) >= 0;
+	}
+	e = std::chrono::high_resolution_clock::now();
+	auto minimized_query_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+	if (nfound != words.size()) {
+		std::cerr << "Only " << nfound << " of " << words.size()
+			<< " unique words found in minimized trie" << std::endl;
+	}
+
+	decltype(query_time) batch_query_time = 0;
+	if (FLAGS_batch) {
+		std::vector<const char*> keys;
+		std::vector<size_t> lengths;
+		for (const auto& word : words) {
+			keys.emplace_back(word.c_str());
+			lengths.emplace_back(word.length());
+		}
+		std::vector<Trie::result_triple_type> results(keys.size());
+
+		s = std::chrono::high_resolution_clock::now();
+		trie.exactMatchSearch(keys.data(), results.data(), keys.size(),
+				lengths.data());
+		e = std::chrono::high_resolution_clock::now();
+		batch_query_time = std::chrono::duration_cast<std::chrono::nanoseconds>(e-s).count();
+		for (size_t i = 0; i < keys.size(); ++i) {
+			assert(results[i].length == lengths[i]);
+		}
+	}
+
+	std::cout << "Huge pages (USE_HUGE_PAGES) " << (USE_HUGE_PAGES ? "on" : "off")
+			<< std::endl
+		<< "Trie size in bytes " << trie.all_combined_size() << std::endl
 		<< "Total number of nodes (used + unused) in trie "
 			<< trie.size() << std::endl
 		<< "Total number of used nodes " << trie.nonzero_size() << std::endl
@@ -104,7 +379,33 @@ int main(int argc, char *argv[]) {
 		<< "Total number of characters in unique words " << unique_chars
 			<< std::endl
 		<< "Total insertion time in nanoseconds " << insert_time << std::endl
-		<< "Query time for all unique words in nanoseconds " << query_time << std::endl;
+		<< "Query time for all unique words in nanoseconds " << query_time << std::endl
+		<< "Bytes per unique word " << static_cast<double>(trie.all_combined_size()) / words.size()
+			<< std::endl
+		<< "Frozen trie size in bytes " << frozen.total_size() << " (bytes per unique word "
+			<< static_cast<double>(frozen.total_size()) / words.size() << ")" << std::endl
+		<< "Freeze time in nanoseconds " << freeze_time << std::endl
+		<< "Frozen query time for all unique words in nanoseconds " << frozen_query_time
+			<< std::endl
+		<< "Minimized trie size in bytes " << minimized.total_size() << " (units "
+			<< minimized.size() << " of " << frozen.size() << " frozen)" << std::endl
+		<< "Minimize time in nanoseconds " << minimize_time << std::endl
+		<< "Minimized query time for all unique words in nanoseconds " << minimized_query_time
+			<< std::endl;
+	if (FLAGS_batch) {
+		std::cout << "Batched query time for all unique words in nanoseconds "
+			<< batch_query_time << " (batch of " << cedar::BATCH_SIZE << ")"
+			<< std::endl;
+	}
+	if (FLAGS_threads > 0) {
+		report_sharded(filename);
+	}
+	if (FLAGS_readers > 0) {
+		report_concurrent(words);
+	}
+	if (FLAGS_scan) {
+		report_scan(trie, filename);
+	}
 
 	return 0;
 }
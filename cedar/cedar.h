@@ -8,16 +8,36 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <climits>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <glog/logging.h>
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <cedar_config.h>
+#include <cedar_format.h>
+#include <cedar_memory.h>
+#include <cedar_frozen.h>
+#include <cedar_fuzzy.h>
 
 #define CEDAR_PAGE_SIZE 4096
 #define NEXT_PAGE_BOUNDARY(num) ((num + (CEDAR_PAGE_SIZE - 1)) & (~((CEDAR_PAGE_SIZE - 1))))
 
 #define STATIC_ASSERT(e, msg) typedef char msg[(e) ? 1 : -1]
 
+#if defined (__GNUC__)
+#define CEDAR_PREFETCH(p) __builtin_prefetch (p)
+#else
+#define CEDAR_PREFETCH(p)
+#endif
+
 // each slot in "_block" contains info on 256 contiguous elements in "_array"
 // hence the right shift
 #define ArrayToBlock(s) (s >> 8)
@@ -37,13 +57,34 @@ namespace cedar {
   template <typename T> struct NaN { enum { N1 = -1, N2 = -2 }; };
   template <> struct NaN <float> { enum { N1 = 0x7f800001, N2 = 0x7f800002 }; };
   static const int MAX_ALLOC_SIZE = 1 << 16; // must be divisible by 256
+  static const size_t BATCH_SIZE = 16; // # lookups interleaved by batch search
+  static const int NUM_RECENT_BLOCKS = 16; // # blocks build_sorted () fills
+  static const int MIN_RESTORE_BLOCKS = 1 << 12; // # blocks per thread of restore ()
+  // # trailing zero bits of a non-zero word
+  inline int ctz64 (uint64_t x) {
+#if defined (__GNUC__)
+    return __builtin_ctzll (x);
+#else
+    int n = 0;
+    for (; ! (x & 0xff); x >>= 8) n += 8;
+    for (; ! (x & 1); x >>= 1) ++n;
+    return n;
+#endif
+  }
+  template <typename trie_type>
+  class da_const_iterator;
+  template <typename trie_type>
+  class da_matcher;
+  template <typename trie_type>
+  class aho_corasick;
   // dynamic double array
   template <typename value_type,
             const int     NO_VALUE  = NaN <value_type>::N1,
             const int     NO_PATH   = NaN <value_type>::N2,
             const bool    ORDERED   = true,
             const int     MAX_TRIAL = 1,
-            const size_t  NUM_TRACKING_NODES = 0>
+            const size_t  NUM_TRACKING_NODES = 0,
+            typename      allocator_type = default_allocator> // see cedar_memory.h
   class da {
   public:
     enum error_code { 
@@ -63,6 +104,44 @@ namespace cedar {
       size_t      length;  // suffix length
       size_t      id;      // last slot in _array where string ends 
     };
+    struct key_value_type { // for const_iterator
+      const char* key;     // null-terminated
+      size_t      length;
+      value_type  value;
+      size_t      id;      // as result_triple_type
+    };
+	/**
+	 * where predictPage () stopped: the last completion returned, the
+	 * node of the prefix, and a hash of the labels from the prefix to the
+	 * completion; of fixed-width fields, so that it can be handed out as
+	 * bytes and taken back by the trie object that issued it
+	 */
+    struct cursor {
+      uint64_t from;  // node of the last completion, as next () takes it
+      uint64_t len;   // its length
+      uint64_t root;  // node of the prefix
+      uint64_t path;  // 0 before the first page, ~0 after the last
+      cursor () : from (0), len (0), root (0), path (0) {}
+      bool end () const { return path == ~uint64_t (0); }
+    };
+    typedef da_const_iterator <da> const_iterator;
+    typedef const_iterator         iterator; // keys cannot be modified in place
+    typedef da_matcher <da>        matcher;  // longest match over chunked input
+    typedef frozen_da <value_type, NO_VALUE, NO_PATH> frozen_type; // for freeze ()
+	/**
+	 * shape of the trie, as returned by stats ()
+	 */
+    struct stats_type {
+      size_t num_keys;
+      size_t num_nodes;         // nodes in use but the root; nonzero_size ()
+      size_t num_free_nodes;    // empty nodes in the blocks of the array
+      size_t size;              // nodes in the array
+      size_t capacity;
+      size_t num_blocks;        // blocks of 256 nodes
+      size_t num_blocks_open;   // on the Open list
+      size_t num_blocks_closed; // on the Closed list
+      size_t num_blocks_full;   // the rest but the first block of the root
+    };
 
 	// check field stores addr of parent node
 	// this invariant holds => check[base[p] ^ label] = p
@@ -105,24 +184,32 @@ namespace cedar {
       int   trial{0};  // # trial
       int   ehead{0};  // first empty item
     };
-    explicit da () {
+	// empty nodes of a block, bit (e & 63) of word (e & 255) >> 6; kept
+	// beside _block, not in files, and rebuilt from _array when missing
+    struct free_map {
+      uint64_t w[4];
+    };
+    explicit da (const allocator_type& alloc = allocator_type ()) : _alloc (alloc) {
       STATIC_ASSERT(sizeof (value_type) <= sizeof (int),
                     value_type_is_not_supported___maintain_a_value_array_by_yourself_and_store_its_index
                     );
       _initialize ();
     }
     ~da () { clear (false); }
+    allocator_type&       allocator ()       { return _alloc; }
+    const allocator_type& allocator () const { return _alloc; }
     size_t capacity   () const { return static_cast <size_t> (_capacity); }
     size_t size       () const { return static_cast <size_t> (_size); }
     size_t total_size () const { return sizeof (node) * _size; }
     size_t unit_size  () const { return sizeof (node); }
+	/**
+	 * # nodes in use but the root; O(1), as num_keys () and stats ()
+	 */
     size_t nonzero_size () const {
-      size_t i = 0;
-      for (int to = 0; to < _size; ++to)
-        if (_array[to].check >= 0) {
-		  ++i;
-        }
-      return i;
+      if (! _counted) {
+        _count ();
+      }
+      return _nonzero_size;
     }
 
 	size_t all_combined_size() const {
@@ -133,20 +220,35 @@ namespace cedar {
 	}
 
     size_t num_keys () const {
-      size_t i = 0;
-      for (int to = 0; to < _size; ++to) {
-#if (USE_REDUCED_TRIE == 1)
-        if (_array[to].check >= 0 && _array[to].value >= 0)
-#else
-        if (_array[to].check >= 0 && 
-		  // i.e. array[parent].base == to
-		  _array[_array[to].check].base () == to) 
-#endif
-        {
-		    ++i;
-		}
+      if (! _counted) {
+        _count ();
       }
-      return i;
+      return _num_keys;
+    }
+
+	/**
+	 * counters kept by update () and erase (), and the block lists; while
+	 * _block is not loaded (see open ()), blocks are counted from _array as
+	 * restore () would list them, in O(size ())
+	 */
+    stats_type stats () const {
+      if (! _counted) {
+        _count ();
+      }
+      stats_type st;
+      st.num_keys          = _num_keys;
+      st.num_nodes         = _nonzero_size;
+      st.num_free_nodes    = static_cast <size_t> (_size) - _nonzero_size - 1;
+      st.size              = static_cast <size_t> (_size);
+      st.capacity          = static_cast <size_t> (_capacity);
+      st.num_blocks        = static_cast <size_t> (ArrayToBlock(_size));
+      st.num_blocks_open   = static_cast <size_t> (_bnumO);
+      st.num_blocks_closed = static_cast <size_t> (_bnumC);
+      if (! _block) {
+        _count_blocks_in_array (st.num_blocks_open, st.num_blocks_closed);
+      }
+      st.num_blocks_full   = st.num_blocks ? st.num_blocks - 1 - st.num_blocks_open - st.num_blocks_closed : 0;
+      return st;
     }
 
 	/**
@@ -171,6 +273,67 @@ namespace cedar {
       _set_result (&result, b.x, len, from);
       return result;
     }
+
+	/**
+	 * look up "num" keys at once and store their results in "result"
+	 *
+	 * Up to BATCH_SIZE lookups are walked through the double array in
+	 * lockstep; the next node of every in-flight key is prefetched before
+	 * any of them is examined, so that their cache/TLB misses overlap.
+	 *
+	 * @param len    key lengths; strlen () is used if not given
+	 */
+    template <typename T>
+    void exactMatchSearch (const char* const* key, T* result, const size_t num, const size_t* len = 0) const {
+      for (size_t i = 0; i < num; i += BATCH_SIZE) {
+        const size_t n = num - i < BATCH_SIZE ? num - i : BATCH_SIZE;
+        const uchar* key_[BATCH_SIZE];
+        size_t len_[BATCH_SIZE], from[BATCH_SIZE], pos[BATCH_SIZE], to[BATCH_SIZE];
+        size_t lane[BATCH_SIZE]; // lookups in flight
+        for (size_t j = 0; j < n; ++j) {
+          key_[j] = reinterpret_cast <const uchar*> (key[i + j]);
+          len_[j] = len ? len[i + j] : std::strlen (key[i + j]);
+          from[j] = pos[j] = 0;
+          lane[j] = j;
+        }
+        for (size_t m = n; m; ) {
+          // issue loads for the next node of every in-flight lookup
+          for (size_t k = 0; k < m; ++k) {
+            const size_t j = lane[k];
+            to[j] = static_cast <size_t> (_array[from[j]].base ())
+                    ^ (pos[j] < len_[j] ? key_[j][pos[j]] : 0); // 0: terminal
+            CEDAR_PREFETCH (&_array[to[j]]);
+          }
+          // and then follow the links
+          for (size_t k = 0; k < m; ) {
+            const size_t j = lane[k];
+            int_value_t b;
+            bool done = true;
+            if (_array[to[j]].check != static_cast <int> (from[j])) {
+              b.i = CEDAR_NO_VALUE;
+            } else if (pos[j] == len_[j]) {
+              b.i = _array[to[j]].base_;
+            } else {
+              from[j] = to[j];
+              ++pos[j];
+              done = false;
+#if (USE_REDUCED_TRIE == 1)
+              if (_array[from[j]].value >= 0) { // get value from leaf
+                b.i = pos[j] == len_[j] ? _array[from[j]].value : CEDAR_NO_VALUE;
+                done = true;
+              }
+#endif
+            }
+            if (! done) {
+              ++k;
+              continue;
+            }
+            _set_result (&result[i + j], b.x, len_[j], from[j]);
+            lane[k] = lane[--m];
+          }
+        }
+      }
+    }
 	/**
 	 * return all strings in trie which are prefix of "key"
 	 * e.g. if key="abcd", return "ab", "abc" etc
@@ -200,6 +363,53 @@ namespace cedar {
         ++num;
       }
       return num;
+    }
+	/**
+	 * call "visit" (value, length, id) for each string in trie which is a
+	 * prefix of "key", shortest first, until it returns false; nothing is
+	 * stored, so a caller needs no array as long as the matches
+	 *
+	 * @return  # strings visited
+	 */
+    template <typename F>
+    size_t commonPrefixSearch (const char* key, F&& visit) const
+    { return commonPrefixSearch (key, std::strlen (key), std::forward <F> (visit)); }
+    template <typename F>
+    size_t commonPrefixSearch (const char* key, size_t len, F&& visit, size_t from = 0) const {
+      size_t num = 0;
+      for (size_t pos = 0; pos < len; ) {
+        int_value_t b;
+        b.i = _find (key, from, pos, pos + 1);
+        if (b.i == CEDAR_NO_VALUE) continue;
+        if (b.i == CEDAR_NO_PATH) {
+          return num;
+        }
+        ++num;
+        if (! visit (b.x, pos, from)) {
+          return num;
+        }
+      }
+      return num;
+    }
+	/**
+	 * return the longest string in trie which is a prefix of "key", in one
+	 * walk down the trie; e.g. if key="abcd", return "abc" rather than "ab"
+	 *
+	 * @return  its value, with its length and id for result_pair_type and
+	 *          result_triple_type, or CEDAR_NO_VALUE of length 0
+	 */
+    template <typename T>
+    T longestPrefixSearch (const char* key) const
+    { return longestPrefixSearch <T> (key, std::strlen (key)); }
+    template <typename T>
+    T longestPrefixSearch (const char* key, size_t len, size_t from = 0) const {
+      int_value_t b;
+      b.i = CEDAR_NO_VALUE;
+      size_t pos (0), length (0), id (from);
+      _longest (key, from, pos, len, b.i, length, id);
+      T result;
+      _set_result (&result, b.x, length, id);
+      return result;
     }
 	/**
 	 * return all strings in trie which are completions of "key"
@@ -230,6 +440,178 @@ namespace cedar {
       }
       return num;
     }
+	/**
+	 * call "visit" (value, length, id) for each string in trie which is a
+	 * completion of "key", in the order of begin () and next (), until it
+	 * returns false; "length" is that of the completion, as in
+	 * result_triple_type
+	 *
+	 * @return  # strings visited
+	 */
+    template <typename F>
+    size_t commonPrefixPredict (const char* key, F&& visit)
+    { return commonPrefixPredict (key, std::strlen (key), std::forward <F> (visit)); }
+    template <typename F>
+    size_t commonPrefixPredict (const char* key, size_t len, F&& visit, size_t from = 0) {
+      size_t num (0), pos (0), p (0);
+      if (_find (key, from, pos, len) == CEDAR_NO_PATH) {
+        return 0;
+      }
+      int_value_t b;
+      const size_t root = from;
+      for (b.i = begin (from, p); b.i != CEDAR_NO_PATH; b.i = next (from, p, root)) {
+        ++num;
+        if (! visit (b.x, p, from)) {
+          break;
+        }
+      }
+      return num;
+    }
+	/**
+	 * return the "k" completions of "key" with the largest values, largest
+	 * first, as commonPrefixPredict () would return them
+	 *
+	 * A best-first search guided by the largest value below each node
+	 * pops O(k * depth) nodes, and reads the annotations of their
+	 * children, instead of enumerating every completion. The annotations
+	 * take one value_type per node; the first call computes them, and
+	 * update (), erase (), relocation and compaction keep them from then
+	 * on. Values written through the reference update () returns bypass
+	 * them.
+	 *
+	 * @return  # completions stored, up to "k"
+	 */
+    template <typename T>
+    size_t topKPredict (const char* key, T* result, size_t k)
+    { return topKPredict (key, result, k, std::strlen (key)); }
+    template <typename T>
+    size_t topKPredict (const char* key, T* result, size_t k, size_t len, size_t from = 0) {
+      size_t pos = 0;
+      if (! k || _find (key, from, pos, len) == CEDAR_NO_PATH) {
+        return 0;
+      }
+      if (_num_max != _size) {
+        _build_max ();
+      }
+      struct item {
+        value_type max;
+        int        e;
+        size_t     len; // of the completion
+        bool operator< (const item& i) const { return max < i.max; }
+      };
+      std::vector <item> heap (1, item {_max[from], static_cast <int> (from), 0});
+      size_t num = 0;
+      while (! heap.empty ()) {
+        std::pop_heap (heap.begin (), heap.end ());
+        const item r = heap.back ();
+        heap.pop_back ();
+        const int p = r.e ? _array[r.e].check : 0;
+        if (r.e && _array[p].base () == r.e) { // terminal; the key ends at p
+          _set_result (&result[num], _array[r.e].value, r.len, static_cast <size_t> (p));
+        }
+#if (USE_REDUCED_TRIE == 1)
+        else if (r.e && _array[r.e].value >= 0) { // leaf
+          _set_result (&result[num], _array[r.e].value, r.len, static_cast <size_t> (r.e));
+        }
+#endif
+        else {
+          uchar c = r.e ? _ninfo[r.e].child : _ninfo[0].sibling;
+          if (! r.e && ! c) { // empty
+            continue;
+          }
+          const int base = _array[r.e].base ();
+          do {
+            const int to = base ^ c;
+            heap.push_back (item {_max[to], to, r.len + (c ? 1 : 0)});
+            std::push_heap (heap.begin (), heap.end ());
+          } while ((c = _ninfo[base ^ c].sibling));
+          continue;
+        }
+        if (++num == k) {
+          break;
+        }
+      }
+      return num;
+    }
+	/**
+	 * store up to "limit" completions of "key" in "result", from where
+	 * "cur" stopped, in the order of commonPrefixPredict (); a page costs
+	 * O(limit), and not the completions of the pages before it
+	 *
+	 * A cursor names the node of the last completion returned, and holds
+	 * while that node still spells the same completion under the same
+	 * prefix node: erasing that completion, or moving its node by update (),
+	 * compaction or a reload, invalidates it, and changes elsewhere in the
+	 * trie do not. Keys added after it in the order show up on later pages.
+	 *
+	 * @return  # completions stored, 0 after the last one, or -1 if "cur"
+	 *          was invalidated or was issued for another prefix
+	 */
+    template <typename T>
+    int predictPage (const char* key, cursor& cur, T* result, size_t limit)
+    { return predictPage (key, std::strlen (key), cur, result, limit); }
+    template <typename T>
+    int predictPage (const char* key, size_t len, cursor& cur, T* result, size_t limit) {
+      if (cur.end () || ! limit) {
+        return 0;
+      }
+      size_t from (0), pos (0), p (0);
+      const bool found = _find (key, from, pos, len) != CEDAR_NO_PATH;
+      if (cur.path && (! found || cur.root != from ||
+                       cur.path != _path_hash (cur.from, cur.len, from))) {
+        return -1;
+      }
+      if (! found) {
+        cur.path = ~uint64_t (0);
+        return 0;
+      }
+      const size_t root = from;
+      int_value_t b;
+      if (cur.path) {
+        from = static_cast <size_t> (cur.from);
+        p    = static_cast <size_t> (cur.len);
+        b.i  = next (from, p, root);
+      } else {
+        b.i  = begin (from, p);
+      }
+      size_t num = 0;
+      for (; b.i != CEDAR_NO_PATH; b.i = next (from, p, root)) {
+        _set_result (&result[num], b.x, p, from);
+        if (++num == limit) {
+          break;
+        }
+      }
+      cur.from  = from;
+      cur.len   = p;
+      cur.root  = root;
+      cur.path  = b.i == CEDAR_NO_PATH ? ~uint64_t (0) : _path_hash (from, p, root);
+      return static_cast <int> (num);
+    }
+	/**
+	 * call "visit" (key, length, value, distance) for each key in trie
+	 * within "max_edits" insertions, deletions and substitutions of "key",
+	 * in the order of begin () and next (), until it returns false; the
+	 * key passed is null-terminated, and valid until "visit" returns
+	 *
+	 * The walk prunes each subtree whose row of the edit distance table
+	 * (cedar_fuzzy.h) has no cell within "max_edits", and fills
+	 * 2 * max_edits + 1 cells per node it enters.
+	 *
+	 * @return  # keys visited
+	 */
+    template <typename F>
+    size_t fuzzySearch (const char* key, const size_t max_edits, F&& visit)
+    { return fuzzySearch (key, std::strlen (key), max_edits, std::forward <F> (visit)); }
+    template <typename F>
+    size_t fuzzySearch (const char* key, size_t len, const size_t max_edits, F&& visit) {
+      if (! _ninfo) {
+        _restore_ninfo ();
+      }
+      edit_rows rows (key, len, max_edits);
+      size_t num = 0;
+      _fuzzy (rows, 0, 0, visit, num);
+      return num;
+    }
 
 	/**
 	 * walk back the Trie from the leaf node to the root of trie
@@ -298,30 +680,35 @@ namespace cedar {
       if (! len && ! from) {
         LOG(FATAL) << "failed to insert zero-length key";
       }
-#if (USE_FAST_LOAD == 0)
-      if (! _ninfo || ! _block) restore ();
-#endif
+      if (! _ninfo || ! _block) restore (); // opened without them
       for (const uchar* const key_ = reinterpret_cast <const uchar*> (key);
            pos < len; ++pos) {
 #if (USE_REDUCED_TRIE == 1)
         const value_type val_ = _array[from].value;
         if (val_ >= 0 && val_ != CEDAR_VALUE_LIMIT) // always new; correct this!
-          { const int to = _follow (from, 0, cf); _array[to].value = val_; }
+          { const int to = _follow (from, 0, cf); _array[to].value = val_; _set_max (to, val_); }
 #endif
         LOG_IF(FATAL, key_[pos] == 0) << "char 0 in string does not work with xor calcs";
         from = static_cast <size_t> (_follow (from, key_[pos], cf));
       }
 #if (USE_REDUCED_TRIE == 1)
       const int to = _array[from].value >= 0 ? static_cast <int> (from) : _follow (from, 0, cf);
-      if (_array[to].value == CEDAR_VALUE_LIMIT) {
+      if (_array[to].value == CEDAR_VALUE_LIMIT) { // new key
         _array[to].value = 0;
+        ++_num_keys;
       }
 #else
+      const int base = _array[from].base ();
+      if (base < 0 || _array[base ^ 0].check != static_cast <int> (from)) { // new key
+        ++_num_keys;
+      }
       const int to = _follow (from, 0, cf);
 #endif
       VLOG(1) << "update slot=" << to << ",key=" << key;
       VLOG(1) << "------------------------";
-      return _array[to].value += val;
+      _array[to].value += val;
+      _update_max (to);
+      return _array[to].value;
     }
 	/**
 	 * easy-going erase () without compression
@@ -347,12 +734,14 @@ namespace cedar {
 	 */
     void erase (size_t from) {
       // _test ();
+      if (! _ninfo || ! _block) restore (); // opened without them
 #if (USE_REDUCED_TRIE == 1)
       int e = _array[from].value >= 0 ? static_cast <int> (from) : _array[from].base () ^ 0;
       from = static_cast <size_t> (_array[e].check);
 #else
       int e = _array[from].base () ^ 0;
 #endif
+      --_num_keys;
       bool flag = false; // have sibling
       do {
         const node& n = _array[from];
@@ -365,6 +754,7 @@ namespace cedar {
         // cur = cur->prev
         from = static_cast <size_t> (_array[from].check);
       } while (! flag);
+      _update_max (e); // lost a child
       // termination condition (!flag) indicates if the trie has a branch, 
       // then do not free nodes which are common(shared) with another branch
     }
@@ -377,6 +767,336 @@ namespace cedar {
         update (key[i], len ? len[i] : std::strlen (key[i]), val ? val[i] : value_type (i));
 	  }
       return 0;
+    }
+	/**
+	 * build the trie at once from "num" keys sorted in byte order
+	 *
+	 * All the labels going out of a node are known before its base is
+	 * chosen, so each node is placed once by _find_place () and nothing is
+	 * relocated by _resolve (). The result is an ordinary updatable trie.
+	 * Keys are inserted one by one by build () if the trie is not empty.
+	 *
+	 * It takes about as long as update () of the same sorted keys, which
+	 * seldom relocates either: the time goes to placing each node and
+	 * unlinking it from the empty list, which both pay. cedarpp.h, whose
+	 * update () splits a tail for each key that shares its prefix, gains.
+	 *
+	 * @return  0 on success, -1 if keys are not sorted or not unique
+	 */
+    int build_sorted (size_t num, const char** key, const size_t* len = 0, const value_type* val = 0) {
+      if (! _ninfo || ! _block) restore ();
+      if (_ninfo[0].child || _ninfo[0].sibling) { // not empty
+        return build (num, key, len, val);
+      }
+      std::vector <size_t> len_;
+      if (! len) {
+        len_.resize (num);
+        for (size_t i = 0; i < num; ++i) {
+          len_[i] = std::strlen (key[i]);
+        }
+        len = len_.data ();
+      }
+      for (size_t i = 0; i < num; ++i) {
+        if (! len[i]) {
+          LOG(FATAL) << "failed to insert zero-length key";
+        }
+        if (i) {
+          const size_t n = len[i - 1] < len[i] ? len[i - 1] : len[i];
+          const int r = std::memcmp (key[i - 1], key[i], n);
+          if (r > 0 || (r == 0 && len[i - 1] >= len[i])) {
+            LOG(ERROR) << "keys are not sorted or not unique at " << i;
+            return -1;
+          }
+        }
+      }
+      // keys [begin, end) share the first "depth" bytes, which lead to "from"
+      struct range { size_t from, depth, begin, end; };
+      std::vector <range> todo;
+      if (num) {
+        todo.push_back (range {0, 0, 0, num});
+      }
+      uchar  child[256] = {};
+      size_t end[256]; // keys [.., end[i]) go to child[i]
+      while (! todo.empty ()) {
+        const range r = todo.back ();
+        todo.pop_back ();
+        if (r.from && r.end - r.begin == 1) { // the rest of a key makes a chain
+          const uchar* const key_ = reinterpret_cast <const uchar*> (key[r.begin]);
+          size_t from = r.from;
+#if (USE_REDUCED_TRIE == 1)
+          for (size_t pos = r.depth; pos < len[r.begin]; ++pos) { // value on leaf
+#else
+          for (size_t pos = r.depth; pos <= len[r.begin]; ++pos) {
+#endif
+            const uchar c = pos < len[r.begin] ? key_[pos] : 0;
+            LOG_IF(FATAL, ! c && pos < len[r.begin]) << "char 0 in string does not work with xor calcs";
+            const int base = _find_place_recent (&c, &c) ^ c;
+#if (USE_REDUCED_TRIE == 1)
+            _array[from].base_ = -base - 1;
+#else
+            _array[from].base_ = base;
+#endif
+            _ninfo[from].child = c;
+            from = static_cast <size_t> (_pop_enode (base, c, static_cast <int> (from)));
+            _ninfo[from].sibling = 0;
+          }
+          _array[from].value = val ? val[r.begin] : value_type (r.begin);
+          continue;
+        }
+        size_t n = 0; // # distinct labels
+        for (size_t i = r.begin; i < r.end; ++i) {
+          const uchar c = r.depth < len[i] ? static_cast <uchar> (key[i][r.depth]) : 0;
+          LOG_IF(FATAL, ! c && r.depth < len[i]) << "char 0 in string does not work with xor calcs";
+          if (! n || child[n - 1] != c) {
+            child[n++] = c;
+          }
+          end[n - 1] = i + 1;
+        }
+        const uchar* const last = child + n - 1;
+        // the empty root keeps the special block
+        const int base = ! r.from ? 0 : _find_place_recent (child, last) ^ *child;
+#if (USE_REDUCED_TRIE == 1)
+        _array[r.from].base_ = -base - 1;
+#else
+        _array[r.from].base_ = base;
+#endif
+        // children of the root are chained from the root itself (0 ^ 0)
+        (r.from ? _ninfo[r.from].child : _ninfo[0].sibling) = *child;
+        for (const uchar* p = child; p <= last; ++p) {
+          const int to = _pop_enode (base, *p, static_cast <int> (r.from));
+          const size_t begin = p == child ? r.begin : end[p - child - 1];
+          _ninfo[to].sibling = p == last ? 0 : *(p + 1);
+          if (*p) {
+            todo.push_back (range {static_cast <size_t> (to), r.depth + 1, begin, end[p - child]});
+          } else {
+            _array[to].value = val ? val[begin] : value_type (begin);
+          }
+        }
+      }
+      _num_keys += num;
+      if (_num_max) { // values are set without _update_max ()
+        _build_max ();
+      }
+      return 0;
+    }
+	/**
+	 * rebuild the trie from its live nodes into a dense layout
+	 *
+	 * Nodes are placed depth-first as build_sorted () places them, so the
+	 * empty nodes that erase () leaves behind are gone, and the arrays
+	 * shrink to fit. Node ids change; "cf" is called with the old and the
+	 * new id of every node, as update () calls it for nodes it moves. Both
+	 * layouts are in memory while it runs; compact_step () migrates a few
+	 * blocks at a time instead.
+	 *
+	 * @return  bytes of _array, _ninfo and _block given back
+	 */
+    size_t compact () {
+      empty_callback cf;
+      return compact (cf);
+    }
+    template <typename T>
+    size_t compact (T& cf) {
+      if (_fd >= 0) {
+        LOG(ERROR) << "compact () cannot move a trie out of its file; use compact_step ()";
+        return 0;
+      }
+      if (! _ninfo || ! _block) {
+        restore ();
+      }
+      const size_t size_p = all_combined_size ();
+      // take the sections away, and start over from the first block
+      void* const section[NUM_SECTIONS] = {_array, _ninfo, _block, 0};
+      size_t mmap_len[NUM_SECTIONS], alloc_len[NUM_SECTIONS];
+      for (int i = 0; i < NUM_SECTIONS; ++i) {
+        mmap_len[i]  = _mmap_len[i];
+        alloc_len[i] = _alloc_len[i];
+        _mmap_len[i] = _alloc_len[i] = 0;
+      }
+      const node*  const array  = _array;
+      const ninfo* const ninfo_ = _ninfo;
+      const bool no_delete = _no_delete;
+      const bool annotated = _num_max != 0; // _initialize () drops it
+      // tracked nodes by their old ids, which the new ones may collide with
+      size_t tracked[NUM_TRACKING_NODES + 1];
+      std::copy (tracking_node, tracking_node + NUM_TRACKING_NODES + 1, tracked);
+      _array = 0;
+      _ninfo = 0;
+      _block = 0;
+      _no_delete = false;
+      _bheadF = _bheadC = _bheadO = 0;
+      _initialize ();
+      std::copy (tracked, tracked + NUM_TRACKING_NODES + 1, tracking_node);
+      // a node (old id) and its copy (new id) whose children are to copy
+      struct item { int from_p, from; };
+      std::vector <item> todo;
+      // children of the root are chained from the root itself (0 ^ 0)
+      if (ninfo_[0].sibling) {
+        todo.push_back (item {0, 0});
+      }
+      uchar child[256];
+      while (! todo.empty ()) {
+        const item r = todo.back ();
+        todo.pop_back ();
+        const int base_p = array[r.from_p].base ();
+        size_t n = 0;
+        uchar c = r.from_p ? ninfo_[r.from_p].child : ninfo_[0].sibling;
+        do {
+          child[n++] = c;
+        } while ((c = ninfo_[base_p ^ c].sibling));
+        const uchar* const last = child + n - 1;
+        // the root keeps the special block
+        const int base = ! r.from ? 0 : _find_place_recent (child, last) ^ *child;
+#if (USE_REDUCED_TRIE == 1)
+        _array[r.from].base_ = -base - 1;
+#else
+        _array[r.from].base_ = base;
+#endif
+        (r.from ? _ninfo[r.from].child : _ninfo[0].sibling) = *child;
+        for (const uchar* p = child; p <= last; ++p) {
+          const int to_p = base_p ^ *p;
+          const int to   = _pop_enode (base, *p, r.from);
+          _ninfo[to].sibling = p == last ? 0 : *(p + 1);
+          cf (to_p, to);
+          for (size_t j = 0; tracked[j] != 0; ++j) {
+            if (tracked[j] == static_cast <size_t> (to_p)) {
+              tracking_node[j] = static_cast <size_t> (to);
+            }
+          }
+#if (USE_REDUCED_TRIE == 1)
+          if (array[to_p].value < 0) { // internal
+#else
+          if (*p) {
+#endif
+            todo.push_back (item {to_p, to});
+          } else {
+            _array[to].value = array[to_p].value;
+            ++_num_keys;
+          }
+        }
+      }
+      for (int i = 0; i < NUM_SECTIONS; ++i) {
+        if (mmap_len[i]) {
+          munmap (section[i], mmap_len[i]);
+        } else if (section[i] && ! (i == SECTION_ARRAY && no_delete)) {
+          _alloc.deallocate (section[i], alloc_len[i]);
+        }
+      }
+      _shrink_to_fit ();
+      if (annotated) {
+        _build_max ();
+      }
+      const size_t size_n = all_combined_size ();
+      return size_p > size_n ? size_p - size_n : 0;
+    }
+	/**
+	 * migrate the nodes in up to "max_blocks" blocks at the end of the
+	 * array into empty nodes of the blocks before them, and cut those
+	 * blocks off, so that a long-running process reclaims what erase ()
+	 * left a few blocks at a time. Node ids change as in compact ().
+	 * Memory goes back to the allocator unless the sections are mapped.
+	 *
+	 * @return  # blocks cut off; 0 if no more can be
+	 */
+    size_t compact_step (const size_t max_blocks = 1) {
+      empty_callback cf;
+      return compact_step (max_blocks, cf);
+    }
+    template <typename T>
+    size_t compact_step (const size_t max_blocks, T& cf) {
+      if (! _ninfo || ! _block) {
+        restore ();
+      }
+      size_t n = 0;
+      for (; n < max_blocks && _size > 256; ++n) {
+        const int bi = ArrayToBlock(_size) - 1;
+        if (! _evacuate_block (bi, cf)) {
+          break;
+        }
+        block& b = _block[bi]; // now all empty; on Open unless given up
+        _pop_block (bi, b.trial == MAX_TRIAL ? _bheadC : _bheadO, bi == b.next);
+        b = block ();
+        _size -= 256;
+        _num_free = std::min (_num_free, bi);
+        _num_max  = std::min (_num_max, _size);
+      }
+      if (n) {
+        _shrink_to_fit ();
+      }
+      return n;
+    }
+	/**
+	 * export the trie into an immutable frozen_type for serving; see
+	 * cedar_frozen.h for its layout
+	 *
+	 * Nodes are laid out depth-first in 4-byte units, and the trie itself
+	 * is left as it is. Values have to lie in [0, 2^31).
+	 *
+	 * With minimize = true, equivalent subtrees are merged into a directed
+	 * acyclic word graph first, and values of any kind are kept in a side
+	 * array indexed by the ranks of keys.
+	 *
+	 * @return  0 on success, -1 if a value is out of range or the trie
+	 *          is too large for the offsets of frozen_type
+	 */
+    int freeze (frozen_type& t, const bool minimize = false) {
+      if (minimize) {
+        return _freeze_minimized (t);
+      }
+      if (! _ninfo) _restore_ninfo ();
+      frozen_builder fb;
+      // a node and its unit, whose children are to place
+      struct item { int from; uint32_t id; };
+      std::vector <item> todo;
+      // children of the root are chained from the root itself (0 ^ 0)
+      if (_ninfo[0].sibling) {
+        todo.push_back (item {0, 0});
+      }
+      uchar child[256];
+      size_t num = 0;
+      while (! todo.empty ()) {
+        const item r = todo.back ();
+        todo.pop_back ();
+        const int base_p = _array[r.from].base ();
+        int_value_t b;
+        size_t n = 0;
+#if (USE_REDUCED_TRIE == 1)
+        if (r.from && _array[r.from].value >= 0) { // leaf
+          child[n++] = 0;
+        } else
+#endif
+        {
+          uchar c = r.from ? _ninfo[r.from].child : _ninfo[0].sibling;
+          do {
+            child[n++] = c;
+          } while ((c = _ninfo[base_p ^ c].sibling));
+        }
+        uint32_t base = 0;
+        if (! fb.place (r.id, child, n, base)) {
+          LOG(ERROR) << "freeze () failed: trie of size=" << _size << " is too large";
+          return -1;
+        }
+        // the first child is placed next
+        for (const uchar* p = child + n - 1; p >= child; --p) {
+          if (*p) {
+            todo.push_back (item {base_p ^ *p, base ^ *p});
+            continue;
+          }
+#if (USE_REDUCED_TRIE == 1)
+          b.x = _array[r.from].value >= 0 ? _array[r.from].value : _array[base_p ^ 0].value;
+#else
+          b.x = _array[base_p ^ 0].value;
+#endif
+          if (b.i < 0) {
+            LOG(ERROR) << "freeze () failed: value=" << b.x << " is out of [0, 2^31)";
+            return -1;
+          }
+          fb.set_value (base, b.i);
+          ++num;
+        }
+      }
+      t.assign (fb.units (), num);
+      return 0;
     }
     template <typename T>
     void dump (T* result, const size_t result_len) {
@@ -394,32 +1114,55 @@ namespace cedar {
           break;
 		}
     }
+	/**
+	 * save the trie as one file; see cedar_format.h for its layout
+	 */
     int save (const char* fn, const char* mode = "wb") const {
       // _test ();
       FILE* fp = std::fopen (fn, mode);
       if (! fp) return -1;
-      std::fwrite (_array, sizeof (node), static_cast <size_t> (_size), fp);
-      std::fclose (fp);
+      file_header h;
+      _file_header (h);
+      h.num_keys  = num_keys ();
+      h.num_nodes = _nonzero_size;
+      h.section[SECTION_ARRAY].length = sizeof (node) * static_cast <size_t> (_size);
 #if (USE_FAST_LOAD == 1)
-      std::string info(fn);
-      info.append(".sbl");
-      fp = std::fopen (info.c_str(), mode);
-      if (! fp) return -1;
-      std::fwrite (&_bheadF, sizeof (int), 1, fp);
-      std::fwrite (&_bheadC, sizeof (int), 1, fp);
-      std::fwrite (&_bheadO, sizeof (int), 1, fp);
-      std::fseek(fp, CEDAR_PAGE_SIZE, SEEK_SET); // mmap requires page boundary
-      std::fwrite (_ninfo, sizeof (ninfo), static_cast <size_t> (_size), fp);
-      std::fseek(fp, CEDAR_PAGE_SIZE + NEXT_PAGE_BOUNDARY(sizeof(ninfo) * _size), SEEK_SET);
-      std::fwrite (_block, sizeof (block), static_cast <size_t> (ArrayToBlock(_size)), fp);
-      std::fclose (fp);
+      if (_ninfo && _block) {
+        h.section[SECTION_NINFO].length = sizeof (ninfo) * static_cast <size_t> (_size);
+        h.section[SECTION_BLOCK].length = sizeof (block) * static_cast <size_t> (ArrayToBlock(_size));
+      }
 #endif
-      return 0;
+      const void* const data[NUM_SECTIONS] = {_array, _ninfo, _block, 0};
+      file_header_seal (h, data);
+      const int ret = file_write (fp, h, data);
+      if (std::fclose (fp) != 0) return -1;
+      return ret;
     }
+	/**
+	 * load the trie by reading the file; files without the header of
+	 * cedar_format.h are read as the legacy array + ".sbl" pair
+	 *
+	 * With load_info = false, _ninfo and _block, which only update () and
+	 * erase () use, are not loaded; a read-only service then keeps only
+	 * _array, and the first update () or erase () rebuilds them by restore ().
+	 */
     int open (const char* fn, const char* mode = "rb",
-              const size_t offset = 0, size_t in_size = 0) {
+              const size_t offset = 0, size_t in_size = 0,
+              const bool load_info = true) {
       FILE* fp = std::fopen (fn, mode);
       if (! fp) return -1;
+      file_header h;
+      if (const int legacy = file_read_header (fileno (fp), offset, h)) {
+        if (legacy < 0) {
+          LOG(ERROR) << "file=" << fn << " has a corrupted header";
+          std::fclose (fp);
+          return -1;
+        }
+      } else {
+        const int ret = _open_file (fileno (fp), fn, offset, h, false, load_info);
+        std::fclose (fp);
+        return ret;
+      }
       // get size
       if (! in_size) {
         in_size = lseek(fileno(fp), 0, SEEK_END);
@@ -436,10 +1179,7 @@ namespace cedar {
       // set array
       clear (false);
       const size_t num_entries = (in_size - offset) / sizeof (node);
-      _array = static_cast <node*>  (std::malloc (sizeof (node)  * num_entries));
-      if (! _array) {
-        LOG(FATAL) << "memory allocation failed";
-      }
+      _array = static_cast <node*>  (_allocate (SECTION_ARRAY, sizeof (node)  * num_entries));
       if ((off_t)(sizeof(node) * num_entries) != 
 	    pread(fileno(fp), _array, sizeof (node) * num_entries, offset)) {
           LOG(ERROR) << "file=" << fn << " failed to read size=" 
@@ -448,13 +1188,13 @@ namespace cedar {
 	      return -1;
       }
       std::fclose (fp);
-      _size = static_cast <int> (num_entries);
+      _size = _capacity = static_cast <int> (num_entries);
 #if (USE_FAST_LOAD == 1)
-      _ninfo = static_cast <ninfo*> (std::malloc (sizeof (ninfo) * num_entries));
-      _block = static_cast <block*> (std::malloc (sizeof (block) * num_entries));
-      if (! _ninfo || ! _block) {
-        LOG(FATAL) << "memory allocation failed";
+      if (! load_info) {
+        return 0;
       }
+      _ninfo = static_cast <ninfo*> (_allocate (SECTION_NINFO, sizeof (ninfo) * num_entries));
+      _block = static_cast <block*> (_allocate (SECTION_BLOCK, sizeof (block) * ArrayToBlock(num_entries)));
       std::string info(fn);
       info.append(".sbl");
       fp = std::fopen (info.c_str(), mode);
@@ -473,18 +1213,40 @@ namespace cedar {
         return -1;
       }
       std::fclose (fp);
-      _capacity = _size;
 #endif
       return 0;
     }
 
 	/** 
 	 * open the trie file using mmap()
+	 *
+	 * All the sections of a file saved by save () are mapped by one mmap ()
+	 * without copying; "offset" must be page aligned then. Checksums of
+	 * the sections are not verified, which would read them all.
+	 *
+	 * The mapping is private and writable: update () and erase () copy only
+	 * the pages they touch, and the file itself is never modified. A section
+	 * moves to heap when it has to grow beyond what was mapped.
+	 *
+	 * load_info = false leaves _ninfo and _block unmapped, as open () does.
 	 */
     int open_with_mmap (const char* fn, const char* mode = "rb",
-              const size_t offset = 0, size_t in_size = 0) {
+              const size_t offset = 0, size_t in_size = 0,
+              const bool load_info = true) {
       FILE* fp = std::fopen (fn, mode);
       if (! fp) return -1;
+      file_header h;
+      if (const int legacy = file_read_header (fileno (fp), offset, h)) {
+        if (legacy < 0) {
+          LOG(ERROR) << "file=" << fn << " has a corrupted header";
+          std::fclose (fp);
+          return -1;
+        }
+      } else {
+        const int ret = _open_file (fileno (fp), fn, offset, h, true, load_info);
+        std::fclose (fp);
+        return ret;
+      }
       // get size
       if (! in_size) {
         in_size = lseek(fileno(fp), 0, SEEK_END);
@@ -502,14 +1264,19 @@ namespace cedar {
       clear (false);
       const size_t num_entries = (in_size - offset) / sizeof (node);
 
-      void* map_addr = mmap(NULL, sizeof(node) * num_entries, PROT_READ, MAP_SHARED, fileno(fp), offset);
+      void* map_addr = mmap(NULL, sizeof(node) * num_entries, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), offset);
       if (map_addr == MAP_FAILED) {
         LOG(FATAL) << "mmap failed"; 
       }
 	  _array = static_cast<node*>(map_addr);
+      _mmap_len[SECTION_ARRAY] = sizeof(node) * num_entries;
+      advise_huge_pages(map_addr, sizeof(node) * num_entries);
       std::fclose (fp);
-      _size = static_cast <int> (num_entries);
+      _size = _capacity = static_cast <int> (num_entries);
 #if (USE_FAST_LOAD == 1)
+      if (! load_info) {
+        return 0;
+      }
       std::string info(fn);
       info.append(".sbl");
       fp = std::fopen (info.c_str(), mode);
@@ -521,30 +1288,132 @@ namespace cedar {
       std::fread (&_bheadO, sizeof (int), 1, fp);
       off_t curoff = CEDAR_PAGE_SIZE; // align mmap to page boundary
       {
-        map_addr = mmap(NULL, sizeof(ninfo) * num_entries, PROT_READ, MAP_PRIVATE, fileno(fp), curoff);
+        map_addr = mmap(NULL, sizeof(ninfo) * num_entries, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), curoff);
         if (map_addr == MAP_FAILED) {
           LOG(FATAL) << "mmap failed offset=" << curoff << " errno=" << errno; 
         }
 	    _ninfo = static_cast<ninfo*>(map_addr);
+        _mmap_len[SECTION_NINFO] = sizeof(ninfo) * num_entries;
       }
       curoff += NEXT_PAGE_BOUNDARY(sizeof(ninfo) * num_entries);
       {
-        map_addr = mmap(NULL, sizeof(block) * ArrayToBlock(num_entries), PROT_READ, MAP_PRIVATE, fileno(fp), curoff);
+        map_addr = mmap(NULL, sizeof(block) * ArrayToBlock(num_entries), PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), curoff);
         if (map_addr == MAP_FAILED) {
           LOG(FATAL) << "mmap failed offset=" << curoff << " errno=" << errno; 
         }
         _block = static_cast<block*>(map_addr);
+        _mmap_len[SECTION_BLOCK] = sizeof(block) * ArrayToBlock(num_entries);
       }
 
       std::fclose (fp);
-      _capacity = _size;
 #endif
-      _using_mmap = true;
       return 0;
     }
-    void restore () { // restore information to update
+
+	/**
+	 * keep the trie in "fn" itself: _array, _ninfo and _block are mapped
+	 * MAP_SHARED, so every update () writes through to the file and
+	 * _add_block () grows it by ftruncate () and mremap ()
+	 *
+	 * An empty or missing file receives the current trie; otherwise the
+	 * file, saved by save () or kept by open_persistent (), is mapped as it
+	 * is, which makes restart instant. A file saved without _ninfo and
+	 * _block (USE_FAST_LOAD=0) is read, restored and laid out anew once.
+	 * Call sync () to make the updates so far durable; clear () and the
+	 * destructor call it too. There is no journal: if the process dies
+	 * between sync ()s, the file may hold part of the updates made since
+	 * the last one.
+	 *
+	 * The file stays readable by open () and open_with_mmap (); its
+	 * header marks the sections as unchecksummed (FLAG_UNCHECKED).
+	 */
+    int open_persistent (const char* fn) {
+      const int fd = ::open (fn, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        LOG(ERROR) << "file=" << fn << " cannot be opened errno=" << errno;
+        return -1;
+      }
+      struct stat st;
+      if (fstat (fd, &st) != 0) {
+        LOG(ERROR) << "file=" << fn << " fstat failed errno=" << errno;
+        ::close (fd);
+        return -1;
+      }
+      if (st.st_size == 0) { // move the current trie into the file
+        return _move_into_file (fd, fn);
+      }
+      file_header h;
+      const int ret = file_read_header (fd, 0, h);
+      file_header expected;
+      _file_header (expected);
+      const char* reason = ret > 0 ? "not a trie file" :
+                           ret < 0 ? "corrupted header" :
+                           file_header_mismatch (h, expected);
+      if (! reason && ! h.section[SECTION_NINFO].length && ! h.section[SECTION_BLOCK].length) {
+        // saved with the array alone (USE_FAST_LOAD=0); lay the file out anew
+        if (open (fn) != 0) {
+          ::close (fd);
+          return -1;
+        }
+        return _move_into_file (fd, fn);
+      }
+      const size_t len = static_cast <size_t> (st.st_size);
+      const int capacity = reason ? 0 : _file_capacity (h, len);
+      if (! reason && (! capacity || capacity < h.size)) {
+        reason = "ninfo or block section is missing or inconsistent";
+      }
+      char* p = 0;
+      if (! reason &&
+          (p = static_cast <char*> (mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))) == MAP_FAILED) {
+        reason = "mmap failed";
+      }
+      if (reason) {
+        LOG(ERROR) << "file=" << fn << " cannot be kept persistent: " << reason;
+        ::close (fd);
+        return -1;
+      }
+      clear (false);
+      _attach_file (fd, p, len, h, capacity);
+      return 0;
+    }
+	/**
+	 * flush the pages dirtied since the last sync () and then the header
+	 * that describes them; only the pages that changed are written
+	 */
+    int sync () {
+      if (_fd < 0) {
+        return -1;
+      }
+      file_header h;
+      _file_header (h);
+      h.flags |= FLAG_UNCHECKED;
+      h.section[SECTION_ARRAY].offset = reinterpret_cast <char*> (_array) - _file_map;
+      h.section[SECTION_NINFO].offset = reinterpret_cast <char*> (_ninfo) - _file_map;
+      h.section[SECTION_BLOCK].offset = reinterpret_cast <char*> (_block) - _file_map;
+      h.section[SECTION_ARRAY].length = sizeof (node) * static_cast <size_t> (_size);
+      h.section[SECTION_NINFO].length = sizeof (ninfo) * static_cast <size_t> (_size);
+      h.section[SECTION_BLOCK].length = sizeof (block) * static_cast <size_t> (ArrayToBlock(_size));
+      h.checksum = fnv1a (&h, sizeof (h));
+      const size_t data = h.section[SECTION_ARRAY].offset;
+      if (msync (_file_map + data, _file_len - data, MS_SYNC) != 0) {
+        LOG(ERROR) << "msync failed errno=" << errno;
+        return -1;
+      }
+      std::memcpy (_file_map, &h, sizeof (h));
+      if (msync (_file_map, data, MS_SYNC) != 0) {
+        LOG(ERROR) << "msync failed errno=" << errno;
+        return -1;
+      }
+      return 0;
+    }
+    bool persistent () const { return _fd >= 0; }
+	/**
+	 * rebuild _ninfo and _block from _array; _ninfo is rebuilt block by
+	 * block, by "num_threads" threads (0 for one per core)
+	 */
+    void restore (unsigned num_threads = 0) {
       if (! _block) _restore_block ();
-      if (! _ninfo) _restore_ninfo ();
+      if (! _ninfo) _restore_ninfo (num_threads);
       _capacity = _size;
     }
     void set_array (void* p, size_t in_size = 0) { // ad-hoc
@@ -559,20 +1428,32 @@ namespace cedar {
 	 * free all memory
 	 */
     void clear (const bool reuse = true) {
-	  if (_using_mmap) {
-	    munmap(_array, _size * sizeof(node));
-		munmap(_ninfo, _size * sizeof(ninfo));
-		munmap(_block, _size * sizeof(block));
-		_using_mmap = false;
+	  if (_fd >= 0) { // sections live in the file of open_persistent ()
+	    sync ();
+	    munmap (_file_map, _file_len);
+	    ::close (_fd);
+	    _fd = -1;
+	    _file_map = 0;
+	    _file_len = 0;
 	  } else {
-	    if (not _no_delete) { std::free(_array); }
-	    std::free(_ninfo);
-	    std::free(_block);
+	    if (not _no_delete) {
+	      _release (_array, SECTION_ARRAY);
+	    }
+	    _release (_ninfo, SECTION_NINFO);
+	    _release (_block, SECTION_BLOCK);
 	  }
       _array = 0; 
       _ninfo = 0; 
       _block = 0; 
       _bheadF = _bheadC = _bheadO = _capacity = _size = 0; // *
+      _bnumO = _bnumC = 0;
+      _release (_free, SECTION_FREE);
+      _release (_max, SECTION_MAX);
+      _free = 0;
+      _max = 0;
+      _num_free = _num_max = 0;
+      ++_stamp;
+      _counted = false; // until a loader or _initialize () sets counters
       if (reuse) _initialize ();
       _no_delete = false;
     }
@@ -582,9 +1463,7 @@ namespace cedar {
 	 * return the first child for a tree rooted by a given node
 	 */
     int begin (size_t& from, size_t& len) {
-#if  (USE_FAST_LOAD == 0)
       if (! _ninfo) _restore_ninfo ();
-#endif
       int   base = _array[from].base ();
       uchar c    = _ninfo[from].child;
       if (! from && ! (c = _ninfo[base ^ c].sibling)) // bug fix
@@ -633,8 +1512,28 @@ namespace cedar {
 		}
       } while ((c = _ninfo[base ^ c].sibling));
     }
+
+	/**
+	 * iterate over all keys, or over keys starting with "key", in the order
+	 * of begin () and next (): for (const auto& kv : trie) ...
+	 * Updates invalidate iterators.
+	 */
+    const_iterator begin () const { return const_iterator (*this, 0, "", 0); }
+    const_iterator end   () const { return const_iterator (); }
+    const_iterator predict_begin (const char* key) const
+    { return predict_begin (key, std::strlen (key)); }
+    const_iterator predict_begin (const char* key, size_t len) const {
+      size_t from = 0, pos = 0;
+      if (_find (key, from, pos, len) == CEDAR_NO_PATH && pos < len) {
+        return end ();
+      }
+      return const_iterator (*this, from, key, len);
+    }
     size_t tracking_node[NUM_TRACKING_NODES + 1];
   private:
+    friend class da_const_iterator <da>;
+    friend class da_matcher <da>;
+    friend class aho_corasick <da>; // see cedar_aho.h
     // currently disabled; implement these if you need
     da (const da&) = delete;
     da& operator= (const da&) = delete;
@@ -650,28 +1549,308 @@ namespace cedar {
     int     _capacity{0};
     int     _size{0};
     bool     _no_delete{false};
-    bool    _using_mmap{false};
+    // sections from _alloc that files do not hold
+    enum { SECTION_FREE = NUM_SECTIONS, SECTION_MAX, NUM_ALLOC_SECTIONS };
+    size_t  _mmap_len[NUM_ALLOC_SECTIONS]{}; // mapped bytes of each section; 0 if on heap
+    size_t  _alloc_len[NUM_ALLOC_SECTIONS]{}; // bytes of each section from _alloc
+    allocator_type _alloc;
+    int     _fd{-1};           // file of open_persistent (); -1 if none
+    char*   _file_map{nullptr}; // its MAP_SHARED mapping
+    size_t  _file_len{0};
+    // counters of stats (); _count () recomputes them for loaded tries
+    mutable size_t _num_keys{0};
+    mutable size_t _nonzero_size{0};
+    mutable int    _bnumO{0}; // # blocks on Open but block 0
+    mutable int    _bnumC{0}; // # blocks on Closed but block 0
+    mutable bool   _counted{false};
     short   _reject[257];
+    free_map*   _free{nullptr}; // of each block; see _free_map ()
+    int         _num_free{0};   // # blocks _free maps
+    value_type* _max{nullptr};  // of the values below each node; see _build_max ()
+    int         _num_max{0};    // # nodes _max annotates; 0 if not annotated
+    uint64_t _stamp{1}; // bumped whenever a node is freed or moved; see aho_corasick
     //
+	/**
+	 * return a section to _alloc or unmap a mapped one
+	 */
+    void _release (void* p, const int i) {
+      if (_mmap_len[i]) {
+        munmap (p, _mmap_len[i]);
+      } else if (p) {
+        _alloc.deallocate (p, _alloc_len[i]);
+      }
+      _mmap_len[i] = _alloc_len[i] = 0;
+    }
+	/**
+	 * allocate "n" bytes for a section
+	 */
+    void* _allocate (const int i, const size_t n) {
+      void* const p = _alloc.allocate (n);
+      if (! p) {
+        LOG(FATAL) << "memory allocation failed";
+      }
+      _alloc_len[i] = n;
+      return p;
+    }
+	/**
+	 * resize a section from "size_p" items to "size_n" items; items added
+	 * are value-initialized unless "fill" is false. A mapped section moves
+	 * to memory from _alloc, since a mapping cannot grow beyond the file
+	 */
     template <typename T>
-    static void _realloc_array (T*& p, const int size_n, const int size_p = 0) {
-      void* tmp = std::realloc (p, sizeof (T) * static_cast <size_t> (size_n));
-      if (! tmp) {
-        std::free (p); 
+    void _grow (T*& p, const int i, const int size_n, const int size_p, const bool fill = true) {
+      const size_t n = sizeof (T) * static_cast <size_t> (size_n);
+      void* q = 0;
+      if (_mmap_len[i]) {
+        q = _alloc.allocate (n);
+        if (q) {
+          std::memcpy (q, p, sizeof (T) * static_cast <size_t> (size_p));
+          munmap (p, _mmap_len[i]);
+          _mmap_len[i] = 0;
+        }
+      } else {
+        q = _alloc.reallocate (p, _alloc_len[i], n);
+      }
+      if (! q) {
         LOG(FATAL) << "memory reallocation failed";
       }
-      p = static_cast <T*> (tmp);
-      static const T T0 = T ();
-      T *q = p + size_p;
-      T *const r = p + size_n;
-      for (; q != r; ++q) {
-        *q = T0;
+      p = static_cast <T*> (q);
+      _alloc_len[i] = n;
+      if (fill) {
+        static const T T0 = T ();
+        std::fill (p + size_p, p + size_n, T0);
+      }
+    }
+	/**
+	 * make room for "n" items in section "i", which holds "n_p"; grown to
+	 * "cap" items at once, so that it follows _capacity as _array does
+	 */
+    template <typename T>
+    void _reserve (T*& p, const int i, const int n, const int n_p, const int cap) {
+      if (_alloc_len[i] < sizeof (T) * static_cast <size_t> (n)) {
+        _grow (p, i, std::max (n, cap), n_p, false);
+      }
+    }
+	/**
+	 * lay out sections for "capacity" nodes in a new file of
+	 * open_persistent (); returns the size of the file
+	 */
+    size_t _file_layout (file_header& h, const int capacity) const {
+      const size_t cap = static_cast <size_t> (capacity);
+      _file_header (h);
+      h.section[SECTION_ARRAY].offset = file_align (sizeof (file_header));
+      h.section[SECTION_NINFO].offset = h.section[SECTION_ARRAY].offset + file_align (sizeof (node) * cap);
+      h.section[SECTION_BLOCK].offset = h.section[SECTION_NINFO].offset + file_align (sizeof (ninfo) * cap);
+      return h.section[SECTION_BLOCK].offset + file_align (sizeof (block) * ArrayToBlock(cap));
+    }
+	/**
+	 * lay out the current trie in the file "fd" of open_persistent (),
+	 * whatever it held, and map it
+	 */
+    int _move_into_file (const int fd, const char* fn) {
+      if (! _ninfo || ! _block) {
+        restore ();
+      }
+      file_header h;
+      const size_t len = _file_layout (h, _capacity);
+      char* p = 0;
+      if (ftruncate (fd, static_cast <off_t> (len)) != 0 ||
+          (p = static_cast <char*> (mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))) == MAP_FAILED) {
+        LOG(ERROR) << "file=" << fn << " cannot be extended to size=" << len << " errno=" << errno;
+        ::close (fd);
+        return -1;
+      }
+      std::memcpy (p + h.section[SECTION_ARRAY].offset, _array, sizeof (node) * static_cast <size_t> (_size));
+      std::memcpy (p + h.section[SECTION_NINFO].offset, _ninfo, sizeof (ninfo) * static_cast <size_t> (_size));
+      std::memcpy (p + h.section[SECTION_BLOCK].offset, _block, sizeof (block) * static_cast <size_t> (ArrayToBlock(_size)));
+      const int capacity = _capacity;
+      clear (false);
+      _attach_file (fd, p, len, h, capacity);
+      return sync ();
+    }
+	/**
+	 * # nodes the sections of a file of "len" bytes can hold in place;
+	 * 0 if they are missing or out of order
+	 */
+    static int _file_capacity (const file_header& h, const size_t len) {
+      const uint64_t a = h.section[SECTION_ARRAY].offset;
+      const uint64_t n = h.section[SECTION_NINFO].offset;
+      const uint64_t b = h.section[SECTION_BLOCK].offset;
+      if (h.section[SECTION_NINFO].length != sizeof (ninfo) * static_cast <uint64_t> (h.size) ||
+          h.section[SECTION_BLOCK].length != sizeof (block) * static_cast <uint64_t> (ArrayToBlock(h.size)) ||
+          a > n || n > b || b > len) {
+        return 0;
+      }
+      uint64_t cap = (n - a) / sizeof (node);
+      cap = std::min (cap, (b - n) / sizeof (ninfo));
+      cap = std::min (cap, (len - b) / sizeof (block) * 256);
+      cap = std::min (cap, static_cast <uint64_t> (INT_MAX));
+      return static_cast <int> (cap & ~static_cast <uint64_t> (255));
+    }
+	/**
+	 * take over the mapping "p" of a file of open_persistent ()
+	 */
+    void _attach_file (const int fd, char* p, const size_t len,
+                       const file_header& h, const int capacity) {
+      _fd       = fd;
+      _file_map = p;
+      _file_len = len;
+      advise_huge_pages (p, len);
+      _array    = reinterpret_cast <node*>  (p + h.section[SECTION_ARRAY].offset);
+      _ninfo    = reinterpret_cast <ninfo*> (p + h.section[SECTION_NINFO].offset);
+      _block    = reinterpret_cast <block*> (p + h.section[SECTION_BLOCK].offset);
+      _size     = h.size;
+      _capacity = capacity;
+      _bheadF   = h.bheadF;
+      _bheadC   = h.bheadC;
+      _bheadO   = h.bheadO;
+      _fill_file_tail ();
+    }
+	/**
+	 * initialize ninfo and block beyond _size up to _capacity, as
+	 * _grow () does for sections from _alloc
+	 */
+    void _fill_file_tail () {
+      std::fill (_ninfo + _size, _ninfo + _capacity, ninfo ());
+      std::fill (_block + ArrayToBlock(_size), _block + ArrayToBlock(_capacity), block ());
+    }
+	/**
+	 * grow the file of open_persistent () to hold _capacity nodes; ninfo
+	 * and block sections move up to make room, while _array stays
+	 */
+    void _grow_file () {
+      const size_t cap = static_cast <size_t> (_capacity);
+      const size_t a  = reinterpret_cast <char*> (_array) - _file_map;
+      const size_t n0 = reinterpret_cast <char*> (_ninfo) - _file_map;
+      const size_t b0 = reinterpret_cast <char*> (_block) - _file_map;
+      const size_t n  = std::max (n0, a + file_align (sizeof (node) * cap));
+      const size_t b  = std::max (b0, n + file_align (sizeof (ninfo) * cap));
+      const size_t len = b + file_align (sizeof (block) * ArrayToBlock(cap));
+      if (len > _file_len) {
+        if (ftruncate (_fd, static_cast <off_t> (len)) != 0) {
+          LOG(FATAL) << "ftruncate failed size=" << len << " errno=" << errno;
+        }
+#ifdef MREMAP_MAYMOVE
+        void* p = mremap (_file_map, _file_len, len, MREMAP_MAYMOVE);
+#else
+        munmap (_file_map, _file_len);
+        void* p = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+#endif
+        if (p == MAP_FAILED) {
+          LOG(FATAL) << "mremap failed size=" << len << " errno=" << errno;
+        }
+        _file_map = static_cast <char*> (p);
+        _file_len = len;
+        advise_huge_pages (p, len);
+      }
+      // the last section first, so that nothing is overwritten before moved
+      std::memmove (_file_map + b, _file_map + b0, sizeof (block) * static_cast <size_t> (ArrayToBlock(_size)));
+      std::memmove (_file_map + n, _file_map + n0, sizeof (ninfo) * static_cast <size_t> (_size));
+      _array = reinterpret_cast <node*>  (_file_map + a);
+      _ninfo = reinterpret_cast <ninfo*> (_file_map + n);
+      _block = reinterpret_cast <block*> (_file_map + b);
+      _fill_file_tail ();
+    }
+	/**
+	 * describe this trie in a header of cedar_format.h
+	 */
+    void _file_header (file_header& h) const {
+      file_header_init <value_type, node, ninfo, block>
+        (h, TRIE_DA, NO_VALUE, NO_PATH, ORDERED, MAX_TRIAL, NUM_TRACKING_NODES);
+      h.size   = _size;
+      h.bheadF = _bheadF;
+      h.bheadC = _bheadC;
+      h.bheadO = _bheadO;
+    }
+	/**
+	 * load the sections described by "h" at "offset" of "fd", either by
+	 * reading them or by mapping them all with one mmap ()
+	 */
+    int _open_file (const int fd, const char* fn, const size_t offset,
+                    const file_header& h, const bool use_mmap, const bool load_info = true) {
+      file_header expected;
+      _file_header (expected);
+      if (const char* reason = file_header_mismatch (h, expected)) {
+        LOG(ERROR) << "file=" << fn << " cannot be loaded: " << reason;
+        return -1;
+      }
+      const bool has_info = h.section[SECTION_NINFO].length && h.section[SECTION_BLOCK].length;
+      if (has_info &&
+          (h.section[SECTION_NINFO].length != sizeof (ninfo) * static_cast <size_t> (h.size) ||
+           h.section[SECTION_BLOCK].length != sizeof (block) * static_cast <size_t> (ArrayToBlock(h.size)))) {
+        LOG(ERROR) << "file=" << fn << " cannot be loaded: ninfo or block section is inconsistent";
+        return -1;
+      }
+      size_t end = 0; // of the last section
+      for (int i = 0; i < NUM_SECTIONS; ++i) {
+        if (h.section[i].length) {
+          end = h.section[i].offset + h.section[i].length;
+        }
+      }
+      struct stat st;
+      if (fstat (fd, &st) != 0 || static_cast <size_t> (st.st_size) < offset + end) {
+        LOG(ERROR) << "file=" << fn << " is truncated; expected size=" << offset + end;
+        return -1;
       }
+      clear (false);
+      void* data[NUM_SECTIONS] = {};
+      const bool skip_info = ! has_info || ! load_info;
+      if (use_mmap) {
+        if (skip_info) {
+          end = h.section[SECTION_ARRAY].offset + h.section[SECTION_ARRAY].length;
+        }
+        char* const p = static_cast <char*> (mmap (NULL, end, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset));
+        if (p == MAP_FAILED) {
+          LOG(ERROR) << "file=" << fn << " mmap failed offset=" << offset << " errno=" << errno;
+          _initialize ();
+          return -1;
+        }
+        munmap (p, h.section[SECTION_ARRAY].offset); // header
+        advise_huge_pages (p + h.section[SECTION_ARRAY].offset, end - h.section[SECTION_ARRAY].offset);
+        for (int i = 0; i < NUM_SECTIONS; ++i) {
+          if (h.section[i].length && (i == SECTION_ARRAY || ! skip_info)) {
+            data[i] = p + h.section[i].offset;
+            _mmap_len[i] = file_align (h.section[i].length);
+          }
+        }
+      } else {
+        for (int i = 0; i < NUM_SECTIONS; ++i) {
+          if (! h.section[i].length || (i != SECTION_ARRAY && skip_info)) {
+            continue;
+          }
+          data[i] = _allocate (static_cast <file_section> (i), h.section[i].length);
+          if (pread (fd, data[i], h.section[i].length, offset + h.section[i].offset) !=
+              static_cast <ssize_t> (h.section[i].length) ||
+              (! (h.flags & FLAG_UNCHECKED) &&
+               fnv1a (data[i], h.section[i].length) != h.section[i].checksum)) {
+            LOG(ERROR) << "file=" << fn << " section=" << i << " is corrupted";
+            for (int j = 0; j <= i; ++j) {
+              _release (data[j], static_cast <file_section> (j));
+            }
+            _initialize ();
+            return -1;
+          }
+        }
+      }
+      _array  = static_cast <node*>  (data[SECTION_ARRAY]);
+      _ninfo  = static_cast <ninfo*> (data[SECTION_NINFO]);
+      _block  = static_cast <block*> (data[SECTION_BLOCK]);
+      _size   = _capacity = h.size;
+      _bheadF = h.bheadF;
+      _bheadC = h.bheadC;
+      _bheadO = h.bheadO;
+      if (file_has_counts (h)) { // otherwise counted on the first query
+        _num_keys     = static_cast <size_t> (h.num_keys);
+        _nonzero_size = static_cast <size_t> (h.num_nodes);
+        _count_blocks ();
+        _counted = true;
+      }
+      return 0; // update () restores _ninfo and _block if skipped
     }
     void _initialize () { // initilize the first special block
-      _realloc_array (_array, 256, 256);
-      _realloc_array (_ninfo, 256);
-      _realloc_array (_block, 1);
+      _grow (_array, SECTION_ARRAY, 256, 0, false);
+      _grow (_ninfo, SECTION_NINFO, 256, 0);
+      _grow (_block, SECTION_BLOCK, 1, 0);
 #if (USE_REDUCED_TRIE == 1)
       _array[0] = node (-1, -1);
 #else
@@ -680,7 +1859,12 @@ namespace cedar {
       for (int i = 1; i < 256; ++i)
         _array[i] = node (i == 1 ? -255 : - (i - 1), i == 255 ? -1 : - (i + 1));
       _block[0].ehead = 1; // bug fix for erase
+      _num_free = _num_max = 0; // memory is kept for reuse
+      ++_stamp; // nodes of before are gone
       _capacity = _size = 256;
+      _num_keys = _nonzero_size = 0;
+      _bnumO = _bnumC = 0;
+      _counted = true;
       for (size_t i = 0 ; i <= NUM_TRACKING_NODES; ++i) tracking_node[i] = 0;
       for (short  i = 0; i <= 256; ++i) _reject[i] = i + 1;
     }
@@ -736,21 +1920,156 @@ namespace cedar {
 	  VLOG(1) << "find key=" << key << ",retval=" << retval;
 	  return retval;
     }
-    void _restore_ninfo () {
-      _realloc_array (_ninfo, _size);
-      for (int to = 0; to < _size; ++to) {
-        const int from = _array[to].check;
-        if (from < 0) continue; // skip empty node
-        const int base = _array[from].base ();
-        if (const uchar label = static_cast <uchar> (base ^ to)) // skip leaf
-          _push_sibling (static_cast <size_t> (from), base, label,
-                         ! from || _ninfo[from].child || _array[base ^ 0].check == from);
+	/**
+	 * follow "key" from "from" as far as the trie has it; each key that
+	 * ends on the way leaves its value, length (= pos) and id
+	 *
+	 * @return  false if the walk left the trie, so that no longer key
+	 *          can match
+	 */
+    bool _longest (const char* key, size_t& from, size_t& pos, const size_t len,
+                   int& value, size_t& length, size_t& id) const {
+      for (const uchar* const key_ = reinterpret_cast <const uchar*> (key);
+           pos < len; ) {
+#if (USE_REDUCED_TRIE == 1)
+        if (_array[from].value >= 0) { // a leaf has no children
+          return false;
+        }
+#endif
+        if (! key_[pos]) { // would follow the terminal of "from"
+          return false;
+        }
+        const size_t to = static_cast <size_t> (_array[from].base ()) ^ key_[pos];
+        if (_array[to].check != static_cast <int> (from)) {
+          return false;
+        }
+        from = to;
+        ++pos;
+#if (USE_REDUCED_TRIE == 1)
+        if (_array[from].value >= 0) {
+          value = _array[from].value, length = pos, id = from;
+          continue;
+        }
+#endif
+        const node& n = _array[_array[from].base () ^ 0];
+        if (n.check == static_cast <int> (from)) {
+          value = n.base_, length = pos, id = from;
+        }
+      }
+      return true;
+    }
+	/**
+	 * visit the keys below "from", at depth "d", that are within the
+	 * bound of "rows"
+	 * @return  false if "visit" returned false
+	 */
+    template <typename F>
+    bool _fuzzy (edit_rows& rows, const size_t from, const size_t d, F& visit, size_t& num) const {
+      const int base = _array[from].base ();
+      uchar c = from ? _ninfo[from].child : _ninfo[0].sibling;
+      if (! from && ! c) { // empty
+        return true;
+      }
+      do {
+        const size_t to = static_cast <size_t> (base ^ c);
+        if (! c) { // a key ends at "from"
+          if (rows.within (d)) {
+            ++num;
+            if (! visit (rows.path (d), d, _array[to].value, rows.distance (d))) {
+              return false;
+            }
+          }
+        } else if (rows.push (d + 1, c)) {
+#if (USE_REDUCED_TRIE == 1)
+          if (_array[to].value >= 0) { // leaf
+            if (rows.within (d + 1)) {
+              ++num;
+              if (! visit (rows.path (d + 1), d + 1, _array[to].value, rows.distance (d + 1))) {
+                return false;
+              }
+            }
+            continue;
+          }
+#endif
+          if (! _fuzzy (rows, to, d + 1, visit, num)) {
+            return false;
+          }
+        }
+      } while ((c = _ninfo[base ^ c].sibling));
+      return true;
+    }
+	/**
+	 * siblings share a block, so each block rebuilds their chains and the
+	 * first child of their parent on its own; blocks are split among
+	 * threads, which write disjoint bytes of _ninfo
+	 */
+    void _restore_ninfo (unsigned num_threads = 1) {
+      _grow (_ninfo, SECTION_NINFO, _size, 0);
+      const int num_blocks = ArrayToBlock(_size);
+      if (! num_threads) {
+        num_threads = std::thread::hardware_concurrency ();
+      }
+      num_threads = std::max (1u, std::min (num_threads, static_cast <unsigned> (num_blocks / MIN_RESTORE_BLOCKS)));
+      std::vector <std::thread> threads;
+      for (unsigned t = 1; t < num_threads; ++t) {
+        threads.emplace_back (&da::_restore_ninfo_blocks, this,
+                              static_cast <int> (num_blocks * static_cast <int64_t> (t) / num_threads),
+                              static_cast <int> (num_blocks * static_cast <int64_t> (t + 1) / num_threads));
+      }
+      _restore_ninfo_blocks (0, static_cast <int> (num_blocks / num_threads));
+      for (auto& t : threads) {
+        t.join ();
+      }
+    }
+	/**
+	 * visit the nodes of each block in blocks [bi, bz) from the largest
+	 * label down, and push each in front of the children of its parent
+	 */
+    void _restore_ninfo_blocks (int bi, const int bz) {
+      for (; bi < bz; ++bi) {
+        const int e0 = bi << 8;
+        if (bi + 1 < bz) { // parents of the next block
+          for (int i = 256; i < 512; ++i) {
+            const int from = _array[e0 + i].check;
+            if (from >= 0) {
+              CEDAR_PREFETCH (&_array[from]);
+              CEDAR_PREFETCH (&_ninfo[from]);
+            }
+          }
+        }
+        uchar label[256];
+        int   num[257] = {}; // where nodes go, sorted by label in descending order
+        for (int i = 0; i < 256; ++i) {
+          const int from = _array[e0 + i].check;
+          if (from >= 0) { // skip empty node and the root
+            label[i] = static_cast <uchar> (_array[from].base () ^ (e0 + i));
+            ++num[256 - label[i]];
+          }
+        }
+        for (int l = 1; l <= 256; ++l) {
+          num[l] += num[l - 1];
+        }
+        short order[256];
+        for (int i = 0; i < 256; ++i) {
+          if (_array[e0 + i].check >= 0) {
+            order[num[255 - label[i]]++] = static_cast <short> (i);
+          }
+        }
+        for (int k = 0; k < num[256]; ++k) {
+          const int to = e0 + order[k];
+          const int from = _array[to].check;
+          // children of the root are chained from the root itself (0 ^ 0)
+          uchar& c = from ? _ninfo[from].child : _ninfo[0].sibling;
+          _ninfo[to].sibling = c;
+          c = label[order[k]];
+        }
       }
     }
 
     void _restore_block () {
-      _realloc_array (_block, ArrayToBlock(_size));
+      _grow (_block, SECTION_BLOCK, ArrayToBlock(_size), 0);
       _bheadF = _bheadC = _bheadO = 0;
+      _bnumO = _bnumC = 0;
       for (int bi (0), e (0); e < _size; ++bi) { // register blocks to full
         block& b = _block[bi];
         b.num = 0; // indicates Full block
@@ -765,6 +2084,138 @@ namespace cedar {
       }
     }
 
+	/**
+	 * count keys and nodes in use, and blocks on Open and Closed, for a
+	 * trie loaded without counters
+	 */
+    void _count () const {
+      _num_keys = _nonzero_size = 0;
+      for (int to = 0; to < _size; ++to) {
+        const node& n = _array[to];
+        if (n.check < 0) {
+          continue;
+        }
+        ++_nonzero_size;
+#if (USE_REDUCED_TRIE == 1)
+        const bool leaf = n.value >= 0;
+#else
+        const bool leaf = _array[n.check].base () == to; // i.e. label 0
+#endif
+        if (leaf) {
+          ++_num_keys;
+        }
+      }
+      _count_blocks ();
+      _counted = true;
+    }
+    void _count_blocks () const {
+      _bnumO = _block ? _num_blocks (_bheadO) : 0;
+      _bnumC = _block ? _num_blocks (_bheadC) : 0;
+    }
+	/**
+	 * # blocks but block 0 that _restore_block () puts on Open and Closed
+	 */
+    void _count_blocks_in_array (size_t& open, size_t& closed) const {
+      open = closed = 0;
+      for (int bi = 1; bi < ArrayToBlock(_size); ++bi) {
+        int num = 0; // empty nodes, up to 2
+        for (int e = bi << 8; e < (bi << 8) + 256 && num < 2; ++e) {
+          num += _array[e].check < 0;
+        }
+        if (num == 1) {
+          ++closed;
+        } else if (num) {
+          ++open;
+        }
+      }
+    }
+	/**
+	 * # blocks on the ring from "head" but block 0; 0 if "head" is 0
+	 */
+    int _num_blocks (const int head) const {
+      int n = 0;
+      if (head) {
+        int bi = head;
+        do {
+          n += bi != 0;
+          bi = _block[bi].next;
+        } while (bi != head);
+      }
+      return n;
+    }
+	/**
+	 * keep the number of blocks on Open or Closed, as "head" tells, when
+	 * block "bi" joins (d = 1) or leaves (d = -1) the list
+	 */
+    void _count_block (const int bi, const int& head, const int d) {
+      if (! bi) { // the first block stays out of the counts
+        return;
+      }
+      if (&head == &_bheadO) {
+        _bnumO += d;
+      } else if (&head == &_bheadC) {
+        _bnumC += d;
+      }
+    }
+
+	/**
+	 * freeze () through frozen_minimizer, which takes keys in byte order
+	 */
+    int _freeze_minimized (frozen_type& t) const {
+      frozen_minimizer <value_type> fm;
+      std::vector <std::pair <std::string, value_type> > keys; // to sort
+      for (const_iterator it = begin (); it != end (); ++it) {
+        if (ORDERED) {
+          fm.insert (it->key, it->length, it->value);
+        } else {
+          keys.emplace_back (std::string (it->key, it->length), it->value);
+        }
+      }
+      std::sort (keys.begin (), keys.end ());
+      for (size_t i = 0; i < keys.size (); ++i) {
+        fm.insert (keys[i].first.data (), keys[i].first.size (), keys[i].second);
+      }
+      if (! fm.finish (t)) {
+        LOG(ERROR) << "freeze () failed: trie of size=" << _size << " is too large";
+        return -1;
+      }
+      return 0;
+    }
+	/**
+	 * hash of the "len" labels from "root" down to the completion at
+	 * "from", or 0 if "from" is no longer a completion "len" labels under
+	 * "root"; never ~0, which marks the end of a cursor
+	 */
+    uint64_t _path_hash (const uint64_t from, uint64_t len, const uint64_t root) const {
+      if (from >= static_cast <uint64_t> (_size) || (len && _array[from].check < 0)) {
+        return 0;
+      }
+#if (USE_REDUCED_TRIE == 1)
+      if (_array[from].value < 0)
+#endif
+      {
+        const int to = _array[from].base () ^ 0;
+        if (to < 0 || to >= _size || _array[to].check != static_cast <int> (from)) {
+          return 0;
+        }
+      }
+      uint64_t h = fnv1a (&len, sizeof (len));
+      int e = static_cast <int> (from);
+      for (; len; --len) {
+        const int p = _array[e].check;
+        if (p < 0) {
+          return 0;
+        }
+        const int label = _array[p].base () ^ e;
+        h = fnv1a (&label, sizeof (label), h);
+        e = p;
+      }
+      if (static_cast <uint64_t> (e) != root) {
+        return 0;
+      }
+      h |= 1; // not 0
+      return h == ~uint64_t (0) ? h - 2 : h;
+    }
 	/**
 	 * general purpose func to fill in result_pair or result_triple_type
 	 */
@@ -780,6 +2231,7 @@ namespace cedar {
 	 * unlink block "bi" from the list pointed by "head_in"
 	 */
     void _pop_block (const int bi, int& head_in, const bool last) {
+      _count_block (bi, head_in, -1);
       if (last) { // last one poped; Closed or Open
         head_in = 0;
       } else {
@@ -800,6 +2252,7 @@ namespace cedar {
 	 * insert block "bi" into the doubly linked list starting at "head_out"
 	 */
     void _push_block (const int bi, int& head_out, const bool empty) {
+      _count_block (bi, head_out, 1);
       block& b = _block[bi];
       if (empty) { // the destination is empty
         head_out = b.prev = b.next = bi;
@@ -824,9 +2277,13 @@ namespace cedar {
 #else
         _capacity += _capacity;
 #endif
-        _realloc_array (_array, _capacity, _capacity);
-        _realloc_array (_ninfo, _capacity, _size);
-        _realloc_array (_block, ArrayToBlock(_capacity), ArrayToBlock(_size));
+        if (_fd >= 0) {
+          _grow_file ();
+        } else {
+          _grow (_array, SECTION_ARRAY, _capacity, _size, false);
+          _grow (_ninfo, SECTION_NINFO, _capacity, _size);
+          _grow (_block, SECTION_BLOCK, ArrayToBlock(_capacity), ArrayToBlock(_size));
+        }
         //LOG(INFO) << "realloc new capacity=" << _capacity;
       }
       _block[ArrayToBlock(_size)].ehead = _size;
@@ -835,6 +2292,15 @@ namespace cedar {
         _array[i] = node (-(i - 1), -(i + 1));
 	  }
       _array[_size + 255] = node (- (_size + 254),  -_size);
+      if (_num_free == ArrayToBlock(_size)) {
+        _reserve (_free, SECTION_FREE, _num_free + 1, _num_free, ArrayToBlock(_capacity));
+        _free[_num_free++] = free_map {{~0ULL, ~0ULL, ~0ULL, ~0ULL}};
+      }
+      if (_num_max && _num_max == _size) {
+        _reserve (_max, SECTION_MAX, _size + 256, _num_max, _capacity);
+        std::fill (_max + _size, _max + _size + 256, std::numeric_limits <value_type>::lowest ());
+        _num_max = _size + 256;
+      }
       _push_block (ArrayToBlock(_size), _bheadO, ! _bheadO); // append to block Open
       _size += 256;
       //LOG(INFO) << "realloc new size=" << _size;
@@ -860,6 +2326,8 @@ namespace cedar {
       const int bi = ArrayToBlock(e); // this is modulo 256
       node&  n = _array[e];
       block& b = _block[bi];
+      _mark_free (e, false);
+      _set_max (e, std::numeric_limits <value_type>::lowest ());
       if (--b.num == 0) {
         // no free slots ? transfer a block from Closed to Full
         if (bi) {
@@ -897,6 +2365,7 @@ namespace cedar {
         _array[from].base_ = e ^ label;
       }
 #endif
+      ++_nonzero_size;
 	  VLOG(1) << "pop empty node=" << e << ",block=" << bi << ",total=" << b.num;
       return e;
     }
@@ -907,6 +2376,8 @@ namespace cedar {
     void _push_enode (const int e) {
       const int bi = ArrayToBlock(e);
       block& b = _block[bi];
+      _mark_free (e, true);
+      ++_stamp;
       if (++b.num == 1) { // Full to Closed
         b.ehead = e;
         _array[e] = node (-e, -e);
@@ -927,6 +2398,7 @@ namespace cedar {
 		}
         b.trial = 0;
       }
+      --_nonzero_size;
       VLOG(1) << "push empty node=" << e << ",block=" << bi << " total=" << b.num;
       if (b.reject < _reject[b.num]) {
         b.reject = _reject[b.num];
@@ -1002,6 +2474,187 @@ namespace cedar {
       return p;
     }
 
+	/**
+	 * annotate every node with the largest value below it, for
+	 * topKPredict (); parents are visited first, and raised from their
+	 * children in the reverse order
+	 */
+    void _build_max () {
+      if (! _ninfo) {
+        _restore_ninfo ();
+      }
+      _reserve (_max, SECTION_MAX, _size, 0, _capacity);
+      std::fill (_max, _max + _size, std::numeric_limits <value_type>::lowest ());
+      _num_max = _size;
+      std::vector <int> order;
+      if (_ninfo[0].sibling) {
+        order.push_back (0);
+      }
+      for (size_t i = 0; i < order.size (); ++i) {
+        const int from = order[i];
+#if (USE_REDUCED_TRIE == 1)
+        if (from && _array[from].value >= 0) { // leaf
+          _max[from] = _array[from].value;
+          continue;
+        }
+#endif
+        const int base = _array[from].base ();
+        uchar c = from ? _ninfo[from].child : _ninfo[0].sibling;
+        do {
+          if (c) {
+            order.push_back (base ^ c);
+          } else { // terminal
+            _max[from] = _max[base] = _array[base].value;
+          }
+        } while ((c = _ninfo[base ^ c].sibling));
+      }
+      for (size_t i = order.size (); i-- > 1; ) {
+        const int e = order[i];
+        value_type& m = _max[_array[e].check];
+        if (m < _max[e]) {
+          m = _max[e];
+        }
+      }
+    }
+	/**
+	 * the largest value below "e", from the annotations of its children
+	 */
+    value_type _max_of (const int e) const {
+      if (e && _array[_array[e].check].base () == e) { // terminal
+        return _array[e].value;
+      }
+#if (USE_REDUCED_TRIE == 1)
+      if (e && _array[e].value >= 0) { // leaf
+        return _array[e].value;
+      }
+#endif
+      value_type m = std::numeric_limits <value_type>::lowest ();
+      uchar c = e ? _ninfo[e].child : _ninfo[0].sibling;
+      if (! e && ! c) { // empty
+        return m;
+      }
+      const int base = _array[e].base ();
+      do {
+        if (m < _max[base ^ c]) {
+          m = _max[base ^ c];
+        }
+      } while ((c = _ninfo[base ^ c].sibling));
+      return m;
+    }
+	/**
+	 * bring the annotation of "e", whose value or children changed, and
+	 * of its ancestors up to date; a parent is recomputed only if the
+	 * value it had may have come from the child that went down
+	 */
+    void _update_max (int e) {
+      if (_num_max != _size) { // not annotated
+        return;
+      }
+      value_type m  = _max_of (e);
+      value_type m_ = _max[e];
+      while (m != m_) {
+        _max[e] = m;
+        if (! e) {
+          break;
+        }
+        e = _array[e].check;
+        const value_type p_ = _max[e];
+        const value_type p  = p_ <= m ? m : p_ == m_ ? _max_of (e) : p_;
+        m_ = p_;
+        m  = p;
+      }
+    }
+    void _set_max (const int e, const value_type m) {
+      if (e < _num_max) {
+        _max[e] = m;
+      }
+    }
+	/**
+	 * the free_map of block "bi"; maps of all blocks are rebuilt from
+	 * _array if blocks were loaded or cut off without them
+	 */
+    const free_map& _free_map (const int bi) {
+      const int num_blocks = ArrayToBlock(_size);
+      if (_num_free != num_blocks) {
+        _reserve (_free, SECTION_FREE, num_blocks, 0, ArrayToBlock(_capacity));
+        std::fill (_free, _free + num_blocks, free_map ());
+        _num_free = num_blocks;
+        for (int e = 1; e < _size; ++e) { // but the root
+          if (_array[e].check < 0) {
+            _free[ArrayToBlock(e)].w[(e & 255) >> 6] |= 1ULL << (e & 63);
+          }
+        }
+      }
+      return _free[bi];
+    }
+	/**
+	 * keep the free_map of node "e" in step with the empty ring
+	 */
+    void _mark_free (const int e, const bool empty) {
+      const int bi = ArrayToBlock(e);
+      if (bi >= _num_free) {
+        return; // rebuilt when needed
+      }
+      uint64_t& w = _free[bi].w[(e & 255) >> 6];
+      if (empty) {
+        w |= 1ULL << (e & 63);
+      } else {
+        w &= ~(1ULL << (e & 63));
+      }
+    }
+	/**
+	 * move bit i of a 256-bit map to bit i ^ c: swap halves of every
+	 * 2^k bits for each bit k set in "c"
+	 */
+    static void _xor_permute (uint64_t w[4], const uchar c) {
+      static const uint64_t mask[6] = {
+        0x5555555555555555ULL, 0x3333333333333333ULL, 0x0f0f0f0f0f0f0f0fULL,
+        0x00ff00ff00ff00ffULL, 0x0000ffff0000ffffULL, 0x00000000ffffffffULL};
+      for (int k = 0; k < 6; ++k) {
+        if (c >> k & 1) {
+          for (int i = 0; i < 4; ++i) {
+            w[i] = ((w[i] & mask[k]) << (1 << k)) | ((w[i] >> (1 << k)) & mask[k]);
+          }
+        }
+      }
+      if (c & 64) {
+        std::swap (w[0], w[1]);
+        std::swap (w[2], w[3]);
+      }
+      if (c & 128) {
+        std::swap (w[0], w[2]);
+        std::swap (w[1], w[3]);
+      }
+    }
+	/**
+	 * find a base in block "bi" that puts every label from "first" to
+	 * "last" on an empty node; bases are the bits left after and-ing the
+	 * free_map permuted by each label, so a block costs a few word
+	 * operations per label instead of probing _array from every empty node
+	 * @return  the node the base gives "*first", or -1 if none
+	 */
+    int _find_base_in_block (const int bi, const uchar* const first, const uchar* const last) {
+      const free_map& f = _free_map (bi);
+      uint64_t base[4] = {~0ULL, ~0ULL, ~0ULL, ~0ULL};
+      for (const uchar* p = first; p <= last; ++p) {
+        uint64_t w[4] = {f.w[0], f.w[1], f.w[2], f.w[3]};
+        _xor_permute (w, *p);
+        uint64_t any = 0;
+        for (int i = 0; i < 4; ++i) {
+          any |= base[i] &= w[i];
+        }
+        if (! any) {
+          return -1;
+        }
+      }
+      for (int i = 0; i < 4; ++i) {
+        if (base[i]) {
+          return (bi << 8) | (((i << 6) | ctz64 (base[i])) ^ *first);
+        }
+      }
+      return -1;
+    }
+
 	/**
 	 * explore new block to settle down
 	 */
@@ -1017,13 +2670,8 @@ namespace cedar {
         while (1) { // set candidate block
           block& b = _block[bi];
           if (b.num >= nc && nc < b.reject) { // explore configuration
-            for (int e = b.ehead;;) {
-              const int base = e ^ *first;
-              for (const uchar* p = first; _array[base ^ *++p].check < 0; ) {
-                if (p == last) return b.ehead = e; // no conflict
-			  }
-              if ((e = -_array[e].check) == b.ehead) break;
-            }
+            const int e = _find_base_in_block (bi, first, last);
+            if (e >= 0) return b.ehead = e; // no conflict
 		  }
           b.reject = nc;
           if (b.reject < _reject[b.num]) {
@@ -1042,6 +2690,147 @@ namespace cedar {
       return _add_block () << 8;
     }
 
+	/**
+	 * explore blocks before "limit" on Closed and Open for a base of the
+	 * labels from "first" to "last"; -1 if none has room
+	 */
+    int _find_place_below (const uchar* const first, const uchar* const last, const int limit) {
+      const short nc = static_cast <short> (last - first + 1);
+      const int head[2] = {_bheadC, _bheadO};
+      for (int i = 0; i < 2; ++i) {
+        if (! head[i]) {
+          continue;
+        }
+        int bi = head[i];
+        do {
+          block& b = _block[bi];
+          if (bi < limit && b.num >= nc && nc < b.reject) {
+            const int e = _find_base_in_block (bi, first, last);
+            if (e >= 0) {
+              return e; // no conflict
+            }
+            b.reject = nc;
+          }
+          bi = b.next;
+        } while (bi != head[i]);
+      }
+      return -1;
+    }
+
+	/**
+	 * move every node in block "bi" to blocks before it, together with
+	 * its siblings; false if some do not fit
+	 */
+    template <typename T>
+    bool _evacuate_block (const int bi, T& cf) {
+      for (int e = bi << 8; e < (bi << 8) + 256; ++e) {
+        const int from = _array[e].check;
+        if (from < 0) {
+          continue;
+        }
+        uchar child[256];
+        const int base_p = _array[from].base ();
+        const uchar* const last = _set_child (child, base_p, _ninfo[from].child);
+        const int e_ = _find_place_below (child, last, bi);
+        if (e_ < 0) {
+          return false;
+        }
+        const int base = e_ ^ *child;
+#if (USE_REDUCED_TRIE == 1)
+        _array[from].base_ = -base - 1;
+#else
+        _array[from].base_ = base;
+#endif
+        for (const uchar* p = child; p <= last; ++p) { // to_ => to
+          const int to  = _pop_enode (base, *p, from);
+          const int to_ = base_p ^ *p;
+          _ninfo[to].sibling = p == last ? 0 : *(p + 1);
+          cf (to_, to);
+          node& n  = _array[to];
+          node& n_ = _array[to_];
+#if (USE_REDUCED_TRIE == 1)
+          if ((n.base_ = n_.base_) < 0 && *p) { // copy base
+#else
+          if ((n.base_ = n_.base_) > 0 && *p) { // copy base
+#endif
+            uchar c = _ninfo[to].child = _ninfo[to_].child;
+            do {
+              _array[n.base () ^ c].check = to; // adjust grand son's check
+            } while ((c = _ninfo[n.base () ^ c].sibling));
+          }
+          _track (to_, to);
+          _push_enode (to_);
+        }
+      }
+      return true;
+    }
+
+	/**
+	 * keep tracking_node on a node moved from "to_" to "to", and stale
+	 * cursors; "to_" may be reused at once without _push_enode ()
+	 */
+    void _track (const int to_, const int to) {
+      ++_stamp;
+      if (to < _num_max) {
+        _max[to] = _max[to_];
+      }
+      if (NUM_TRACKING_NODES) {
+        for (size_t j = 0; tracking_node[j] != 0; ++j) {
+          if (tracking_node[j] == static_cast <size_t> (to_)) {
+            tracking_node[j] = static_cast <size_t> (to);
+            break;
+          }
+        }
+      }
+    }
+
+	/**
+	 * give back the room beyond _size; mapped sections stay, since they
+	 * would move to memory from _alloc
+	 */
+    void _shrink_to_fit () {
+      if (_fd >= 0 || _no_delete || _capacity == _size ||
+          _mmap_len[SECTION_ARRAY] || _mmap_len[SECTION_NINFO] || _mmap_len[SECTION_BLOCK]) {
+        return;
+      }
+      _grow (_array, SECTION_ARRAY, _size, _size, false);
+      _grow (_ninfo, SECTION_NINFO, _size, _size);
+      _grow (_block, SECTION_BLOCK, ArrayToBlock(_size), ArrayToBlock(_size));
+      if (_num_free) {
+        _grow (_free, SECTION_FREE, _num_free, _num_free, false);
+      }
+      if (_num_max) {
+        _grow (_max, SECTION_MAX, _num_max, _num_max, false);
+      }
+      _capacity = _size;
+    }
+
+	/**
+	 * explore the last NUM_RECENT_BLOCKS blocks, oldest first, regardless of
+	 * their lists; build_sorted () fills blocks in order (as darts does),
+	 * while a single child takes the oldest empty node to fill older blocks
+	 */
+    int _find_place_recent (const uchar* const first, const uchar* const last) {
+      const short nc = static_cast <short> (last - first + 1);
+      if (nc == 1) {
+        if (_bheadC) return _block[_bheadC].ehead;
+        if (_bheadO) return _block[_block[_bheadO].prev].ehead;
+      }
+      const int   bz = ArrayToBlock(_size);
+      for (int bi = bz > NUM_RECENT_BLOCKS ? bz - NUM_RECENT_BLOCKS : 1; bi < bz; ++bi) {
+        block& b = _block[bi];
+        if (b.num < nc || nc >= b.reject) {
+          continue;
+        }
+        const int e = _find_base_in_block (bi, first, last);
+        if (e >= 0) {
+          return e; // no conflict
+        }
+        b.reject = nc;
+      }
+      return _add_block () << 8;
+    }
+
 	/**
 	 * resolve conflict on base_n ^ label_n = base_p ^ label_p
 	 */
@@ -1078,6 +2867,7 @@ namespace cedar {
         _ninfo[to].sibling = (p == last ? 0 : *(p + 1));
         if (flag && to_ == to_pn) continue; // skip newcomer (no child)
         cf (to_, to); // user-defined callback function to handle moved nodes
+        _track (to_, to);
         node& n  = _array[to];
         node& n_ = _array[to_];
 #if (USE_REDUCED_TRIE == 1)
@@ -1097,6 +2887,7 @@ namespace cedar {
         if (! flag && to_ == to_pn) { // the address is immediately used
           _push_sibling (from_n, to_pn ^ label_n, label_n);
           _ninfo[to_].child = 0; // remember to reset child
+          _set_max (to_, std::numeric_limits <value_type>::lowest ());
 #if (USE_REDUCED_TRIE == 1)
           n_.value = CEDAR_VALUE_LIMIT;
 #else
@@ -1106,16 +2897,227 @@ namespace cedar {
         } else {
           _push_enode (to_);
         }
-        if (NUM_TRACKING_NODES) { // keep the traversed node updated
-          for (size_t j = 0; tracking_node[j] != 0; ++j) {
-            if (tracking_node[j] == static_cast <size_t> (to_)) { 
-			  tracking_node[j] = static_cast <size_t> (to); break;
-            }
-          }
-        }
       }
       return flag ? base ^ label_n : to_pn;
     }
+  };
+
+	/**
+	 * forward iterator over the keys of a subtree of "trie_type"
+	 *
+	 * The current key is kept in a buffer: going down to a child appends
+	 * its label and going up to the parent drops one, so a step costs
+	 * only the labels that change, instead of the walk back to the root
+	 * that suffix () does for each key. Memory is O(depth).
+	 */
+  template <typename trie_type>
+  class da_const_iterator {
+  public:
+    typedef std::forward_iterator_tag                iterator_category;
+    typedef typename trie_type::key_value_type       value_type;
+    typedef std::ptrdiff_t                           difference_type;
+    typedef const value_type*                        pointer;
+    typedef const value_type&                        reference;
+
+    da_const_iterator () : _trie (0), _root (0), _from (END), _key (), _len (0), _kv () {}
+	/**
+	 * the first key below "root", which "prefix" leads to
+	 */
+    da_const_iterator (const trie_type& trie, const size_t root, const char* prefix, const size_t len)
+      : _trie (&trie), _root (root), _from (root), _key (len + 64), _len (len), _kv () {
+      std::memcpy (_key.data (), prefix, len);
+#if (USE_REDUCED_TRIE == 1)
+      if (_trie->_array[_from].value >= 0) {
+        _set ();
+        return;
+      }
+#endif
+      uchar c = _child (_from);
+      if (! _from && ! (c = _sibling (static_cast <size_t> (_trie->_array[0].base ()) ^ c, 0))) {
+        _from = END; // no entry
+        return;
+      }
+      _down (c);
+    }
+    reference operator*  () const { // _key may have been copied or grown
+      _key[_len] = '\0';
+      _kv.key = &_key[0];
+      return _kv;
+    }
+    pointer   operator-> () const { return &**this; }
+    da_const_iterator& operator++ () {
+      const node_type* const array = _trie->_array;
+      size_t from = _from;
+      uchar c = 0;
+#if (USE_REDUCED_TRIE == 1)
+      if (array[from].value < 0)
+#endif
+        c = _sibling (static_cast <size_t> (array[from].base ()) ^ 0, from);
+      for (; ! c && from != _root; --_len) {
+        const size_t to = from;
+        from = static_cast <size_t> (array[from].check);
+        c = _sibling (to, from);
+      }
+      _from = c ? from : END;
+      if (c) {
+        _down (c);
+      }
+      return *this;
+    }
+    da_const_iterator operator++ (int) { da_const_iterator it (*this); ++*this; return it; }
+    bool operator== (const da_const_iterator& it) const { return _from == it._from; }
+    bool operator!= (const da_const_iterator& it) const { return _from != it._from; }
+
+  private:
+    typedef typename trie_type::node node_type;
+    static const size_t END = ~static_cast <size_t> (0);
+    const trie_type* _trie;
+    size_t           _root;
+    size_t           _from;
+    mutable std::vector <char> _key;
+    size_t           _len; // of the key in _key
+    mutable value_type _kv;
+
+	/**
+	 * follow the first children from child "c" of _from down to a key
+	 */
+    void _down (uchar c) {
+      const node_type* const array = _trie->_array; // char stores below may alias members
+      size_t from = _from, len = _len;
+      char* key = _key.data ();
+      for (; c; c = _child (from)) {
+        from = static_cast <size_t> (array[from].base ()) ^ c;
+        if (len + 1 >= _key.size ()) {
+          _key.resize (_key.size () * 2 + 16);
+          key = _key.data ();
+        }
+        key[len++] = static_cast <char> (c);
+      }
+      _from = from, _len = len;
+      _set ();
+    }
+	/**
+	 * the first label below "from", 0 for the end of a key; the root
+	 * heads its own chain (0 ^ 0), as in _ninfo
+	 */
+    uchar _child (const size_t from) const {
+      if (_trie->_ninfo) {
+        return _trie->_ninfo[from].child;
+      }
+      return from ? _probe (from, 0) : 0;
+    }
+	/**
+	 * the label after that of "to" below its parent "from"; 0 if none
+	 */
+    uchar _sibling (const size_t to, const size_t from) const {
+      if (_trie->_ninfo) {
+        return _trie->_ninfo[to].sibling;
+      }
+      const int label = static_cast <int> (to) ^ _trie->_array[from].base ();
+      return label < 255 ? _probe (from, label + 1) : 0;
+    }
+	/**
+	 * the first label from "c" on below "from", 0 if none, for a trie
+	 * opened without _ninfo (see restore ()), which a const iterator does
+	 * not rebuild; the 256 units of the base block are checked, as
+	 * frozen_da finds children
+	 */
+    uchar _probe (const size_t from, int c) const {
+      const node_type* const array = _trie->_array;
+      const int base = array[from].base ();
+      if (base < 0) { // a leaf
+        return 0;
+      }
+      for (; c < 256; ++c) {
+        if (array[base ^ c].check == static_cast <int> (from)) {
+          return static_cast <uchar> (c);
+        }
+      }
+      return 0;
+    }
+    void _set () {
+      _kv.length = _len;
+      _kv.id     = _from;
+#if (USE_REDUCED_TRIE == 1)
+      if (_trie->_array[_from].value >= 0) {
+        _kv.value = _trie->_array[_from].value;
+        return;
+      }
+#endif
+      _kv.value = _trie->_array[_trie->_array[_from].base () ^ 0].value;
+    }
+  };
+
+	/**
+	 * longest-prefix match over input that arrives in chunks, such as
+	 * network buffers: feed () walks each chunk on from the node where
+	 * the last one stopped, so a key split across chunks needs no copy
+	 *
+	 *   trie_t::matcher m (trie);
+	 *   while (m.feed (buf, n) && (n = read (fd, buf, sizeof (buf))) > 0);
+	 *   if (m.found ()) ... m.value (), m.length ()
+	 *
+	 * Updates of the trie invalidate matchers.
+	 */
+  template <typename trie_type>
+  class da_matcher {
+  public:
+    typedef typename trie_type::result_type value_type;
+
+	/**
+	 * match keys below "root", e.g. a node that traverse () reached
+	 */
+    explicit da_matcher (const trie_type& trie, const size_t root = 0)
+      : _trie (&trie) { reset (root); }
+    void reset (const size_t root = 0) {
+      _from   = root;
+      _pos    = 0;
+      _length = 0;
+      _id     = root;
+      _value  = trie_type::CEDAR_NO_VALUE;
+      _alive  = true;
+    }
+	/**
+	 * walk on through "len" bytes of "chunk"
+	 *
+	 * @return  whether a longer key may still match, i.e. more input
+	 *          is worth feeding
+	 */
+    bool feed (const char* chunk, const size_t len) {
+      if (! _alive) {
+        return false;
+      }
+      size_t pos (0), length (0);
+      _alive = _trie->_longest (chunk, _from, pos, len, _value, length, _id);
+      if (length) {
+        _length = _pos + length;
+      }
+      _pos += pos;
+      return _alive;
+    }
+    bool feed (const char* chunk) { return feed (chunk, std::strlen (chunk)); }
+    bool   alive    () const { return _alive; }
+    bool   found    () const { return _length; }
+    size_t consumed () const { return _pos; }    // bytes followed in the trie
+    size_t length   () const { return _length; } // of the longest match
+    size_t id       () const { return _id; }     // where it ends; see suffix ()
+	/**
+	 * value of the longest match so far, or CEDAR_NO_VALUE
+	 */
+    value_type value () const {
+      typename trie_type::int_value_t b;
+      b.i = _value;
+      return b.x;
+    }
+
+  private:
+    const trie_type* _trie;
+    size_t           _from;   // node reached
+    size_t           _pos;
+    size_t           _length;
+    size_t           _id;
+    int              _value;
+    bool             _alive;
   };
 }
 #endif
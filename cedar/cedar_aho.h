@@ -0,0 +1,235 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  aho_corasick: failure links over a trie to find all keys in a text
+#ifndef CEDAR_AHO_H
+#define CEDAR_AHO_H
+
+#include <cstring>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <cedar.h>
+
+/**
+ * Finding every key that occurs in a text by commonPrefixSearch () at each
+ * byte costs O(n * depth). Aho-Corasick walks the text once: each node of
+ * the trie gets a failure link to the node of its longest proper suffix
+ * that is also in the trie, and a link to the nearest node on that chain
+ * where a key ends; a mismatch follows failure links instead of starting
+ * over, and the keys ending at a byte are read off the chain of the
+ * latter links.
+ *
+ * The links are kept beside the trie, indexed by node, and the trie itself
+ * is not changed: transitions and values are read from its _array, so
+ * value updates of existing keys are seen at once. Inserting keys may
+ * relocate nodes and, whether it does or not, changes the failure links of
+ * nodes elsewhere in the trie. build () records the size, the number of
+ * keys and the relocation stamp of the trie, and scan () builds the links
+ * again when any of them has changed; as that writes the links, call
+ * build () after updates if scan () runs in several threads at once.
+ */
+
+namespace cedar {
+  template <typename trie_type>
+  class aho_corasick {
+  public:
+    typedef typename trie_type::result_type value_type;
+
+    aho_corasick () : _link () {}
+    explicit aho_corasick (const trie_type& trie) : _link () { build (trie); }
+
+	/**
+	 * compute the links of every node of "trie" in breadth-first order
+	 */
+    void build (const trie_type& trie) {
+      _trie = &trie;
+      _build ();
+    }
+	/**
+	 * have keys been inserted or erased, or nodes moved, since build ()
+	 */
+    bool stale () const {
+      return _trie && (_size != static_cast <size_t> (_trie->_size) ||
+                       _stamp != _trie->_stamp || _num_keys != _trie->num_keys ());
+    }
+	/**
+	 * call "visit" (start, end, value) for each occurrence of a key at
+	 * [start, end) of "text", by end and then longest first, until it
+	 * returns false
+	 *
+	 * @return  # occurrences visited
+	 */
+    template <typename F>
+    size_t scan (const char* text, F&& visit) const
+    { return scan (text, std::strlen (text), std::forward <F> (visit)); }
+    template <typename F>
+    size_t scan (const char* text, size_t len, F&& visit) const {
+      size_t state = 0;
+      return scan (text, len, std::forward <F> (visit), state);
+    }
+	/**
+	 * scan a text that arrives in chunks: "state" carries the node reached
+	 * from one chunk to the next (0 to start), and positions are counted
+	 * from "offset", the position of "text" in the whole
+	 */
+    template <typename F>
+    size_t scan (const char* text, size_t len, F&& visit, size_t& state, size_t offset = 0) const {
+      if (stale ()) { // the links and "state" name nodes of before
+        _build ();
+        state = 0;
+      }
+      const typename trie_type::node* const array = _trie->_array;
+      const link* const links = _link.data ();
+      const uchar* const text_ = reinterpret_cast <const uchar*> (text);
+      size_t num = 0;
+      int from = static_cast <int> (state);
+      for (size_t i = 0; i < len; ++i) {
+        const uchar c = text_[i];
+        if (! c) { // no key has it
+          from = 0;
+          continue;
+        }
+        for (;;) {
+#if (USE_REDUCED_TRIE == 1)
+          if (array[from].value < 0)
+#endif
+          {
+            const int to = array[from].base () ^ c;
+            if (array[to].check == from) {
+              from = to;
+              break;
+            }
+          }
+          if (! from) {
+            break;
+          }
+          from = links[from].fail;
+        }
+        for (int m = links[from].match; m; m = links[links[m].fail].match) {
+          ++num;
+          if (! visit (offset + i + 1 - links[m].depth, offset + i + 1, _value (m))) {
+            state = static_cast <size_t> (from);
+            return num;
+          }
+        }
+      }
+      state = static_cast <size_t> (from);
+      return num;
+    }
+	/**
+	 * bytes of the links; the trie is not counted
+	 */
+    size_t total_size () const { return sizeof (link) * _link.size (); }
+
+  private:
+    typedef unsigned char uchar;
+    struct link {
+      int      fail;  // node of the longest proper suffix in the trie
+      int      match; // nearest node on the failure chain, this included, where a key ends
+      uint32_t depth; // # labels from the root
+    };
+    const trie_type*   _trie = 0;
+    mutable std::vector <link> _link;
+    mutable size_t     _size = 0;     // of the trie at build ()
+    mutable size_t     _num_keys = 0; // ditto
+    mutable uint64_t   _stamp = 0;    // ditto; bumped by the trie on relocation
+
+	/**
+	 * compute the links of every node of _trie; scan () calls it on a
+	 * stale trie, so it writes only mutable members
+	 */
+    void _build () const {
+      const trie_type& trie = *_trie;
+      _size     = static_cast <size_t> (trie._size);
+      _num_keys = trie.num_keys ();
+      _stamp    = trie._stamp;
+      std::vector <link> (_size).swap (_link);
+      std::vector <int> queue;
+      _for_children (0, [&] (const int to, uchar) {
+        _link[to].depth = 1;
+        _link[to].match = _ends (to) ? to : 0;
+        queue.push_back (to);
+      });
+      for (size_t i = 0; i < queue.size (); ++i) {
+        const int from = queue[i];
+        _for_children (from, [&] (const int to, const uchar c) {
+          int fail = _link[from].fail;
+          int next = _next (fail, c);
+          while (next < 0 && fail) {
+            next = _next (fail = _link[fail].fail, c);
+          }
+          link& l = _link[to];
+          l.fail  = next < 0 ? 0 : next;
+          l.match = _ends (to) ? to : _link[l.fail].match;
+          l.depth = _link[from].depth + 1;
+          queue.push_back (to);
+        });
+      }
+    }
+	/**
+	 * call "f" (to, c) for each child "c" of "from" but the end of a key;
+	 * a trie opened without _ninfo (see restore ()) is not rebuilt behind
+	 * const, and its 256 units of the base block are checked instead
+	 */
+    template <typename F>
+    void _for_children (const int from, F&& f) const {
+      const trie_type& trie = *_trie;
+      if (! trie._ninfo) {
+        for (int c = 1; c < 256; ++c) {
+          const int to = _next (from, static_cast <uchar> (c));
+          if (to >= 0) {
+            f (to, static_cast <uchar> (c));
+          }
+        }
+        return;
+      }
+#if (USE_REDUCED_TRIE == 1)
+      if (from && trie._array[from].value >= 0) { // leaf
+        return;
+      }
+#endif
+      // children of the root are chained from the root itself (0 ^ 0)
+      uchar c = from ? trie._ninfo[from].child : trie._ninfo[0].sibling;
+      if (! c && from) { // the end of a key
+        c = trie._ninfo[_to (from, 0)].sibling;
+      }
+      for (; c; c = trie._ninfo[_to (from, c)].sibling) {
+        f (_to (from, c), c);
+      }
+    }
+
+    int _to (const int from, const uchar c) const { return _trie->_array[from].base () ^ c; }
+	/**
+	 * child "c" of "from", or -1
+	 */
+    int _next (const int from, const uchar c) const {
+#if (USE_REDUCED_TRIE == 1)
+      if (_trie->_array[from].value >= 0) {
+        return -1;
+      }
+#endif
+      const int to = _to (from, c);
+      return _trie->_array[to].check == from ? to : -1;
+    }
+	/**
+	 * does a key end at "from"
+	 */
+    bool _ends (const int from) const {
+#if (USE_REDUCED_TRIE == 1)
+      if (_trie->_array[from].value >= 0) {
+        return true;
+      }
+#endif
+      return _trie->_array[_to (from, 0)].check == from;
+    }
+    value_type _value (const int from) const {
+#if (USE_REDUCED_TRIE == 1)
+      if (_trie->_array[from].value >= 0) {
+        return _trie->_array[from].value;
+      }
+#endif
+      return _trie->_array[_to (from, 0)].value;
+    }
+  };
+}
+#endif
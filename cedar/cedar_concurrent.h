@@ -0,0 +1,197 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  concurrent_da: wait-free readers running alongside a single writer
+#ifndef CEDAR_CONCURRENT_H
+#define CEDAR_CONCURRENT_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+
+#include <cedar.h>
+
+/**
+ * An update may move up to 256 nodes by _resolve () and realloc () _array
+ * by _add_block (), and a node's children name it in their check, so no
+ * order of stores keeps a single array readable while it changes.
+ * concurrent_da therefore keeps two copies of the trie, under left-right
+ * concurrency control (Ramalhete and Correia): readers are on one copy,
+ * and the writer
+ *
+ * 1. applies the update to the other copy, which no reader is on,
+ * 2. publishes it, so that new readers go to the updated copy,
+ * 3. waits for a grace period, until the readers of the old copy have left,
+ * 4. and applies the update to the old copy, which no reader is on now.
+ *
+ * A reader announces itself in a read_indicator, loads which copy to read,
+ * walks it with the plain read functions of da and leaves: it never waits,
+ * retries or takes a lock, and reads only memory that no thread writes at
+ * the same time. The grace period of step 3 is that of RCU, so a buffer
+ * that _add_block () reallocates has no reader left when it is freed;
+ * no buffer needs to be retired.
+ *
+ * Against the usual scheme of one array whose relocated nodes are retired
+ * by epochs or RCU, this costs
+ *
+ * - twice the memory, as both copies hold every node, _ninfo and _block;
+ * - twice the work of each update, which runs once on each copy;
+ * - a writer that waits: an update waits for the lookups that were
+ *   running when it published. Each lookup is short, but one that the
+ *   scheduler preempts holds the writer for a time slice, so run no more
+ *   busy reader threads than there are spare cores.
+ *
+ * That scheme keeps readers on the array the writer changes, so each
+ * relocation would have to copy the moved nodes together with their
+ * subtrees, as children name their parent, and publish them by one store
+ * of the parent's base; its readers also retry or wait whenever a walk
+ * meets nodes that are being moved. Left-right instead keeps updates
+ * those of da and lets readers run untouched.
+ */
+
+namespace cedar {
+  /**
+   * readers of one version of concurrent_da: counters that a reader adds
+   * 1 to when it arrives and takes 1 from when it leaves, one cache line
+   * each, so that readers of different threads rarely share a line
+   */
+  class read_indicator {
+  public:
+    static const size_t NUM_SLOTS = 64; // must be a power of 2
+    read_indicator () {
+      for (size_t i = 0; i < NUM_SLOTS; ++i) _slot[i].readers = 0;
+    }
+	/**
+	 * announce a reader; returns the slot to depart () from
+	 */
+    size_t arrive () {
+      static thread_local const size_t i
+        = std::hash <std::thread::id> () (std::this_thread::get_id ()) & (NUM_SLOTS - 1);
+      _slot[i].readers.fetch_add (1);
+      return i;
+    }
+    void depart (const size_t i) { _slot[i].readers.fetch_sub (1); }
+	/**
+	 * have all readers that arrived departed
+	 */
+    bool empty () const {
+      for (size_t i = 0; i < NUM_SLOTS; ++i) {
+        if (_slot[i].readers.load ()) return false;
+      }
+      return true;
+    }
+  private:
+    read_indicator (const read_indicator&) = delete;
+    read_indicator& operator= (const read_indicator&) = delete;
+    struct alignas (64) slot { std::atomic <uint64_t> readers; }; // one cache line each
+    slot _slot[NUM_SLOTS];
+  };
+
+  /**
+   * double array trie with one writer and any number of wait-free readers
+   *
+   * update () and erase () are serialized by an internal mutex; the read
+   * functions may be called from any thread at any time.
+   */
+  template <typename value_type,
+            const int     NO_VALUE  = NaN <value_type>::N1,
+            const int     NO_PATH   = NaN <value_type>::N2,
+            const bool    ORDERED   = true,
+            const int     MAX_TRIAL = 1,
+            const size_t  NUM_TRACKING_NODES = 0>
+  class concurrent_da {
+  public:
+    typedef da <value_type, NO_VALUE, NO_PATH, ORDERED, MAX_TRIAL, NUM_TRACKING_NODES> trie_type;
+    typedef typename trie_type::result_type        result_type;
+    typedef typename trie_type::result_pair_type   result_pair_type;
+    typedef typename trie_type::result_triple_type result_triple_type;
+    enum error_code { CEDAR_NO_VALUE = NO_VALUE, CEDAR_NO_PATH = NO_PATH };
+
+    concurrent_da () : _trie (), _reading (0), _version (0) {}
+
+	/**
+	 * insert "key" or add "val" to its value; returns the new value
+	 */
+    value_type update (const char* key) { return update (key, std::strlen (key)); }
+    value_type update (const char* key, size_t len, value_type val = value_type (0)) {
+      std::lock_guard <std::mutex> lock (_writer);
+      const int r = _reading.load ();
+      _trie[r ^ 1].update (key, len, val);
+      _publish (r ^ 1);
+      return _trie[r].update (key, len, val);
+    }
+    int erase (const char* key) { return erase (key, std::strlen (key)); }
+    int erase (const char* key, size_t len) {
+      std::lock_guard <std::mutex> lock (_writer);
+      const int r = _reading.load ();
+      const int ret = _trie[r ^ 1].erase (key, len);
+      if (ret != 0) return ret; // no such key; nothing to publish
+      _publish (r ^ 1);
+      return _trie[r].erase (key, len);
+    }
+
+	/**
+	 * does given key exist
+	 */
+    template <typename T>
+    T exactMatchSearch (const char* key) const
+    { return exactMatchSearch <T> (key, std::strlen (key)); }
+    template <typename T>
+    T exactMatchSearch (const char* key, size_t len) const {
+      reader r (*this);
+      return r.trie.template exactMatchSearch <T> (key, len);
+    }
+	/**
+	 * return all strings in trie which are prefix of "key"
+	 */
+    template <typename T>
+    size_t commonPrefixSearch (const char* key, T* result, size_t result_len) const
+    { return commonPrefixSearch (key, result, result_len, std::strlen (key)); }
+    template <typename T>
+    size_t commonPrefixSearch (const char* key, T* result, size_t result_len, size_t len) const {
+      reader r (*this);
+      return r.trie.commonPrefixSearch (key, result, result_len, len);
+    }
+    size_t num_keys () const { reader r (*this); return r.trie.num_keys (); }
+    size_t size () const { reader r (*this); return r.trie.size (); }
+
+  private:
+    concurrent_da (const concurrent_da&) = delete;
+    concurrent_da& operator= (const concurrent_da&) = delete;
+
+	/**
+	 * RAII read-side critical section on the copy readers are sent to
+	 */
+    struct reader {
+      explicit reader (const concurrent_da& t)
+        : owner (t), version (t._version.load ()), slot (t._indicator[version].arrive ()),
+          trie (t._trie[t._reading.load ()]) {}
+      ~reader () { owner._indicator[version].depart (slot); }
+      const concurrent_da& owner;
+      const int            version;
+      const size_t         slot;
+      const trie_type&     trie;
+    };
+
+    trie_type                 _trie[2];
+    mutable std::mutex        _writer;
+    mutable read_indicator    _indicator[2]; // readers that arrived at each _version
+    std::atomic <int>         _reading;      // copy that new readers go to
+    std::atomic <int>         _version;      // read_indicator that new readers arrive at
+
+	/**
+	 * send new readers to copy "r", and wait until no reader is on the
+	 * other one; readers that arrived at the old _version may have loaded
+	 * either copy, so both indicators are drained in turn
+	 */
+    void _publish (const int r) {
+      _reading.store (r);
+      const int v = _version.load ();
+      while (! _indicator[v ^ 1].empty ()) std::this_thread::yield ();
+      _version.store (v ^ 1);
+      while (! _indicator[v].empty ()) std::this_thread::yield ();
+    }
+  };
+}
+#endif
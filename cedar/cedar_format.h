@@ -0,0 +1,224 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  single-file trie container shared by cedar.h and cedarpp.h
+#ifndef CEDAR_FORMAT_H
+#define CEDAR_FORMAT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+#include <unistd.h>
+
+#include <cedar_config.h>
+
+/**
+ * A saved trie is one file:
+ *
+ *   offset 0          file_header (magic, version, unit sizes, template
+ *                     parameters, cedar_config.h flags, block list heads,
+ *                     section table, checksums)
+ *   page aligned      array section: node[size]
+ *   page aligned      ninfo section: ninfo[size]       (may be empty)
+ *   page aligned      block section: block[size >> 8]  (may be empty)
+ *   page aligned      tail section:  _tail             (cedarpp.h only)
+ *
+ * Section offsets are relative to the header, and are multiples of
+ * FILE_ALIGN, so that a single mmap (2) of the file maps every section
+ * without copying. Each section and the header carry an FNV-1a checksum,
+ * except that files kept by open_persistent () of cedar.h have reserved
+ * room between sections and no section checksums (FLAG_UNCHECKED).
+ *
+ * Version 2 appends the counters of stats () to the header, so that a
+ * loaded trie knows its number of keys without scanning the array.
+ * Version 1 headers, which end at "checksum", are still read; tries
+ * loaded from them count their keys on the first query.
+ *
+ * A frozen_da of cedar_frozen.h has only the array section, of 4-byte units;
+ * a minimized one keeps its ranks, values and large ranks in the ninfo, block
+ * and tail sections.
+ */
+
+namespace cedar {
+  static const char     FILE_MAGIC[8] = {'C', 'E', 'D', 'A', 'R', 'D', 'A', '\0'};
+  static const uint32_t FILE_VERSION  = 2;
+  static const size_t   FILE_ALIGN    = 4096; // mmap requires page boundary
+
+  enum file_section { SECTION_ARRAY, SECTION_NINFO, SECTION_BLOCK, SECTION_TAIL, NUM_SECTIONS };
+  enum file_trie_kind { TRIE_DA = 0, TRIE_PREFIX_DA = 1, TRIE_FROZEN_DA = 2 }; // cedar.h / cedarpp.h / cedar_frozen.h
+  // cedar_config.h flags and the ORDERED template parameter
+  static const uint32_t FLAG_FAST_LOAD    = 1 << 0;
+  static const uint32_t FLAG_PREFIX_TRIE  = 1 << 1;
+  static const uint32_t FLAG_REDUCED_TRIE = 1 << 2;
+  static const uint32_t FLAG_EXACT_FIT    = 1 << 3;
+  static const uint32_t FLAG_ORDERED      = 1 << 4;
+  static const uint32_t FLAG_UNCHECKED    = 1 << 5; // kept in place; no section checksums
+  // kind of value_type
+  static const uint32_t VALUE_INTEGRAL = 1 << 0;
+  static const uint32_t VALUE_FLOATING = 1 << 1;
+  static const uint32_t VALUE_SIGNED   = 1 << 2;
+
+  struct file_header { // fixed-width fields, no padding
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t trie_kind;
+    uint32_t flags;
+    uint32_t node_size;
+    uint32_t ninfo_size;
+    uint32_t block_size;
+    uint32_t value_size;
+    uint32_t value_kind;
+    int32_t  no_value;
+    int32_t  no_path;
+    int32_t  max_trial;
+    uint64_t num_tracking_nodes;
+    int32_t  size;     // # nodes in array
+    int32_t  bheadF;
+    int32_t  bheadC;
+    int32_t  bheadO;
+    struct section {
+      uint64_t offset;   // from the header
+      uint64_t length;   // in bytes
+      uint64_t checksum;
+    } section[NUM_SECTIONS];
+    uint64_t checksum; // of this header with checksum = 0
+    // version 2
+    uint64_t num_keys;
+    uint64_t num_nodes;   // nodes in use but the root
+    uint64_t tail_length; // bytes of tails in use (cedarpp.h)
+  };
+  static const uint32_t FILE_HEADER_SIZE_V1 = offsetof (file_header, num_keys);
+
+  inline uint64_t fnv1a (const void* p, const size_t len, uint64_t h = 0xcbf29ce484222325ULL) {
+    for (const unsigned char* q = static_cast <const unsigned char*> (p), * const r = q + len; q != r; ++q)
+      h = (h ^ *q) * 0x100000001b3ULL;
+    return h;
+  }
+  inline size_t file_align (const size_t n) { return (n + FILE_ALIGN - 1) & ~(FILE_ALIGN - 1); }
+
+  inline uint32_t file_config_flags (const bool ordered) {
+    return (USE_FAST_LOAD    ? FLAG_FAST_LOAD    : 0u) |
+           (USE_PREFIX_TRIE  ? FLAG_PREFIX_TRIE  : 0u) |
+           (USE_REDUCED_TRIE ? FLAG_REDUCED_TRIE : 0u) |
+           (USE_EXACT_FIT    ? FLAG_EXACT_FIT    : 0u) |
+           (ordered          ? FLAG_ORDERED      : 0u);
+  }
+  template <typename T>
+  uint32_t file_value_kind () {
+    return (std::is_integral <T>::value       ? VALUE_INTEGRAL : 0u) |
+           (std::is_floating_point <T>::value ? VALUE_FLOATING : 0u) |
+           (std::is_signed <T>::value         ? VALUE_SIGNED   : 0u);
+  }
+
+	/**
+	 * fill in the part of a header that describes the trie type
+	 */
+  template <typename value_type, typename node, typename ninfo, typename block>
+  void file_header_init (file_header& h, const file_trie_kind kind,
+                         const int no_value, const int no_path, const bool ordered,
+                         const int max_trial, const size_t num_tracking_nodes) {
+    std::memset (&h, 0, sizeof (h));
+    std::memcpy (h.magic, FILE_MAGIC, sizeof (h.magic));
+    h.version     = FILE_VERSION;
+    h.header_size = sizeof (file_header);
+    h.trie_kind   = kind;
+    h.flags       = file_config_flags (ordered);
+    h.node_size   = sizeof (node);
+    h.ninfo_size  = sizeof (ninfo);
+    h.block_size  = sizeof (block);
+    h.value_size  = sizeof (value_type);
+    h.value_kind  = file_value_kind <value_type> ();
+    h.no_value    = no_value;
+    h.no_path     = no_path;
+    h.max_trial   = max_trial;
+    h.num_tracking_nodes = num_tracking_nodes;
+  }
+
+	/**
+	 * lay out sections one after another from the first page after the
+	 * header, and checksum their contents and the header
+	 */
+  inline void file_header_seal (file_header& h, const void* const data[NUM_SECTIONS]) {
+    uint64_t offset = file_align (sizeof (file_header));
+    for (int i = 0; i < NUM_SECTIONS; ++i) {
+      h.section[i].offset   = offset;
+      h.section[i].checksum = fnv1a (data[i], h.section[i].length);
+      offset += file_align (h.section[i].length);
+    }
+    h.checksum = 0;
+    h.checksum = fnv1a (&h, sizeof (h));
+  }
+
+	/**
+	 * write a sealed header and its sections; works for append mode too
+	 */
+  inline int file_write (FILE* fp, const file_header& h, const void* const data[NUM_SECTIONS]) {
+    static const char zero[FILE_ALIGN] = {};
+    if (std::fwrite (&h, sizeof (h), 1, fp) != 1) return -1;
+    uint64_t written = sizeof (h);
+    for (int i = 0; i < NUM_SECTIONS; ++i) {
+      if (! h.section[i].length) continue;
+      for (uint64_t pad = h.section[i].offset - written; pad; ) { // zero fill
+        const size_t n = pad < FILE_ALIGN ? static_cast <size_t> (pad) : FILE_ALIGN;
+        if (std::fwrite (zero, 1, n, fp) != n) return -1;
+        pad -= n;
+      }
+      if (std::fwrite (data[i], 1, h.section[i].length, fp) != h.section[i].length) return -1;
+      written = h.section[i].offset + h.section[i].length;
+    }
+    return 0;
+  }
+
+	/**
+	 * read a header at "offset" of "fd"
+	 * @return  1 if no container is there (legacy format), 0 if a valid
+	 *          header is read, -1 if the header is truncated or corrupted
+	 */
+  inline int file_read_header (const int fd, const size_t offset, file_header& h) {
+    const ssize_t n = pread (fd, &h, sizeof (h), static_cast <off_t> (offset));
+    if (n < static_cast <ssize_t> (sizeof (h.magic)) ||
+        std::memcmp (h.magic, FILE_MAGIC, sizeof (h.magic)) != 0)
+      return 1;
+    if (n < static_cast <ssize_t> (FILE_HEADER_SIZE_V1) ||
+        h.header_size < FILE_HEADER_SIZE_V1 || h.header_size > sizeof (h) ||
+        n < static_cast <ssize_t> (h.header_size)) return -1;
+    // fields of later versions than the writer's are zero
+    std::memset (reinterpret_cast <char*> (&h) + h.header_size, 0, sizeof (h) - h.header_size);
+    const uint64_t checksum = h.checksum;
+    h.checksum = 0;
+    h.checksum = fnv1a (&h, h.header_size);
+    return h.checksum == checksum ? 0 : -1;
+  }
+
+	/**
+	 * does "h" carry the counters of the trie it describes; files of
+	 * open_persistent () may have pages newer than their header
+	 */
+  inline bool file_has_counts (const file_header& h) {
+    return h.version >= 2 && ! (h.flags & FLAG_UNCHECKED);
+  }
+
+	/**
+	 * check if a trie described by "h" can be loaded as "expected"
+	 * @return  0 if compatible, or the reason why not
+	 */
+  inline const char* file_header_mismatch (const file_header& h, const file_header& expected) {
+    if (h.version > expected.version)                return "unsupported format version";
+    if (h.trie_kind  != expected.trie_kind)          return "trie kind (cedar.h / cedarpp.h / frozen) differs";
+    if (h.node_size  != expected.node_size ||
+        h.ninfo_size != expected.ninfo_size ||
+        h.block_size != expected.block_size)         return "unit sizes differ";
+    if (h.value_size != expected.value_size ||
+        h.value_kind != expected.value_kind)         return "value_type differs";
+    if ((h.flags ^ expected.flags) & FLAG_REDUCED_TRIE) return "USE_REDUCED_TRIE differs";
+    if ((h.flags ^ expected.flags) & FLAG_ORDERED)   return "ORDERED differs";
+    if (h.size < 256 || h.size % 256 ||
+        h.section[SECTION_ARRAY].length != static_cast <uint64_t> (h.size) * h.node_size)
+      return "array section is inconsistent";
+    for (int i = 0; i < NUM_SECTIONS; ++i)
+      if (h.section[i].offset % FILE_ALIGN)          return "section is not aligned";
+    return 0;
+  }
+}
+#endif
@@ -0,0 +1,696 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  frozen_da: immutable trie of 4-byte units for serving
+#ifndef CEDAR_FROZEN_H
+#define CEDAR_FROZEN_H
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cedar_config.h>
+#include <cedar_format.h>
+#include <cedar_memory.h>
+
+/**
+ * da::freeze () exports a trie into a frozen_da, which only looks keys up.
+ * Each node is one 32-bit unit, laid out as in darts-clone:
+ *
+ *   bit  0 -  7   label of the node, in place of the "check" int
+ *   bit  8        has a leaf (the key ending here has a value)
+ *   bit  9        offset is shifted left by 8
+ *   bit 10 - 31   offset; the children of node "id" are at id ^ offset ^ c
+ *
+ * and a leaf unit, at id ^ offset ^ 0, holds the value in bits 0 - 30 with
+ * bit 31 set, so that it never matches a label. No two nodes share a base
+ * (id ^ offset) unless they have the same children, hence a child is known
+ * to be ours by its label alone. There is no _ninfo, _block or tail, and no
+ * parent link: suffix () cannot be supported, and commonPrefixPredict ()
+ * finds the children of a node by checking the labels of the 256 units of
+ * its base block.
+ *
+ * Values must lie in [0, 2^31); freeze () fails otherwise. A frozen trie is
+ * saved in the container of cedar_format.h (TRIE_FROZEN_DA) with only the
+ * array section, and open_with_mmap () maps it shared and read-only.
+ *
+ * freeze (t, true) minimizes the trie into a directed acyclic word graph
+ * first (frozen_minimizer): subtrees with the same keys are kept once, and
+ * units of nodes that share them point to the same base. A node shared by
+ * keys of different values cannot hold a value, so the values are kept in
+ * key order in a side array, and each unit carries, in a rank array, the
+ * number of keys that its left siblings and its parent lead to. The sum of
+ * the ranks along the path to a key is then the index of its value (a
+ * minimal perfect hash); node ids returned by searches carry the sum in
+ * their upper 32 bits, so that searches resume from them as usual. Ranks
+ * take 16 bits; the few of 2^15 or more, found near the root, are kept in
+ * another array and referred to by their index with bit 15 set. Values may
+ * be anything then; the rank, value and large rank arrays are kept in the
+ * ninfo, block and tail sections of the file.
+ */
+
+namespace cedar {
+  template <typename T> struct NaN;
+  struct frozen_unit {
+    static bool     has_leaf (const uint32_t u) { return (u >> 8) & 1; }
+    static int      value    (const uint32_t u) { return static_cast <int> (u & ((1U << 31) - 1)); }
+    static uint32_t label    (const uint32_t u) { return u & ((1U << 31) | 0xFF); }
+    static uint32_t offset   (const uint32_t u) { return (u >> 10) << ((u & (1U << 9)) >> 6); }
+  };
+
+	/**
+	 * lay out the units of a frozen_da node by node from the root down;
+	 * place () finds a base for the children of a node among the free
+	 * units of the last NUM_RECENT_BLOCKS blocks, as build_sorted () does
+	 */
+  class frozen_builder {
+  public:
+    static const uint32_t NUM_RECENT_BLOCKS = 16;
+    frozen_builder () : _units (), _extras (NUM_RECENT_BLOCKS * 256), _head (0)
+    { _reserve (0); }
+	/**
+	 * give the node "id" children labeled "label[0, n)"; label 0 makes a
+	 * leaf for set_value (). The children are at base ^ label.
+	 * @return  false if the array outgrows what offsets can reach
+	 */
+    bool place (const uint32_t id, const unsigned char* label, const size_t n, uint32_t& base) {
+      base = _find_base (id, label, n);
+      if (! link (id, base, false)) return false;
+      for (size_t i = 0; i < n; ++i) {
+        const uint32_t to = base ^ label[i];
+        _reserve (to);
+        if (label[i]) {
+          _units[to] = label[i];
+        } else {
+          _units[id] |= 1U << 8;
+        }
+      }
+      _extra (base).used = true; // once its block is there
+      return true;
+    }
+	/**
+	 * let the node "id" share the children placed at "base"
+	 * @return  false if the offset cannot be encoded
+	 */
+    bool link (const uint32_t id, const uint32_t base, const bool leaf) {
+      const uint32_t offset = id ^ base;
+      if (offset >= 1U << 29 || ((offset & 0xFF) && offset >= 1U << 21)) return false;
+      uint32_t& u = _units[id];
+      u &= (1U << 31) | (1U << 8) | 0xFF;
+      u |= offset < 1U << 21 ? offset << 10 : (offset << 2) | (1U << 9);
+      if (leaf) u |= 1U << 8;
+      return true;
+    }
+    void set_value (const uint32_t base, const int value)
+    { _units[base] = static_cast <uint32_t> (value) | (1U << 31); }
+    std::vector <uint32_t>& units () { return _units; }
+
+  private:
+    struct extra { uint32_t prev, next; bool fixed, used; };
+    std::vector <uint32_t> _units;
+    std::vector <extra>    _extras; // ring over the units of the recent blocks
+    uint32_t               _head;   // first free unit; _units.size () if none
+
+    extra& _extra (const uint32_t id) { return _extras[id % _extras.size ()]; }
+    uint32_t _find_base (const uint32_t id, const unsigned char* label, const size_t n) {
+      const uint32_t size = static_cast <uint32_t> (_units.size ());
+      if (_head < size) {
+        uint32_t e = _head;
+        do {
+          const uint32_t base = e ^ label[0];
+          if (_valid_base (id, base, label, n)) return base;
+          e = _extra (e).next;
+        } while (e != _head);
+      }
+      return size | (id & 0xFF); // a new block; offset has no low bits
+    }
+    bool _valid_base (const uint32_t id, const uint32_t base, const unsigned char* label, const size_t n) {
+      if (_extra (base).used) return false;
+      const uint32_t offset = id ^ base; // must be encodable
+      if ((offset & 0xFF) && offset >= 1U << 21) return false;
+      for (size_t i = 1; i < n; ++i)
+        if (_extra (base ^ label[i]).fixed) return false;
+      return true;
+    }
+    // take unit "id" off the free list
+    void _reserve (const uint32_t id) {
+      if (id >= _units.size ()) _add_block ();
+      extra& e = _extra (id);
+      if (id == _head) {
+        _head = e.next;
+        if (_head == id) _head = static_cast <uint32_t> (_units.size ());
+      }
+      _extra (e.prev).next = e.next;
+      _extra (e.next).prev = e.prev;
+      e.fixed = true;
+    }
+    // append a block to the free list; the oldest one leaves the ring
+    void _add_block () {
+      const uint32_t size_p = static_cast <uint32_t> (_units.size ());
+      const uint32_t size_n = size_p + 256;
+      if (size_p >> 8 >= NUM_RECENT_BLOCKS)
+        for (uint32_t id = size_p - NUM_RECENT_BLOCKS * 256, last = id + 256; id < last; ++id)
+          if (! _extra (id).fixed) _reserve (id);
+      _units.resize (size_n, 0);
+      for (uint32_t id = size_p; id < size_n; ++id) {
+        extra& e = _extra (id);
+        e.prev = id - 1;
+        e.next = id + 1;
+        e.fixed = e.used = false;
+      }
+      if (_head >= size_p) { // nothing free before
+        _head = size_p;
+        _extra (size_p).prev = size_n - 1;
+        _extra (size_n - 1).next = size_p;
+      } else {
+        const uint32_t tail = _extra (_head).prev;
+        _extra (size_p).prev = tail;
+        _extra (size_n - 1).next = _head;
+        _extra (tail).next = size_p;
+        _extra (_head).prev = size_n - 1;
+      }
+    }
+  };
+
+	/**
+	 * merge equivalent subtrees of keys given in ascending byte order
+	 *
+	 * Nodes on the path of the last key are open; when the next key leaves
+	 * that path, the nodes below the branch are closed one by one from the
+	 * deepest, and each is replaced by an equal node closed before, if any
+	 * (Daciuk et al., 2000). Closed nodes are found by their leaf flag and
+	 * (label, node) pairs in an open-addressing hash table.
+	 */
+  template <typename value_type>
+  class frozen_minimizer {
+  public:
+    frozen_minimizer () : _node (), _edge (), _table (1024, 0), _open (1), _depth (0), _last (), _value () {}
+    size_t num_keys  () const { return _value.size (); }
+    size_t num_nodes () const { return _node.size (); }
+	/**
+	 * @return  false if "key" is empty, or not after the last key
+	 */
+    bool insert (const char* key, const size_t len, const value_type val) {
+      size_t p = 0;
+      while (p < len && p < _last.size () && key[p] == _last[p]) ++p;
+      if (! len || (! _value.empty () &&
+                    (p == len || (p < _last.size () &&
+                                  static_cast <unsigned char> (key[p]) < static_cast <unsigned char> (_last[p])))))
+        return false;
+      _close (p);
+      for (; _depth < len; ++_depth) {
+        _open[_depth].label = static_cast <unsigned char> (key[_depth]);
+        if (_depth + 1 == _open.size ()) _open.push_back (open_node ());
+        open_node& n = _open[_depth + 1];
+        n.leaf = false;
+        n.child.clear ();
+      }
+      _open[len].leaf = true;
+      _last.assign (key, len);
+      _value.push_back (val);
+      return true;
+    }
+	/**
+	 * lay out the minimized trie and give it to "t" (a frozen_da)
+	 * @return  false if the array outgrows what offsets can reach, or
+	 *          there are more than 2^15 large ranks
+	 */
+    template <typename T>
+    bool finish (T& t) {
+      _close (0);
+      const uint32_t root = _intern (_open[0]);
+      frozen_builder fb;
+      std::vector <uint16_t> rank (256, 0);
+      std::vector <uint32_t> large; // ranks of 2^15 or more
+      std::vector <uint32_t> base (_node.size (), 0); // of the copy placed last
+      struct item { uint32_t node, id; };
+      std::vector <item> todo (1, item {root, 0});
+      unsigned char label[257];
+      while (! todo.empty ()) {
+        const item r = todo.back ();
+        todo.pop_back ();
+        const node& n = _node[r.node];
+        if (base[r.node] && fb.link (r.id, base[r.node], n.leaf)) continue; // shared
+        size_t m = 0;
+        if (n.leaf) label[m++] = 0;
+        for (uint32_t i = 0; i < n.num_edges; ++i)
+          label[m++] = _edge[n.first_edge + i].label;
+        if (! m) continue; // empty trie
+        uint32_t b = 0;
+        if (! fb.place (r.id, label, m, b)) return false;
+        base[r.node] = b;
+        if (n.leaf) fb.set_value (b, 0);
+        if (rank.size () < fb.units ().size ()) rank.resize (fb.units ().size (), 0);
+        uint32_t w = n.leaf ? 1 : 0; // keys before the child
+        for (uint32_t i = 0; i < n.num_edges; ++i) {
+          const edge& e = _edge[n.first_edge + i];
+          if (w >= LARGE_RANK) {
+            if (large.size () == LARGE_RANK) return false;
+            rank[b ^ e.label] = static_cast <uint16_t> (LARGE_RANK | large.size ());
+            large.push_back (w);
+          } else {
+            rank[b ^ e.label] = static_cast <uint16_t> (w);
+          }
+          w += _node[e.to].count;
+        }
+        for (uint32_t i = n.num_edges; i-- > 0; ) { // the first child next
+          const edge& e = _edge[n.first_edge + i];
+          todo.push_back (item {e.to, b ^ e.label});
+        }
+      }
+      rank.resize (fb.units ().size (), 0);
+      t.assign (fb.units (), rank, large, _value);
+      return true;
+    }
+    static const uint32_t LARGE_RANK = 1U << 15;
+
+  private:
+    struct edge { unsigned char label; uint32_t to; };
+    struct node { uint32_t first_edge, num_edges, count; bool leaf; };
+    struct open_node {
+      bool               leaf;
+      std::vector <edge> child; // edges to closed children
+      unsigned char      label; // of the open child
+      open_node () : leaf (false), child (), label (0) {}
+    };
+    std::vector <node>        _node;   // closed ones
+    std::vector <edge>        _edge;
+    std::vector <uint32_t>    _table;  // node + 1, or 0 if empty
+    std::vector <open_node>   _open;   // on the path of the last key
+    size_t                    _depth;  // of the deepest open node
+    std::string               _last;
+    std::vector <value_type>  _value;  // in key order
+
+    // close the open nodes deeper than "depth"
+    void _close (const size_t depth) {
+      for (; _depth > depth; --_depth) {
+        const uint32_t to = _intern (_open[_depth]);
+        open_node& parent = _open[_depth - 1];
+        parent.child.push_back (edge {parent.label, to});
+      }
+    }
+    static uint64_t _hash (const bool leaf, const edge* e, const size_t n) {
+      uint64_t h = leaf ? 0x9e3779b97f4a7c15ULL : 0xcbf29ce484222325ULL;
+      for (size_t i = 0; i < n; ++i)
+        h = (h ^ (static_cast <uint64_t> (e[i].to) << 8 | e[i].label)) * 0x100000001b3ULL;
+      return h ^ (h >> 29);
+    }
+    bool _equal (const node& n, const open_node& o) const {
+      if (n.leaf != o.leaf || n.num_edges != o.child.size ()) return false;
+      for (uint32_t i = 0; i < n.num_edges; ++i) {
+        const edge& e = _edge[n.first_edge + i];
+        if (e.label != o.child[i].label || e.to != o.child[i].to) return false;
+      }
+      return true;
+    }
+    // the closed node equal to "o"; added if none
+    uint32_t _intern (const open_node& o) {
+      const size_t mask = _table.size () - 1;
+      size_t i = _hash (o.leaf, o.child.data (), o.child.size ()) & mask;
+      for (; _table[i]; i = (i + 1) & mask)
+        if (_equal (_node[_table[i] - 1], o)) return _table[i] - 1;
+      node n = {static_cast <uint32_t> (_edge.size ()), static_cast <uint32_t> (o.child.size ()),
+                o.leaf ? 1U : 0U, o.leaf};
+      for (size_t j = 0; j < o.child.size (); ++j) {
+        _edge.push_back (o.child[j]);
+        n.count += _node[o.child[j].to].count;
+      }
+      const uint32_t to = static_cast <uint32_t> (_node.size ());
+      _node.push_back (n);
+      _table[i] = to + 1;
+      if (_node.size () * 2 > _table.size ()) _rehash ();
+      return to;
+    }
+    void _rehash () {
+      std::vector <uint32_t> table (_table.size () * 2, 0);
+      const size_t mask = table.size () - 1;
+      for (uint32_t to = 0; to < _node.size (); ++to) {
+        const node& n = _node[to];
+        size_t i = _hash (n.leaf, &_edge[n.first_edge], n.num_edges) & mask;
+        while (table[i]) i = (i + 1) & mask;
+        table[i] = to + 1;
+      }
+      _table.swap (table);
+    }
+  };
+
+  template <typename value_type,
+            const int NO_VALUE = NaN <value_type>::N1,
+            const int NO_PATH  = NaN <value_type>::N2>
+  class frozen_da {
+  public:
+    enum error_code { CEDAR_NO_VALUE = NO_VALUE, CEDAR_NO_PATH = NO_PATH };
+    typedef value_type result_type;
+    struct result_pair_type {
+      value_type  value;
+      size_t      length;  // prefix length
+    };
+    struct result_triple_type { // for predict ()
+      value_type  value;
+      size_t      length;  // suffix length
+      size_t      id;      // unit where the key ends
+    };
+    static_assert (sizeof (value_type) <= sizeof (int), "values are kept in 31 bits");
+    static_assert (sizeof (size_t) >= sizeof (uint64_t), "node ids carry ranks in upper 32 bits");
+
+    frozen_da () : _owned (), _owned_rank (), _owned_large (), _owned_value (), _units (0), _rank (0),
+                   _large (0), _value (0), _size (0), _num_keys (0), _num_large (0), _map (0), _map_len (0) {}
+    ~frozen_da () { clear (); }
+    size_t size       () const { return _size; }
+    size_t total_size () const {
+      return sizeof (uint32_t) * _size + (_rank ? sizeof (uint16_t) * _size : 0) +
+             sizeof (uint32_t) * _num_large + (_value ? sizeof (value_type) * _num_keys : 0);
+    }
+    size_t unit_size  () const { return sizeof (uint32_t); }
+    size_t num_keys   () const { return _num_keys; }
+    bool   minimized  () const { return _rank; }
+    const void* array () const { return _units; }
+	/**
+	 * take over the units laid out by frozen_builder
+	 */
+    void assign (std::vector <uint32_t>& units, const size_t num_keys) {
+      clear ();
+      _owned.swap (units);
+      _units    = _owned.data ();
+      _size     = _owned.size ();
+      _num_keys = num_keys;
+    }
+	/**
+	 * take over the units, ranks and values made by frozen_minimizer
+	 */
+    void assign (std::vector <uint32_t>& units, std::vector <uint16_t>& rank,
+                 std::vector <uint32_t>& large, std::vector <value_type>& value) {
+      assign (units, value.size ());
+      _owned_rank.swap (rank);
+      _owned_large.swap (large);
+      _owned_value.swap (value);
+      _rank  = _owned_rank.data ();
+      _large = _owned_large.data ();
+      _value = _owned_value.data ();
+      _num_large = _owned_large.size ();
+    }
+    void clear () {
+      if (_map) munmap (_map, _map_len);
+      std::vector <uint32_t> ().swap (_owned);
+      std::vector <uint16_t> ().swap (_owned_rank);
+      std::vector <uint32_t> ().swap (_owned_large);
+      std::vector <value_type> ().swap (_owned_value);
+      _units = _large = 0;
+      _rank  = 0;
+      _value = 0;
+      _size = _num_keys = _num_large = _map_len = 0;
+      _map = 0;
+    }
+
+	/**
+	 * does given key exist
+	 */
+    template <typename T>
+    T exactMatchSearch (const char* key) const
+    { return exactMatchSearch <T> (key, std::strlen (key)); }
+    template <typename T>
+    T exactMatchSearch (const char* key, size_t len, size_t from = 0) const {
+      int_value_t b;
+      size_t pos = 0;
+      b.i = _find (key, from, pos, len);
+      if (b.i == CEDAR_NO_PATH) b.i = CEDAR_NO_VALUE;
+      T result;
+      _set_result (&result, b.x, len, from);
+      return result;
+    }
+	/**
+	 * return all strings in trie which are prefix of "key"
+	 */
+    template <typename T>
+    size_t commonPrefixSearch (const char* key, T* result, size_t result_len) const
+    { return commonPrefixSearch (key, result, result_len, std::strlen (key)); }
+    template <typename T>
+    size_t commonPrefixSearch (const char* key, T* result, size_t result_len, size_t len, size_t from = 0) const {
+      size_t num = 0;
+      commonPrefixSearch (key, len, [&] (const value_type v, const size_t length, const size_t id) {
+        if (num < result_len) _set_result (&result[num], v, length, id);
+        return ++num, true;
+      }, from);
+      return num;
+    }
+	/**
+	 * call "visit" (value, length, id) for each of them, shortest first,
+	 * until it returns false
+	 *
+	 * @return  # strings visited
+	 */
+    template <typename F>
+    size_t commonPrefixSearch (const char* key, F&& visit) const
+    { return commonPrefixSearch (key, std::strlen (key), std::forward <F> (visit)); }
+    template <typename F>
+    size_t commonPrefixSearch (const char* key, size_t len, F&& visit, size_t from = 0) const {
+      size_t num = 0;
+      for (size_t pos = 0; pos < len; ) {
+        int_value_t b;
+        b.i = _find (key, from, pos, pos + 1);
+        if (b.i == CEDAR_NO_VALUE) continue;
+        if (b.i == CEDAR_NO_PATH) return num;
+        ++num;
+        if (! visit (b.x, pos, from)) return num;
+      }
+      return num;
+    }
+	/**
+	 * return all strings in trie which are completions of "key", in
+	 * lexicographic order
+	 */
+    template <typename T>
+    size_t commonPrefixPredict (const char* key, T* result, size_t result_len) const
+    { return commonPrefixPredict (key, result, result_len, std::strlen (key)); }
+    template <typename T>
+    size_t commonPrefixPredict (const char* key, T* result, size_t result_len, size_t len, size_t from = 0) const {
+      size_t num = 0;
+      commonPrefixPredict (key, len, [&] (const value_type v, const size_t length, const size_t id) {
+        if (num < result_len) _set_result (&result[num], v, length, id);
+        return ++num, true;
+      }, from);
+      return num;
+    }
+	/**
+	 * call "visit" (value, length, id) for each of them, in lexicographic
+	 * order, until it returns false
+	 *
+	 * @return  # strings visited
+	 */
+    template <typename F>
+    size_t commonPrefixPredict (const char* key, F&& visit) const
+    { return commonPrefixPredict (key, std::strlen (key), std::forward <F> (visit)); }
+    template <typename F>
+    size_t commonPrefixPredict (const char* key, size_t len, F&& visit, size_t from = 0) const {
+      size_t pos = 0;
+      if (_find (key, from, pos, len) == CEDAR_NO_PATH) return 0;
+      // nodes (with ranks) from "from" down, and the next label to try at each
+      std::vector <size_t>   path (1, from);
+      std::vector <uint32_t> next (1, 0);
+      size_t num = 0;
+      while (! path.empty ()) {
+        const size_t   id   = path.back () & RANK_MASK;
+        const size_t   rank = path.back () >> 32;
+        const uint32_t u    = _units[id];
+        const size_t   base = id ^ frozen_unit::offset (u);
+        uint32_t c = next.back ();
+        if (! c && frozen_unit::has_leaf (u)) {
+          ++num;
+          if (! visit (_value_of (base, rank), path.size () - 1, path.back ())) return num;
+        }
+        for (c = c ? c : 1; c < 256 && frozen_unit::label (_units[base ^ c]) != c; ++c);
+        if (c < 256) {
+          const size_t to = base ^ c;
+          next.back () = c + 1;
+          path.push_back ((rank + _rank_of (to)) << 32 | to);
+          next.push_back (0);
+        } else {
+          path.pop_back ();
+          next.pop_back ();
+        }
+      }
+      return num;
+    }
+    value_type traverse (const char* key, size_t& from, size_t& pos) const
+    { return traverse (key, from, pos, std::strlen (key)); }
+    value_type traverse (const char* key, size_t& from, size_t& pos, size_t len) const {
+      int_value_t b;
+      b.i = _find (key, from, pos, len);
+      return b.x;
+    }
+
+	/**
+	 * save the trie as one file; see cedar_format.h for its layout
+	 */
+    int save (const char* fn, const char* mode = "wb") const {
+      FILE* fp = std::fopen (fn, mode);
+      if (! fp) return -1;
+      file_header h;
+      _file_header (h);
+      h.size     = static_cast <int32_t> (_size);
+      h.num_keys = _num_keys;
+      h.section[SECTION_ARRAY].length = sizeof (uint32_t) * _size;
+      if (_rank) {
+        h.section[SECTION_RANK].length  = sizeof (uint16_t) * _size;
+        h.section[SECTION_VALUE].length = sizeof (value_type) * _num_keys;
+        h.section[SECTION_LARGE].length = sizeof (uint32_t) * _num_large;
+      }
+      const void* const data[NUM_SECTIONS] = {_units, _rank, _value, _large};
+      file_header_seal (h, data);
+      const int ret = file_write (fp, h, data);
+      if (std::fclose (fp) != 0) return -1;
+      return ret;
+    }
+	/**
+	 * load the trie by reading the file, verifying its checksums
+	 */
+    int open (const char* fn, const char* mode = "rb", const size_t offset = 0)
+    { return _open (fn, mode, offset, false); }
+	/**
+	 * map the file shared and read-only, so that processes serving one
+	 * file share its pages; "offset" must be page aligned, and checksums
+	 * are not verified
+	 */
+    int open_with_mmap (const char* fn, const char* mode = "rb", const size_t offset = 0)
+    { return _open (fn, mode, offset, true); }
+
+  private:
+    union int_value_t { int i; value_type x; };
+    static const file_section SECTION_RANK  = SECTION_NINFO;
+    static const file_section SECTION_VALUE = SECTION_BLOCK;
+    static const file_section SECTION_LARGE = SECTION_TAIL;
+    static const size_t       RANK_MASK     = 0xffffffff; // of node ids
+    static const uint32_t     LARGE_RANK    = frozen_minimizer <value_type>::LARGE_RANK;
+    std::vector <uint32_t>   _owned;
+    std::vector <uint16_t>   _owned_rank;
+    std::vector <uint32_t>   _owned_large;
+    std::vector <value_type> _owned_value;
+    const uint32_t*          _units;
+    const uint16_t*          _rank;  // if minimized
+    const uint32_t*          _large; // ranks of LARGE_RANK or more
+    const value_type*        _value; // if minimized
+    size_t                   _size;
+    size_t                   _num_keys;
+    size_t                   _num_large;
+    void*                    _map;
+    size_t                   _map_len;
+
+    frozen_da (const frozen_da&) = delete;
+    frozen_da& operator= (const frozen_da&) = delete;
+
+    // "from" is a unit, and the sum of ranks on the path to it
+    int _find (const char* key, size_t& from, size_t& pos, const size_t len) const {
+      size_t id = from & RANK_MASK, rank = from >> 32;
+      for (const unsigned char* const key_ = reinterpret_cast <const unsigned char*> (key);
+           pos < len; ++pos) {
+        const uint32_t c = key_[pos];
+        const size_t to = id ^ frozen_unit::offset (_units[id]) ^ c;
+        if (! c || frozen_unit::label (_units[to]) != c) {
+          from = rank << 32 | id;
+          return CEDAR_NO_PATH;
+        }
+        rank += _rank_of (to);
+        id = to;
+      }
+      from = rank << 32 | id;
+      const uint32_t u = _units[id];
+      if (! frozen_unit::has_leaf (u)) return CEDAR_NO_VALUE;
+      int_value_t b;
+      b.x = _value_of (id ^ frozen_unit::offset (u), rank);
+      return b.i;
+    }
+    size_t _rank_of (const size_t id) const {
+      if (! _rank) return 0;
+      const uint16_t r = _rank[id];
+      return r < LARGE_RANK ? r : _large[r ^ LARGE_RANK];
+    }
+    value_type _value_of (const size_t leaf, const size_t rank) const {
+      if (_value) return _value[rank];
+      int_value_t b;
+      b.i = frozen_unit::value (_units[leaf]);
+      return b.x;
+    }
+    void _set_result (result_type* x, value_type r, size_t = 0, size_t = 0) const
+    { *x = r; }
+    void _set_result (result_pair_type* x, value_type r, size_t l, size_t = 0) const
+    { x->value = r; x->length = l; }
+    void _set_result (result_triple_type* x, value_type r, size_t l, size_t from) const
+    { x->value = r; x->length = l; x->id = from; }
+
+    void _file_header (file_header& h) const {
+      file_header_init <value_type, uint32_t, uint32_t, uint32_t>
+        (h, TRIE_FROZEN_DA, NO_VALUE, NO_PATH, true, 0, 0);
+      h.flags      = FLAG_ORDERED; // independent of cedar_config.h
+      h.ninfo_size = h.block_size = 0;
+    }
+    int _open (const char* fn, const char* mode, const size_t offset, const bool use_mmap) {
+      FILE* fp = std::fopen (fn, mode);
+      if (! fp) return -1;
+      const int ret = _open_file (fileno (fp), offset, use_mmap);
+      std::fclose (fp);
+      return ret;
+    }
+    int _open_file (const int fd, const size_t offset, const bool use_mmap) {
+      file_header h, expected;
+      if (file_read_header (fd, offset, h) != 0) return -1;
+      _file_header (expected);
+      expected.size = h.size;
+      if (file_header_mismatch (h, expected)) return -1;
+      const bool minimized = h.section[SECTION_RANK].length;
+      if (h.section[SECTION_RANK].length  != (minimized ? sizeof (uint16_t) * h.size : 0) ||
+          h.section[SECTION_VALUE].length != (minimized ? sizeof (value_type) * h.num_keys : 0) ||
+          h.section[SECTION_LARGE].length % sizeof (uint32_t) ||
+          h.section[SECTION_LARGE].length > sizeof (uint32_t) * LARGE_RANK)
+        return -1; // inconsistent sections
+      const size_t num_large = static_cast <size_t> (h.section[SECTION_LARGE].length / sizeof (uint32_t));
+      size_t end = 0; // of the last section
+      for (int i = 0; i < NUM_SECTIONS; ++i)
+        if (h.section[i].length)
+          end = static_cast <size_t> (h.section[i].offset + h.section[i].length);
+      struct stat st;
+      if (fstat (fd, &st) != 0 || static_cast <size_t> (st.st_size) < offset + end)
+        return -1; // truncated
+      clear ();
+      const void* data[NUM_SECTIONS] = {};
+      if (use_mmap) {
+        char* const p = static_cast <char*> (mmap (NULL, end, PROT_READ, MAP_SHARED, fd, static_cast <off_t> (offset)));
+        if (p == MAP_FAILED) return -1;
+        advise_huge_pages (p + h.section[SECTION_ARRAY].offset, end - h.section[SECTION_ARRAY].offset);
+        _map = p;
+        _map_len = end;
+        for (int i = 0; i < NUM_SECTIONS; ++i)
+          if (h.section[i].length) data[i] = p + h.section[i].offset;
+      } else {
+        _owned.resize (static_cast <size_t> (h.size));
+        _owned_rank.resize (minimized ? static_cast <size_t> (h.size) : 0);
+        _owned_value.resize (minimized ? static_cast <size_t> (h.num_keys) : 0);
+        _owned_large.resize (num_large);
+        void* const owned[NUM_SECTIONS] = {_owned.data (), _owned_rank.data (), _owned_value.data (), _owned_large.data ()};
+        for (int i = 0; i < NUM_SECTIONS; ++i) {
+          const size_t length = static_cast <size_t> (h.section[i].length);
+          if (! length) continue;
+          if (pread (fd, owned[i], length, static_cast <off_t> (offset + h.section[i].offset)) !=
+              static_cast <ssize_t> (length) ||
+              fnv1a (owned[i], length) != h.section[i].checksum) {
+            clear ();
+            return -1;
+          }
+          data[i] = owned[i];
+        }
+      }
+      _units    = static_cast <const uint32_t*>   (data[SECTION_ARRAY]);
+      _rank     = static_cast <const uint16_t*>   (data[SECTION_RANK]);
+      _large    = static_cast <const uint32_t*>   (data[SECTION_LARGE]);
+      _value    = static_cast <const value_type*> (data[SECTION_VALUE]);
+      _size     = static_cast <size_t> (h.size);
+      _num_keys = static_cast <size_t> (h.num_keys);
+      _num_large = num_large;
+      return 0;
+    }
+  };
+}
+#endif
@@ -0,0 +1,97 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  rows of the edit distance table for fuzzySearch () of cedar.h and cedarpp.h
+#ifndef CEDAR_FUZZY_H
+#define CEDAR_FUZZY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * fuzzySearch () finds the keys within "max_edits" insertions, deletions
+ * and substitutions of a query by walking the trie depth first. Each label
+ * on the way adds a row to the Levenshtein table of the query against the
+ * labels so far; row d is computed from row d - 1 alone, so that siblings
+ * overwrite the same row, and the walk keeps one row per depth.
+ *
+ * A cell (d, j) can only be within the bound if |d - j| <= max_edits, so a
+ * row is filled in that band of 2 * max_edits + 1 cells, and the cells just
+ * outside it hold max_edits + 1, which is what every cell beyond the bound
+ * is clamped to. A subtree whose row has no cell within the bound is
+ * skipped: the cells of a row never go below the least cell of the row
+ * before it. The walk never goes deeper than len + max_edits.
+ *
+ * Tails of cedarpp.h are fed byte by byte, as labels are.
+ */
+
+namespace cedar {
+  class edit_rows {
+  public:
+    edit_rows (const char* key, const size_t len, const size_t max_edits)
+      : _key (reinterpret_cast <const unsigned char*> (key)), _len (len), _k (max_edits),
+        _row ((len + max_edits + 1) * (len + 1)), _path (len + max_edits + 1, '\0') {
+      for (size_t j = 0; j <= _len; ++j) { // against no labels
+        _row[j] = j <= _k ? j : _k + 1;
+      }
+    }
+	/**
+	 * fill row "d" from row d - 1 and label "c", and keep "c" as byte
+	 * d - 1 of the path
+	 * @return  false if no cell of the row is within the bound
+	 */
+    bool push (const size_t d, const unsigned char c) {
+      if (d > _len + _k) {
+        return false;
+      }
+      const size_t* const p = &_row[(d - 1) * (_len + 1)];
+      size_t* const r = &_row[d * (_len + 1)];
+      const size_t lo = d > _k ? d - _k : 0;
+      const size_t hi = d + _k < _len ? d + _k : _len;
+      size_t min = _k + 1;
+      if (lo) {
+        r[lo - 1] = _k + 1;
+      }
+      for (size_t j = lo; j <= hi; ++j) {
+        size_t x = d;
+        if (j) {
+          x = (p[j] < r[j - 1] ? p[j] : r[j - 1]) + 1;
+          const size_t y = p[j - 1] + (_key[j - 1] != c);
+          x = x < y ? x : y;
+        }
+        r[j] = x = x <= _k ? x : _k + 1;
+        min = x < min ? x : min;
+      }
+      if (hi < _len) {
+        r[hi + 1] = _k + 1;
+      }
+      _path[d - 1] = static_cast <char> (c);
+      return min <= _k;
+    }
+	/**
+	 * the distance between the query and the first "d" bytes of the
+	 * path, or max_edits + 1 if it is more
+	 */
+    size_t distance (const size_t d) const {
+      if (d + _k < _len || _len + _k < d) {
+        return _k + 1;
+      }
+      return _row[d * (_len + 1) + _len];
+    }
+    bool within (const size_t d) const { return distance (d) <= _k; }
+	/**
+	 * the first "d" bytes of the path, null-terminated until the next push ()
+	 */
+    const char* path (const size_t d) {
+      _path[d] = '\0';
+      return _path.c_str ();
+    }
+
+  private:
+    const unsigned char* _key;
+    size_t _len;
+    size_t _k;
+    std::vector <size_t> _row;  // (len + 1) cells per depth
+    std::string          _path; // the labels followed
+  };
+}
+#endif
@@ -0,0 +1,252 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  memory placement shared by cedar.h and cedarpp.h
+#ifndef CEDAR_MEMORY_H
+#define CEDAR_MEMORY_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <cedar_config.h>
+
+/**
+ * Tries get the memory of _array, _ninfo, _block (and _tail, _tail0 of
+ * cedarpp.h) from the allocator given as their last template parameter:
+ *
+ *   struct allocator {
+ *     void* allocate   (size_t n);                  // 0 if no memory
+ *     void* reallocate (void* p, size_t n_p, size_t n); // keeps contents; 0 if no memory
+ *     void  deallocate (void* p, size_t n);
+ *   };
+ *
+ * where "n_p" and the "n" of deallocate () are the sizes "p" was last
+ * (re)allocated with. An allocator may keep state (an arena, a NUMA node,
+ * a shared memory segment, a byte counter); each trie owns a copy, which
+ * allocator () returns. Sections mapped from a file by open_with_mmap ()
+ * or open_persistent () do not come from the allocator.
+ *
+ * With USE_HUGE_PAGES = 1, the default huge_page_allocator keeps sections
+ * of 2 MB or more in anonymous mappings aligned to 2 MB and advised
+ * MADV_HUGEPAGE, so that random walks over _array take one TLB entry per
+ * 2 MB instead of one per 4 KB. realloc () would move such a mapping to
+ * an address that is not 2 MB aligned, which makes the kernel split every
+ * huge page it moves; they grow in place or are moved by mremap () onto
+ * an aligned range instead, so huge pages stay intact and nothing is
+ * copied.
+ *
+ * With USE_EXACT_FIT = 1, the array grows by MAX_ALLOC_SIZE nodes at a
+ * time; reserved_allocator commits such growth in address space reserved
+ * beforehand, so that large tries are built without ever moving a node.
+ */
+
+namespace cedar {
+  static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	/**
+	 * ask for huge pages on the 2 MB aligned part of [p, p + len); a hint
+	 * only, which the kernel may ignore (transparent_hugepage=never)
+	 */
+  inline void advise_huge_pages (void* p, const size_t len) {
+#if (USE_HUGE_PAGES == 1) && defined (MADV_HUGEPAGE)
+    const uintptr_t b = (reinterpret_cast <uintptr_t> (p) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    const uintptr_t e = (reinterpret_cast <uintptr_t> (p) + len) & ~(HUGE_PAGE_SIZE - 1);
+    if (b < e) madvise (reinterpret_cast <void*> (b), e - b, MADV_HUGEPAGE);
+#else
+    (void) p; (void) len;
+#endif
+  }
+
+	/**
+	 * reserve "len" bytes (a multiple of HUGE_PAGE_SIZE) at a 2 MB boundary
+	 */
+  inline char* huge_pages_reserve (const size_t len, const int prot) {
+    char* const r = static_cast <char*> (mmap (NULL, len + HUGE_PAGE_SIZE, prot,
+                                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (r == MAP_FAILED) return 0;
+    char* const p = reinterpret_cast <char*> ((reinterpret_cast <uintptr_t> (r) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (p != r) munmap (r, static_cast <size_t> (p - r));
+    munmap (p + len, static_cast <size_t> (r + HUGE_PAGE_SIZE - p));
+    return p;
+  }
+
+	/**
+	 * resize the huge page mapping "p" of "len" bytes (p = 0, len = 0 for
+	 * none) to hold "n" bytes; the contents are kept, and added bytes are
+	 * zero. "len" is updated, and 0 is returned if no memory is left
+	 */
+  inline void* huge_pages_grow (void* p, size_t& len, const size_t n) {
+    const size_t len_n = (n + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (len_n <= len) return p;
+    void* q = 0;
+#ifdef MREMAP_FIXED
+    if (p && mremap (p, len, len_n, 0) != MAP_FAILED) { // in place
+      q = p;
+    } else if (p) {
+      if (char* const r = huge_pages_reserve (len_n, PROT_NONE)) {
+        q = mremap (p, len, len_n, MREMAP_MAYMOVE | MREMAP_FIXED, r);
+        if (q == MAP_FAILED) munmap (r, len_n), q = 0;
+      }
+    } else
+#endif
+    {
+      q = huge_pages_reserve (len_n, PROT_READ | PROT_WRITE);
+      if (q && p) std::memcpy (q, p, len), munmap (p, len);
+    }
+    if (! q) return 0;
+#ifdef MADV_HUGEPAGE
+    madvise (q, len_n, MADV_HUGEPAGE);
+#endif
+    len = len_n;
+    return q;
+  }
+
+	/**
+	 * std::malloc () and friends
+	 */
+  struct malloc_allocator {
+    void* allocate   (const size_t n) { return std::malloc (n); }
+    void* reallocate (void* p, const size_t, const size_t n) { return std::realloc (p, n); }
+    void  deallocate (void* p, const size_t) { std::free (p); }
+  };
+
+	/**
+	 * huge pages for blocks of HUGE_PAGE_SIZE or more, std::malloc () for
+	 * the rest
+	 */
+  struct huge_page_allocator {
+    void* allocate (const size_t n) {
+      size_t len = 0;
+      return n >= HUGE_PAGE_SIZE ? huge_pages_grow (0, len, n) : std::malloc (n);
+    }
+    void* reallocate (void* p, const size_t n_p, const size_t n) {
+      void* q = 0;
+      if (n_p < HUGE_PAGE_SIZE) {
+        if (n < HUGE_PAGE_SIZE) return std::realloc (p, n);
+        if ((q = allocate (n))) std::memcpy (q, p, n_p), std::free (p);
+      } else if (n < HUGE_PAGE_SIZE) {
+        if ((q = std::malloc (n))) std::memcpy (q, p, n), munmap (p, _length (n_p));
+      } else if (_length (n) < _length (n_p)) { // shrink in place
+        munmap (static_cast <char*> (p) + _length (n), _length (n_p) - _length (n));
+        q = p;
+      } else {
+        size_t len = _length (n_p);
+        q = huge_pages_grow (p, len, n);
+      }
+      return q;
+    }
+    void deallocate (void* p, const size_t n) {
+      if (n >= HUGE_PAGE_SIZE) munmap (p, _length (n));
+      else std::free (p);
+    }
+  private:
+    static size_t _length (const size_t n) { return (n + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1); }
+  };
+
+	/**
+	 * blocks of HUGE_PAGE_SIZE or more are committed, HUGE_PAGE_SIZE at a
+	 * time, from address space reserved up front, so that they grow in
+	 * place: growth never moves or copies what is there and costs only the
+	 * pages added, and peak memory stays at the size of the trie. The
+	 * default reservation covers 2^31 nodes of 8 bytes, the most an int
+	 * index can address; pass a smaller one to host many tries. A block
+	 * that outgrows its reservation has its pages moved by mremap ()
+	 */
+  class reserved_allocator {
+  public:
+    explicit reserved_allocator (const size_t reserve = size_t (1) << 34) : _reserve (_length (reserve ? reserve : 1)) {}
+    void* allocate (const size_t n) {
+      if (n < HUGE_PAGE_SIZE) return std::malloc (n);
+      char* const p = huge_pages_reserve (_span (n), PROT_NONE);
+      if (! p) return 0;
+      advise_huge_pages (p, _span (n));
+      if (_commit (p, 0, n)) return p;
+      munmap (p, _span (n));
+      return 0;
+    }
+    void* reallocate (void* p, const size_t n_p, const size_t n) {
+      void* q = 0;
+      if (n_p < HUGE_PAGE_SIZE) {
+        if (n < HUGE_PAGE_SIZE) return std::realloc (p, n);
+        if ((q = allocate (n))) std::memcpy (q, p, n_p), std::free (p);
+      } else if (n < HUGE_PAGE_SIZE) {
+        if ((q = std::malloc (n))) std::memcpy (q, p, n), munmap (p, _span (n_p));
+      } else if (_span (n) == _span (n_p)) { // in place
+        if (_commit (p, n_p, n)) q = p;
+      } else if (char* const r = huge_pages_reserve (_span (n), PROT_NONE)) {
+        const size_t m = _length (n < n_p ? n : n_p); // committed bytes to keep
+        advise_huge_pages (r, _span (n));
+#ifdef MREMAP_FIXED
+        if (mremap (p, m, m, MREMAP_MAYMOVE | MREMAP_FIXED, r) != MAP_FAILED)
+          q = r;
+        else
+#endif
+        if (mprotect (r, m, PROT_READ | PROT_WRITE) == 0)
+          std::memcpy (r, p, m), q = r;
+        if (q && _commit (r, m, n)) munmap (p, _span (n_p));
+        else munmap (r, _span (n)), q = 0;
+      }
+      return q;
+    }
+    void deallocate (void* p, const size_t n) {
+      if (n >= HUGE_PAGE_SIZE) munmap (p, _span (n));
+      else std::free (p);
+    }
+    size_t reserve () const { return _reserve; }
+  private:
+    static size_t _length (const size_t n) { return (n + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1); }
+    size_t _span (const size_t n) const { return (_length (n) + _reserve - 1) / _reserve * _reserve; }
+    // commit the pages of a block growing from "n_p" bytes to "n" bytes, or
+    // return the pages of one shrinking
+    static bool _commit (void* p, const size_t n_p, const size_t n) {
+      char* const b = static_cast <char*> (p) + _length (n_p < n ? n_p : n);
+      const size_t len = _length (n_p < n ? n : n_p) - _length (n_p < n ? n_p : n);
+      if (! len) return true;
+      if (n_p < n) return mprotect (b, len, PROT_READ | PROT_WRITE) == 0;
+      madvise (b, len, MADV_DONTNEED);
+      return mprotect (b, len, PROT_NONE) == 0;
+    }
+    size_t _reserve;
+  };
+
+	/**
+	 * count bytes allocated through "base", e.g., to account memory of each
+	 * of many tries hosted by a process
+	 */
+  template <typename base = malloc_allocator>
+  class counting_allocator : public base {
+  public:
+    counting_allocator (const base& b = base ()) : base (b), _allocated (0), _peak (0) {}
+    size_t allocated () const { return _allocated; } // in use now
+    size_t peak      () const { return _peak; }      // max. of allocated ()
+    void* allocate (const size_t n) {
+      void* const p = base::allocate (n);
+      if (p) _add (n, 0);
+      return p;
+    }
+    void* reallocate (void* p, const size_t n_p, const size_t n) {
+      void* const q = base::reallocate (p, n_p, n);
+      if (q) _add (n, n_p);
+      return q;
+    }
+    void deallocate (void* p, const size_t n) {
+      base::deallocate (p, n);
+      _allocated -= n;
+    }
+  private:
+    void _add (const size_t n, const size_t n_p) {
+      _allocated += n - n_p;
+      if (_peak < _allocated) _peak = _allocated;
+    }
+    size_t _allocated;
+    size_t _peak;
+  };
+
+#if (USE_HUGE_PAGES == 1)
+  typedef huge_page_allocator default_allocator;
+#else
+  typedef malloc_allocator    default_allocator;
+#endif
+}
+#endif
@@ -0,0 +1,147 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  sharded_da: independently locked tries for multi-threaded ingest
+#ifndef CEDAR_SHARDED_H
+#define CEDAR_SHARDED_H
+
+#include <mutex>
+#include <cstring>
+
+#include <cedar.h>
+
+/**
+ * Keys are spread over NUM_SHARDS independent tries by their first byte;
+ * each trie has its own lock, its own _array and its own block lists, so
+ * threads that insert keys with different first bytes never contend.
+ *
+ * All prefixes of a key share its first byte, hence commonPrefixSearch ()
+ * and commonPrefixPredict () still consult a single shard, and visiting
+ * the first bytes in order enumerates all keys in order.
+ */
+
+namespace cedar {
+  template <typename value_type,
+            const size_t  NUM_SHARDS = 16,
+            const int     NO_VALUE  = NaN <value_type>::N1,
+            const int     NO_PATH   = NaN <value_type>::N2,
+            const bool    ORDERED   = true,
+            const int     MAX_TRIAL = 1,
+            const size_t  NUM_TRACKING_NODES = 0>
+  class sharded_da {
+  public:
+    typedef da <value_type, NO_VALUE, NO_PATH, ORDERED, MAX_TRIAL, NUM_TRACKING_NODES> trie_type;
+    typedef typename trie_type::result_type        result_type;
+    typedef typename trie_type::result_pair_type   result_pair_type;
+    typedef typename trie_type::result_triple_type result_triple_type;
+    typedef decltype (result_triple_type ().id)    npos_type;
+    enum error_code { CEDAR_NO_VALUE = NO_VALUE, CEDAR_NO_PATH = NO_PATH };
+
+    sharded_da () {}
+    size_t num_shards () const { return NUM_SHARDS; }
+    size_t num_keys () const {
+      size_t n = 0;
+      for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        std::lock_guard <std::mutex> lock (_shard[i].lock);
+        n += _shard[i].trie.num_keys ();
+      }
+      return n;
+    }
+    size_t total_size () const {
+      size_t n = 0;
+      for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        std::lock_guard <std::mutex> lock (_shard[i].lock);
+        n += _shard[i].trie.total_size ();
+      }
+      return n;
+    }
+
+	/**
+	 * insert "key" or add "val" to its value; returns the new value
+	 */
+    value_type update (const char* key) { return update (key, std::strlen (key)); }
+    value_type update (const char* key, size_t len, value_type val = value_type (0)) {
+      shard& s = _shard_of (key, len);
+      std::lock_guard <std::mutex> lock (s.lock);
+      return s.trie.update (key, len, val);
+    }
+    int erase (const char* key) { return erase (key, std::strlen (key)); }
+    int erase (const char* key, size_t len) {
+      if (! len) return -1;
+      shard& s = _shard_of (key, len);
+      std::lock_guard <std::mutex> lock (s.lock);
+      return s.trie.erase (key, len);
+    }
+
+	/**
+	 * does given key exist
+	 */
+    template <typename T>
+    T exactMatchSearch (const char* key) const
+    { return exactMatchSearch <T> (key, std::strlen (key)); }
+    template <typename T>
+    T exactMatchSearch (const char* key, size_t len) const {
+      shard& s = _shard_of (key, len);
+      std::lock_guard <std::mutex> lock (s.lock);
+      return s.trie.template exactMatchSearch <T> (key, len);
+    }
+	/**
+	 * return all strings in trie which are prefix of "key"
+	 */
+    template <typename T>
+    size_t commonPrefixSearch (const char* key, T* result, size_t result_len) const
+    { return commonPrefixSearch (key, result, result_len, std::strlen (key)); }
+    template <typename T>
+    size_t commonPrefixSearch (const char* key, T* result, size_t result_len, size_t len) const {
+      if (! len) return 0;
+      shard& s = _shard_of (key, len);
+      std::lock_guard <std::mutex> lock (s.lock);
+      return s.trie.commonPrefixSearch (key, result, result_len, len);
+    }
+	/**
+	 * return all strings in trie which are completions of non-empty "key";
+	 * use for_each () to enumerate all keys
+	 */
+    template <typename T>
+    size_t commonPrefixPredict (const char* key, T* result, size_t result_len)
+    { return commonPrefixPredict (key, result, result_len, std::strlen (key)); }
+    template <typename T>
+    size_t commonPrefixPredict (const char* key, T* result, size_t result_len, size_t len) {
+      if (! len) return 0;
+      shard& s = _shard_of (key, len);
+      std::lock_guard <std::mutex> lock (s.lock);
+      return s.trie.commonPrefixPredict (key, result, result_len, len);
+    }
+
+	/**
+	 * call f (key, len, value) for every key in lexicographic order
+	 * (ORDERED = true); the shard being visited is locked meanwhile
+	 */
+    template <typename F>
+    void for_each (F f) {
+      for (int c = 1; c < 256; ++c) {
+        const char label = static_cast <char> (c);
+        shard& s = _shard_of (&label, 1);
+        std::lock_guard <std::mutex> lock (s.lock);
+        for (typename trie_type::const_iterator it = s.trie.predict_begin (&label, 1);
+             it != s.trie.end (); ++it) {
+          f (it->key, it->length, it->value);
+        }
+      }
+    }
+
+  private:
+    sharded_da (const sharded_da&) = delete;
+    sharded_da& operator= (const sharded_da&) = delete;
+
+    struct alignas (64) shard { // keep locks of shards on own cache lines
+      mutable std::mutex lock;
+      mutable trie_type  trie;
+    };
+    shard _shard[NUM_SHARDS];
+
+    shard& _shard_of (const char* key, const size_t len) const {
+      const uchar c = len ? static_cast <uchar> (key[0]) : 0;
+      return const_cast <shard&> (_shard[c % NUM_SHARDS]);
+    }
+  };
+}
+#endif
@@ -0,0 +1,84 @@
+// cedar -- C++ implementation of Efficiently-updatable Double ARray trie
+//  vectorized byte kernels for the tails of cedarpp.h
+#ifndef CEDAR_SIMD_H
+#define CEDAR_SIMD_H
+
+#include <cstddef>
+
+#if (defined (__x86_64__) || defined (__i386__)) && defined (__SSE2__) && defined (__GNUC__)
+#define CEDAR_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define CEDAR_SIMD_X86 0
+#endif
+
+/**
+ * cedarpp.h keeps the suffix of a key that no other key shares in _tail,
+ * NUL terminated, and compares the rest of a key with it byte by byte. Long
+ * suffixes (URLs, paths) make this loop the bulk of a lookup; the kernels
+ * here compare 16 bytes at a time with SSE2, which every x86-64 processor
+ * has, and 32 bytes at a time with AVX2 when the processor has it, which is
+ * checked once at run time. Other targets, and runs shorter than a vector,
+ * take the plain loop.
+ *
+ * A kernel reads no byte outside [a, a + n) and [b, b + n): callers bound
+ * "n" by the end of _tail, so that no load crosses into an unmapped page.
+ * The ends of tails are found by std::strlen (), which libc already
+ * dispatches to vector code, and which a bounded scan here did not beat.
+ */
+
+namespace cedar {
+	/**
+	 * @return  the first i < n with a[i] != b[i], or n
+	 */
+  inline size_t mismatch_scalar (const char* a, const char* b, const size_t n) {
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) ++i;
+    return i;
+  }
+
+#if CEDAR_SIMD_X86
+  inline size_t mismatch_sse2 (const char* a, const char* b, const size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      const __m128i x = _mm_loadu_si128 (reinterpret_cast <const __m128i*> (a + i));
+      const __m128i y = _mm_loadu_si128 (reinterpret_cast <const __m128i*> (b + i));
+      const unsigned m = static_cast <unsigned> (_mm_movemask_epi8 (_mm_cmpeq_epi8 (x, y))) ^ 0xFFFFu;
+      if (m) return i + static_cast <size_t> (__builtin_ctz (m));
+    }
+    return i + mismatch_scalar (a + i, b + i, n - i);
+  }
+  __attribute__ ((target ("avx2")))
+  inline size_t mismatch_avx2 (const char* a, const char* b, const size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      const __m256i x = _mm256_loadu_si256 (reinterpret_cast <const __m256i*> (a + i));
+      const __m256i y = _mm256_loadu_si256 (reinterpret_cast <const __m256i*> (b + i));
+      const unsigned m = ~static_cast <unsigned> (_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (x, y)));
+      if (m) return i + static_cast <size_t> (__builtin_ctz (m));
+    }
+    return i + mismatch_sse2 (a + i, b + i, n - i);
+  }
+  inline bool has_avx2 () {
+    static const bool avx2 = (__builtin_cpu_init (), __builtin_cpu_supports ("avx2"));
+    return avx2;
+  }
+  // kept out of line, so that callers inline only the short case
+  __attribute__ ((noinline))
+  inline size_t mismatch_vector (const char* a, const char* b, const size_t n) {
+    if (n >= 32 && has_avx2 ()) return mismatch_avx2 (a, b, n);
+    return mismatch_sse2 (a, b, n);
+  }
+#endif
+
+	/**
+	 * the first position where "a" and "b" differ within "n" bytes, or n
+	 */
+  inline size_t tail_mismatch (const char* a, const char* b, const size_t n) {
+#if CEDAR_SIMD_X86
+    if (n >= 16) return mismatch_vector (a, b, n);
+#endif
+    return mismatch_scalar (a, b, n);
+  }
+}
+#endif
@@ -9,11 +9,30 @@
 #include <cstring>
 #include <climits>
 #include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <cedar_config.h>
+#include <cedar_format.h>
+#include <cedar_memory.h>
+#include <cedar_frozen.h>
+#include <cedar_fuzzy.h>
+#include <cedar_simd.h>
 
 #define STATIC_ASSERT(e, msg) typedef char msg[(e) ? 1 : -1]
 
+#if defined (__GNUC__)
+#define CEDAR_PREFETCH(p) __builtin_prefetch (p)
+#else
+#define CEDAR_PREFETCH(p)
+#endif
+
 namespace cedar {
   // typedefs
 #if LONG_BIT == 64
@@ -27,13 +46,19 @@ namespace cedar {
   template <typename T> struct NaN { enum { N1 = -1, N2 = -2 }; };
   template <> struct NaN <float> { enum { N1 = 0x7f800001, N2 = 0x7f800002 }; };
   static const int MAX_ALLOC_SIZE = 1 << 16; // must be divisible by 256
+  static const size_t BATCH_SIZE = 16; // # lookups interleaved by batch search
+  static const int NUM_RECENT_BLOCKS = 16; // # blocks build_sorted () fills
+  static const int MIN_RESTORE_BLOCKS = 1 << 12; // # blocks per thread of restore ()
+  template <typename trie_type> class da_const_iterator;
+  template <typename trie_type> class da_matcher;
   // dynamic double array
   template <typename value_type,
             const int     NO_VALUE  = NaN <value_type>::N1,
             const int     NO_PATH   = NaN <value_type>::N2,
             const bool    ORDERED   = true,
             const int     MAX_TRIAL = 1,
-            const size_t  NUM_TRACKING_NODES = 0>
+            const size_t  NUM_TRACKING_NODES = 0,
+            typename      allocator_type = default_allocator> // see cedar_memory.h
   class da {
   public:
     enum error_code { CEDAR_NO_VALUE = NO_VALUE, CEDAR_NO_PATH = NO_PATH };
@@ -47,6 +72,41 @@ namespace cedar {
       size_t      length;  // suffix length
       npos_t      id;      // node id of value
     };
+    struct key_value_type { // for const_iterator
+      const char* key;     // null-terminated
+      size_t      length;
+      value_type  value;
+      npos_t      id;      // node id of value
+    };
+    // where predictPage () stopped: the last completion returned, the node
+    // of the prefix, and a hash of the labels from the prefix to the
+    // completion; of fixed-width fields, to be handed out as bytes and
+    // taken back by the trie object that issued it
+    struct cursor {
+      uint64_t from;  // node and tail offset of the last completion
+      uint64_t len;   // its length
+      uint64_t root;  // node of the prefix
+      uint64_t path;  // 0 before the first page, ~0 after the last
+      cursor () : from (0), len (0), root (0), path (0) {}
+      bool end () const { return path == ~uint64_t (0); }
+    };
+    typedef da_const_iterator <da> const_iterator;
+    typedef const_iterator         iterator; // keys cannot be modified in place
+    typedef da_matcher <da>        matcher;  // longest match over chunked input
+    typedef frozen_da <value_type, NO_VALUE, NO_PATH> frozen_type; // for freeze ()
+    struct stats_type { // for stats ()
+      size_t num_keys;
+      size_t num_nodes;         // nodes in use but the root; nonzero_size ()
+      size_t num_free_nodes;    // empty nodes in the blocks of the array
+      size_t size;              // nodes in the array
+      size_t capacity;
+      size_t tail_length;       // bytes of tail; length ()
+      size_t tail_used;         // bytes of tails in use; nonzero_length ()
+      size_t num_blocks;        // blocks of 256 nodes
+      size_t num_blocks_open;   // on the Open list
+      size_t num_blocks_closed; // on the Closed list
+      size_t num_blocks_full;   // the rest but the first block of the root
+    };
     struct node {
       union { int base; value_type value; }; // negative means prev empty index
       int  check;                            // negative means next empty index
@@ -67,40 +127,43 @@ namespace cedar {
       int   ehead;  // first empty item
       block () : prev (0), next (0), num (256), reject (257), trial (0), ehead (0) {}
     };
-    da () : tracking_node (), _array (0), _tail (0), _tail0 (0), _ninfo (0), _block (0), _bheadF (0), _bheadC (0), _bheadO (0), _capacity (0), _size (0), _quota (0), _quota0 (0), _no_delete (false), _reject () {
+    explicit da (const allocator_type& alloc = allocator_type ()) : tracking_node (), _array (0), _tail (0), _tail0 (0), _ninfo (0), _block (0), _bheadF (0), _bheadC (0), _bheadO (0), _capacity (0), _size (0), _quota (0), _quota0 (0), _no_delete (false), _mmap_len (), _alloc_len (), _alloc (alloc), _num_keys (0), _nonzero_size (0), _nonzero_length (0), _bnumO (0), _bnumC (0), _counted (false), _reject () {
       STATIC_ASSERT(sizeof (value_type) <= sizeof (int),
                     value_type_is_not_supported___maintain_a_value_array_by_yourself_and_store_its_index_to_trie
                     );
       _initialize ();
     }
     ~da () { clear (false); }
+    allocator_type&       allocator ()       { return _alloc; }
+    const allocator_type& allocator () const { return _alloc; }
     size_t capacity   () const { return static_cast <size_t> (_capacity); }
     size_t size       () const { return static_cast <size_t> (_size); }
     size_t length     () const { return static_cast <size_t> (*_length); }
     size_t total_size () const { return sizeof (node) * _size; }
     size_t unit_size  () const { return sizeof (node); }
-    size_t nonzero_size () const {
-      size_t i = 0;
-      for (int to = 0; to < _size; ++to)
-        if (_array[to].check >= 0) ++i;
-      return i;
-    }
-    size_t nonzero_length () const {
-      size_t i (0), j (0);
-      for (int to = 0; to < _size; ++to) {
-        const node& n = _array[to];
-        if (n.check >= 0 && _array[n.check].base != to && n.base < 0)
-          { ++j; for (const char* p = &_tail[-n.base]; *p; ++p) ++i; }
-      }
-      return i + j * (1 + sizeof (value_type));
-    }
-    size_t num_keys () const {
-      size_t i = 0;
-      for (int to = 0; to < _size; ++to) {
-        const node& n = _array[to];
-        if (n.check >= 0 && (_array[n.check].base == to || n.base < 0)) ++i;
-      }
-      return i;
+    // counters kept by update () and erase (); O(1)
+    size_t nonzero_size   () const { if (! _counted) _count (); return _nonzero_size; }
+    size_t nonzero_length () const { if (! _counted) _count (); return _nonzero_length; }
+    size_t num_keys       () const { if (! _counted) _count (); return _num_keys; }
+    // counters and the block lists; while _block is not loaded (see open ()),
+    // blocks are counted from _array as restore () would list them, in
+    // O(size ())
+    stats_type stats () const {
+      if (! _counted) _count ();
+      stats_type st;
+      st.num_keys          = _num_keys;
+      st.num_nodes         = _nonzero_size;
+      st.num_free_nodes    = static_cast <size_t> (_size) - _nonzero_size - 1;
+      st.size              = static_cast <size_t> (_size);
+      st.capacity          = static_cast <size_t> (_capacity);
+      st.tail_length       = static_cast <size_t> (*_length);
+      st.tail_used         = _nonzero_length;
+      st.num_blocks        = static_cast <size_t> (_size >> 8);
+      st.num_blocks_open   = static_cast <size_t> (_bnumO);
+      st.num_blocks_closed = static_cast <size_t> (_bnumC);
+      if (! _block) _count_blocks_in_array (st.num_blocks_open, st.num_blocks_closed);
+      st.num_blocks_full   = st.num_blocks ? st.num_blocks - 1 - st.num_blocks_open - st.num_blocks_closed : 0;
+      return st;
     }
     // interfance
     template <typename T>
@@ -116,6 +179,51 @@ namespace cedar {
       _set_result (&result, b.x, len, from);
       return result;
     }
+    // look up num keys in lockstep, prefetching the next node of each key
+    template <typename T>
+    void exactMatchSearch (const char* const* key, T* result, const size_t num, const size_t* len = 0) const {
+      for (size_t i = 0; i < num; i += BATCH_SIZE) {
+        const size_t n = num - i < BATCH_SIZE ? num - i : BATCH_SIZE;
+        const uchar* key_[BATCH_SIZE];
+        size_t len_[BATCH_SIZE], pos[BATCH_SIZE], lane[BATCH_SIZE];
+        npos_t from[BATCH_SIZE], to[BATCH_SIZE];
+        for (size_t j = 0; j < n; ++j) {
+          key_[j] = reinterpret_cast <const uchar*> (key[i + j]);
+          len_[j] = len ? len[i + j] : std::strlen (key[i + j]);
+          from[j] = 0, pos[j] = 0, lane[j] = j;
+        }
+        for (size_t m = n; m; ) {
+          for (size_t k = 0; k < m; ++k) { // issue loads for every lookup
+            const size_t j = lane[k];
+            const int base = _array[from[j]].base;
+            if (base < 0) { // suffix is on _tail; finish it by _find ()
+              to[j] = 0;
+              CEDAR_PREFETCH (&_tail[-base]);
+            } else {
+              to[j] = static_cast <npos_t> (base) ^ (pos[j] < len_[j] ? key_[j][pos[j]] : 0);
+              CEDAR_PREFETCH (&_array[to[j]]);
+            }
+          }
+          for (size_t k = 0; k < m; ) { // and then follow the links
+            const size_t j = lane[k];
+            union { int i; value_type x; } b;
+            if (! to[j]) {
+              b.i = _find (key[i + j], from[j], pos[j], len_[j]);
+              if (b.i == CEDAR_NO_PATH) b.i = CEDAR_NO_VALUE;
+            } else if (_array[to[j]].check != static_cast <int> (from[j])) {
+              b.i = CEDAR_NO_VALUE;
+            } else if (pos[j] == len_[j]) {
+              b.i = _array[to[j]].base;
+            } else {
+              from[j] = to[j], ++pos[j], ++k;
+              continue;
+            }
+            _set_result (&result[i + j], b.x, len_[j], from[j]);
+            lane[k] = lane[--m];
+          }
+        }
+      }
+    }
     template <typename T>
     size_t commonPrefixSearch (const char* key, T* result, size_t result_len) const
     { return commonPrefixSearch (key, result, result_len, std::strlen (key)); }
@@ -132,6 +240,40 @@ namespace cedar {
       }
       return num;
     }
+    // call visit (value, length, id) for each prefix of key, shortest first,
+    // until it returns false; nothing is stored; # prefixes visited
+    template <typename F>
+    size_t commonPrefixSearch (const char* key, F&& visit) const
+    { return commonPrefixSearch (key, std::strlen (key), std::forward <F> (visit)); }
+    template <typename F>
+    size_t commonPrefixSearch (const char* key, size_t len, F&& visit, npos_t from = 0) const {
+      size_t num = 0;
+      for (size_t pos = 0; pos < len; ) {
+        union { int i; value_type x; } b;
+        b.i = _find (key, from, pos, pos + 1);
+        if (b.i == CEDAR_NO_VALUE) continue;
+        if (b.i == CEDAR_NO_PATH)  return num;
+        ++num;
+        if (! visit (b.x, pos, from)) return num;
+      }
+      return num;
+    }
+    // the longest key that is a prefix of "key", in one walk; CEDAR_NO_VALUE
+    // of length 0 if none
+    template <typename T>
+    T longestPrefixSearch (const char* key) const
+    { return longestPrefixSearch <T> (key, std::strlen (key)); }
+    template <typename T>
+    T longestPrefixSearch (const char* key, size_t len, npos_t from = 0) const {
+      union { int i; value_type x; } b;
+      b.i = CEDAR_NO_VALUE;
+      size_t pos (0), length (0);
+      npos_t id = from;
+      _longest (key, from, pos, len, b.i, length, id);
+      T result;
+      _set_result (&result, b.x, length, id);
+      return result;
+    }
     // predict key from double array
     template <typename T>
     size_t commonPrefixPredict (const char* key, T* result, size_t result_len)
@@ -149,6 +291,69 @@ namespace cedar {
       }
       return num;
     }
+    // call visit (value, length, id) for each completion of key, in the
+    // order of begin () and next (), until it returns false
+    template <typename F>
+    size_t commonPrefixPredict (const char* key, F&& visit)
+    { return commonPrefixPredict (key, std::strlen (key), std::forward <F> (visit)); }
+    template <typename F>
+    size_t commonPrefixPredict (const char* key, size_t len, F&& visit, npos_t from = 0) {
+      size_t num (0), pos (0), p (0);
+      if (_find (key, from, pos, len) == CEDAR_NO_PATH) return 0;
+      union { int i; value_type x; } b;
+      const npos_t root = from;
+      for (b.i = begin (from, p); b.i != CEDAR_NO_PATH; b.i = next (from, p, root)) {
+        ++num;
+        if (! visit (b.x, p, from)) break;
+      }
+      return num;
+    }
+    // store up to limit completions of key from where cur stopped, in the
+    // order of commonPrefixPredict (), in O(limit); a cursor holds while
+    // its node and tail still spell the same completion under the same
+    // prefix node, so erasing it, or moving its node or splitting its tail,
+    // invalidates it; returns # stored, 0 after the last one, or -1 if cur
+    // is invalidated or of another key
+    template <typename T>
+    int predictPage (const char* key, cursor& cur, T* result, size_t limit)
+    { return predictPage (key, std::strlen (key), cur, result, limit); }
+    template <typename T>
+    int predictPage (const char* key, size_t len, cursor& cur, T* result, size_t limit) {
+      if (cur.end () || ! limit) return 0;
+      npos_t from (0);
+      size_t pos (0), p (0);
+      const bool found = _find (key, from, pos, len) != CEDAR_NO_PATH;
+      if (cur.path && (! found || cur.root != from ||
+                       cur.path != _path_hash (cur.from, cur.len, from))) return -1;
+      if (! found) { cur.path = ~uint64_t (0); return 0; }
+      union { int i; value_type x; } b;
+      const npos_t root = from;
+      if (cur.path) b.i = next (from = cur.from, p = static_cast <size_t> (cur.len), root);
+      else           b.i = begin (from, p);
+      size_t num = 0;
+      for (; b.i != CEDAR_NO_PATH; b.i = next (from, p, root)) {
+        _set_result (&result[num], b.x, p, from);
+        if (++num == limit) break;
+      }
+      cur.from = from, cur.len = p, cur.root = root;
+      cur.path = b.i == CEDAR_NO_PATH ? ~uint64_t (0) : _path_hash (from, p, root);
+      return static_cast <int> (num);
+    }
+    // call visit (key, length, value, distance) for each key within
+    // max_edits edits of key, in the order of begin () and next (), until
+    // it returns false; subtrees and tails are left as soon as no cell of
+    // their row of the edit distance table is within (cedar_fuzzy.h)
+    template <typename F>
+    size_t fuzzySearch (const char* key, const size_t max_edits, F&& visit)
+    { return fuzzySearch (key, std::strlen (key), max_edits, std::forward <F> (visit)); }
+    template <typename F>
+    size_t fuzzySearch (const char* key, size_t len, const size_t max_edits, F&& visit) {
+      if (! _ninfo) _restore_ninfo ();
+      edit_rows rows (key, len, max_edits);
+      size_t num = 0;
+      _fuzzy (rows, 0, 0, visit, num);
+      return num;
+    }
     void suffix (char* key, size_t len, npos_t to) const {
       key[len] = '\0';
       if (const int offset = static_cast <int> (to >> 32)) {
@@ -181,15 +386,16 @@ namespace cedar {
     value_type& update (const char* key, npos_t& from, size_t& pos, size_t len, value_type val, T& cf) {
       if (! len && ! from)
         _err (__FILE__, __LINE__, "failed to insert zero-length key\n");
-#if (USE_FAST_LOAD == 0)
-      if (! _ninfo || ! _block) restore ();
-#endif
+      if (! _ninfo || ! _block) restore (); // opened without them
       npos_t offset = from >> 32;
       if (! offset) { // node on trie
         for (const uchar* const key_ = reinterpret_cast <const uchar*> (key);
              _array[from].base >= 0; ++pos) {
-          if (pos == len)
-            { const int to = _follow (from, 0, cf); return _array[to].value += val; }
+          if (pos == len) {
+            if (_array[_array[from].base ^ 0].check != static_cast <int> (from)) ++_num_keys; // new key
+            const int to = _follow (from, 0, cf);
+            return _array[to].value += val;
+          }
           from = static_cast <size_t> (_follow (from, key_[pos], cf));
         }
         offset = static_cast <npos_t> (-_array[from].base);
@@ -197,7 +403,7 @@ namespace cedar {
       if (offset >= sizeof (int)) { // go to _tail
         const size_t pos_orig = pos;
         char* const tail = &_tail[offset] - pos;
-        while (pos < len && key[pos] == tail[pos]) ++pos;
+        pos += _tail_mismatch (key + pos, offset, len - pos);
         //
         if (pos == len && tail[pos] == '\0') { // found exact key
           if (const npos_t moved = pos - pos_orig) { // search end on tail
@@ -206,6 +412,9 @@ namespace cedar {
           }
           return *reinterpret_cast <value_type*> (&tail[len + 1]) += val;
         }
+        // the tail of the leaf loses the common prefix and a label, or all
+        const npos_t start = static_cast <npos_t> (-_array[from & TAIL_OFFSET_MASK].base);
+        _nonzero_length -= (offset - start) + (pos - pos_orig) + (tail[pos] ? 1 : 1 + sizeof (value_type));
         // otherwise, insert the common prefix in tail if any
         if (from >> 32) {
           from &= TAIL_OFFSET_MASK; // reset to update tail offset
@@ -238,13 +447,13 @@ namespace cedar {
 #else
             _quota0 += _quota0;
 #endif
-            _realloc_array (_tail0, _quota0, *_length0);
+            _grow (_tail0, SECTION_TAIL0, _quota0, *_length0);
           }
           _tail0[*_length0] = static_cast <int> (i);
         }
         if (pos == len || tail[pos] == '\0') {
           const int to = _follow (from, 0, cf);
-          if (pos == len) return _array[to].value += val; // set value on tail
+          if (pos == len) { ++_num_keys; return _array[to].value += val; } // set value on tail
           _array[to].value += *reinterpret_cast <value_type*> (&tail[pos + 1]);
         }
         from = static_cast <size_t> (_follow (from, static_cast <uchar> (key[pos]), cf));
@@ -256,17 +465,10 @@ namespace cedar {
         _tail[offset0] = '\0';
         _array[from].base = -offset0;
         --*_length0;
+        ++_num_keys, _nonzero_length += 1 + sizeof (value_type);
         return *reinterpret_cast <value_type*> (&_tail[offset0 + 1]) = val;
       }
-      if (_quota < *_length + needed) {
-#if (USE_EXACT_FIT == 1)
-        _quota += needed > *_length || needed > MAX_ALLOC_SIZE ? needed :
-                  (*_length >= MAX_ALLOC_SIZE ? MAX_ALLOC_SIZE : *_length);
-#else
-        _quota += _quota >= needed ? _quota : needed;
-#endif
-        _realloc_array (_tail, _quota, *_length);
-      }
+      _reserve_tail (needed);
       _array[from].base = -*_length;
       const size_t pos_orig = pos;
       char* const tail = &_tail[*_length] - pos;
@@ -275,6 +477,7 @@ namespace cedar {
         from |= (static_cast <npos_t> (*_length) + (len - pos_orig)) << 32;
       }
       *_length += needed;
+      ++_num_keys, _nonzero_length += static_cast <size_t> (needed);
       return *reinterpret_cast <value_type*> (&tail[len + 1]) += val;
     }
     // easy-going erase () without compression
@@ -284,7 +487,10 @@ namespace cedar {
       const int i = _find (key, from, pos, len);
       if (i == CEDAR_NO_PATH || i == CEDAR_NO_VALUE) return -1;
       if (from >> 32) from &= TAIL_OFFSET_MASK; // leave tail as is
+      if (! _ninfo || ! _block) restore (); // opened without them
       bool flag = _array[from].base < 0; // have sibling
+      if (flag) _nonzero_length -= std::strlen (&_tail[-_array[from].base]) + 1 + sizeof (value_type);
+      --_num_keys;
       int e = flag ? static_cast <int> (from) : _array[from].base ^ 0;
       from  = _array[e].check;
       do {
@@ -302,6 +508,220 @@ namespace cedar {
         update (key[i], len ? len[i] : std::strlen (key[i]), val ? val[i] : value_type (i));
       return 0;
     }
+    // build at once from keys sorted in byte order; every node is placed once
+    // with all its labels known, so nothing is relocated by _resolve ()
+    int build_sorted (size_t num, const char** key, const size_t* len = 0, const value_type* val = 0) {
+      if (! _ninfo || ! _block) restore ();
+      if (_ninfo[0].child || _ninfo[0].sibling) return build (num, key, len, val); // not empty
+      std::vector <size_t> len_;
+      if (! len) {
+        len_.resize (num);
+        for (size_t i = 0; i < num; ++i) len_[i] = std::strlen (key[i]);
+        len = len_.data ();
+      }
+      for (size_t i = 0; i < num; ++i) {
+        if (! len[i])
+          _err (__FILE__, __LINE__, "failed to insert zero-length key\n");
+        if (i) {
+          const size_t n = len[i - 1] < len[i] ? len[i - 1] : len[i];
+          const int r = std::memcmp (key[i - 1], key[i], n);
+          if (r > 0 || (r == 0 && len[i - 1] >= len[i])) return -1; // unsorted
+        }
+      }
+      // keys [begin, end) share the first "depth" bytes, which lead to "from"
+      struct range { size_t from, depth, begin, end; };
+      std::vector <range> todo;
+      if (num) todo.push_back (range {0, 0, 0, num});
+      uchar  child[256] = {};
+      size_t end[256]; // keys [.., end[i]) go to child[i]
+      while (! todo.empty ()) {
+        const range r = todo.back ();
+        todo.pop_back ();
+        if (r.from && r.end - r.begin == 1) { // store the rest of key on tail
+          const size_t i = r.begin, len_tail = len[i] - r.depth;
+          const int needed = static_cast <int> (len_tail + 1 + sizeof (value_type));
+          _reserve_tail (needed);
+          char* const tail = &_tail[*_length];
+          std::memcpy (tail, key[i] + r.depth, len_tail);
+          tail[len_tail] = '\0';
+          *reinterpret_cast <value_type*> (&tail[len_tail + 1]) = val ? val[i] : value_type (i);
+          _array[r.from].base = -*_length;
+          *_length += needed;
+          _nonzero_length += static_cast <size_t> (needed);
+          continue;
+        }
+        size_t n = 0; // # distinct labels
+        for (size_t i = r.begin; i < r.end; ++i) {
+          const uchar c = r.depth < len[i] ? static_cast <uchar> (key[i][r.depth]) : 0;
+          if (! n || child[n - 1] != c) child[n++] = c;
+          end[n - 1] = i + 1;
+        }
+        const uchar* const last = child + n - 1;
+        // the empty root keeps the special block
+        const int base = ! r.from ? 0 : _find_place_recent (child, last) ^ *child;
+        _array[r.from].base = base;
+        (r.from ? _ninfo[r.from].child : _ninfo[0].sibling) = *child; // root: 0 ^ 0
+        for (const uchar* p = child; p <= last; ++p) {
+          const int to = _pop_enode (base, *p, static_cast <int> (r.from));
+          const size_t begin = p == child ? r.begin : end[p - child - 1];
+          _ninfo[to].sibling = p == last ? 0 : *(p + 1);
+          if (*p)
+            todo.push_back (range {static_cast <size_t> (to), r.depth + 1, begin, end[p - child]});
+          else
+            _array[to].value = val ? val[begin] : value_type (begin);
+        }
+      }
+      _num_keys += num;
+      return 0;
+    }
+    // rebuild the trie from its live nodes into a dense layout; nodes are
+    // placed as build_sorted () places them and tails are packed as
+    // shrink_tail () packs them. node ids change; "cf" is called with the
+    // old and the new id of every node. returns bytes given back
+    size_t compact () { empty_callback cf; return compact (cf); }
+    template <typename T>
+    size_t compact (T& cf) {
+      if (! _ninfo || ! _block) restore ();
+      const size_t size_p = _footprint ();
+      // take the sections away, and start over from the first block
+      void* const section[NUM_SECTIONS + 1] = {_array, _ninfo, _block, _tail, _tail0};
+      size_t mmap_len[NUM_SECTIONS + 1], alloc_len[NUM_SECTIONS + 1];
+      for (int i = 0; i <= NUM_SECTIONS; ++i)
+        mmap_len[i] = _mmap_len[i], alloc_len[i] = _alloc_len[i], _mmap_len[i] = _alloc_len[i] = 0;
+      const node*  const array  = _array;
+      const ninfo* const ninfo_ = _ninfo;
+      const char*  const tail   = _tail;
+      const bool no_delete = _no_delete;
+      npos_t tracked[NUM_TRACKING_NODES + 1]; // by old ids; new ones may collide
+      std::copy (tracking_node, tracking_node + NUM_TRACKING_NODES + 1, tracked);
+      _array = 0, _ninfo = 0, _block = 0, _tail = 0, _tail0 = 0, _no_delete = false;
+      _bheadF = _bheadC = _bheadO = 0;
+      _initialize ();
+      std::copy (tracked, tracked + NUM_TRACKING_NODES + 1, tracking_node);
+      struct item { int from_p, from; }; // a node (old id) and its copy (new id)
+      std::vector <item> todo;
+      if (ninfo_[0].sibling) todo.push_back (item {0, 0}); // root: 0 ^ 0
+      uchar child[256];
+      while (! todo.empty ()) {
+        const item r = todo.back ();
+        todo.pop_back ();
+        const int base_p = array[r.from_p].base;
+        size_t n = 0;
+        uchar c = r.from_p ? ninfo_[r.from_p].child : ninfo_[0].sibling;
+        do child[n++] = c; while ((c = ninfo_[base_p ^ c].sibling));
+        const uchar* const last = child + n - 1;
+        // the root keeps the special block
+        const int base = ! r.from ? 0 : _find_place_recent (child, last) ^ *child;
+        _array[r.from].base = base;
+        (r.from ? _ninfo[r.from].child : _ninfo[0].sibling) = *child;
+        for (const uchar* p = child; p <= last; ++p) {
+          const int to_p = base_p ^ *p;
+          const int to   = _pop_enode (base, *p, r.from);
+          _ninfo[to].sibling = p == last ? 0 : *(p + 1);
+          cf (to_p, to);
+          const node& n_ = array[to_p];
+          npos_t shift = 0; // of the tail
+          if (! *p) // terminal
+            _array[to].value = n_.value, ++_num_keys;
+          else if (n_.base >= 0)
+            todo.push_back (item {to_p, to});
+          else { // copy the tail and the value
+            const char* const tail_ = &tail[-n_.base];
+            const int needed = static_cast <int> (std::strlen (tail_) + 1 + sizeof (value_type));
+            _reserve_tail (needed);
+            std::memcpy (&_tail[*_length], tail_, static_cast <size_t> (needed));
+            shift = static_cast <npos_t> (*_length) - static_cast <npos_t> (-n_.base);
+            _array[to].base = -*_length;
+            *_length += needed;
+            ++_num_keys, _nonzero_length += static_cast <size_t> (needed);
+          }
+          for (size_t j = 0; tracked[j] != 0; ++j)
+            if (static_cast <int> (tracked[j] & TAIL_OFFSET_MASK) == to_p) {
+              const npos_t offset = tracked[j] >> 32;
+              tracking_node[j] = static_cast <npos_t> (to) | (offset ? (offset + shift) << 32 : 0);
+            }
+        }
+      }
+      for (int i = 0; i <= NUM_SECTIONS; ++i)
+        if (mmap_len[i]) munmap (section[i], mmap_len[i]);
+        else if (section[i] && ! (no_delete && (i == SECTION_ARRAY || i == SECTION_TAIL)))
+          _alloc.deallocate (section[i], alloc_len[i]);
+      _shrink_to_fit ();
+      _grow (_tail, SECTION_TAIL, *_length, *_length);
+      _quota = *_length;
+      const size_t size_n = _footprint ();
+      return size_p > size_n ? size_p - size_n : 0;
+    }
+    // migrate the nodes in up to "max_blocks" blocks at the end of the array
+    // into empty nodes of the blocks before them, and cut those blocks off,
+    // so that a long-running process reclaims what erase () left a few
+    // blocks at a time. node ids change as in compact (); memory goes back
+    // to the allocator unless the sections are mapped. returns # blocks cut
+    // off; 0 if no more can be
+    size_t compact_step (const size_t max_blocks = 1)
+    { empty_callback cf; return compact_step (max_blocks, cf); }
+    template <typename T>
+    size_t compact_step (const size_t max_blocks, T& cf) {
+      if (! _ninfo || ! _block) restore ();
+      size_t n = 0;
+      for (; n < max_blocks && _size > 256; ++n) {
+        const int bi = (_size >> 8) - 1;
+        if (! _evacuate_block (bi, cf)) break;
+        block& b = _block[bi]; // now all empty; on Open unless given up
+        _pop_block (bi, b.trial == MAX_TRIAL ? _bheadC : _bheadO, bi == b.next);
+        b = block ();
+        _size -= 256;
+      }
+      if (n) _shrink_to_fit ();
+      return n;
+    }
+    // export the trie into an immutable frozen_type for serving (see
+    // cedar_frozen.h); tails are spelled out as chains of units. values
+    // have to lie in [0, 2^31). returns -1 if not, or if the trie is too
+    // large for the offsets of frozen_type. minimize = true merges
+    // equivalent subtrees into a word graph, and keeps values of any kind
+    // in a side array
+    int freeze (frozen_type& t, const bool minimize = false) {
+      if (minimize) return _freeze_minimized (t);
+      if (! _ninfo) _restore_ninfo ();
+      frozen_builder fb;
+      // a node or the rest of its tail, and its unit
+      struct item { int from; const char* tail; uint32_t id; };
+      std::vector <item> todo;
+      if (_ninfo[0].sibling) todo.push_back (item {0, 0, 0}); // root: 0 ^ 0
+      uchar child[256];
+      size_t num = 0;
+      while (! todo.empty ()) {
+        const item r = todo.back ();
+        todo.pop_back ();
+        const int base_p = _array[r.from].base;
+        size_t n = 0;
+        if (r.tail)
+          child[n++] = static_cast <uchar> (*r.tail);
+        else {
+          uchar c = r.from ? _ninfo[r.from].child : _ninfo[0].sibling;
+          do child[n++] = c; while ((c = _ninfo[base_p ^ c].sibling));
+        }
+        uint32_t base = 0;
+        if (! fb.place (r.id, child, n, base)) return -1;
+        for (const uchar* p = child + n - 1; p >= child; --p) { // first child next
+          union { int i; value_type x; } b;
+          if (r.tail && *p)
+            todo.push_back (item {0, r.tail + 1, base ^ *p});
+          else if (*p) {
+            const node& n_ = _array[base_p ^ *p];
+            todo.push_back (item {base_p ^ *p, n_.base >= 0 ? 0 : &_tail[-n_.base], base ^ *p});
+          } else {
+            if (r.tail) std::memcpy (&b.x, r.tail + 1, sizeof (value_type));
+            else b.x = _array[base_p ^ 0].value;
+            if (b.i < 0) return -1;
+            fb.set_value (base, b.i), ++num;
+          }
+        }
+      }
+      t.assign (fb.units (), num);
+      return 0;
+    }
     template <typename T>
     void dump (T* result, const size_t result_len) {
       union { int i; value_type x; } b;
@@ -318,7 +738,7 @@ namespace cedar {
       const size_t length_
         = static_cast <size_t> (*_length)
         - static_cast <size_t> (*_length0) * (1 + sizeof (value_type));
-      t.tail = static_cast <char*> (std::malloc (length_));
+      t.tail = static_cast <char*> (_alloc.allocate (length_));
       if (! t.tail) _err (__FILE__, __LINE__, "memory allocation failed\n");
       *t.length = static_cast <int> (sizeof (int));
       for (int to = 0; to < _size; ++to) {
@@ -332,43 +752,57 @@ namespace cedar {
           *t.length += i + static_cast <int> (sizeof (value_type));
         }
       }
-      std::free (_tail);
-      _tail = t.tail;
-      _realloc_array (_tail,  *_length,  *_length);
+      _release (_tail, SECTION_TAIL);
+      _tail = t.tail, _alloc_len[SECTION_TAIL] = length_;
+      _grow (_tail,  SECTION_TAIL,  *_length, *_length);
       _quota  = *_length;
-      _realloc_array (_tail0, 1);
+      _grow (_tail0, SECTION_TAIL0, 1, 0);
       _quota0 = 1;
     }
     int save (const char* fn, const char* mode, const bool shrink) {
       if (shrink) shrink_tail ();
       return save (fn, mode);
     }
+    // save as one file; see cedar_format.h for its layout
     int save (const char* fn, const char* mode = "wb") const {
       // _test ();
       FILE* fp = std::fopen (fn, mode);
       if (! fp) return -1;
-      std::fwrite (_tail,  sizeof (char), static_cast <size_t> (*_length), fp);
-      std::fwrite (_array, sizeof (node), static_cast <size_t> (_size), fp);
-      std::fclose (fp);
+      file_header h;
+      _file_header (h);
+      h.num_keys    = num_keys ();
+      h.num_nodes   = _nonzero_size;
+      h.tail_length = _nonzero_length;
+      h.section[SECTION_ARRAY].length = sizeof (node) * static_cast <size_t> (_size);
 #if (USE_FAST_LOAD == 1)
-      const char* const info
-        = std::strcat (std::strcpy (new char[std::strlen (fn) + 5], fn), ".sbl");
-      fp = std::fopen (info, mode);
-      delete [] info; // resolve memory leak
-      if (! fp) return -1;
-      std::fwrite (&_bheadF, sizeof (int), 1, fp);
-      std::fwrite (&_bheadC, sizeof (int), 1, fp);
-      std::fwrite (&_bheadO, sizeof (int), 1, fp);
-      std::fwrite (_ninfo, sizeof (ninfo), static_cast <size_t> (_size), fp);
-      std::fwrite (_block, sizeof (block), static_cast <size_t> (_size >> 8), fp);
-      std::fclose (fp);
+      if (_ninfo && _block) {
+        h.section[SECTION_NINFO].length = sizeof (ninfo) * static_cast <size_t> (_size);
+        h.section[SECTION_BLOCK].length = sizeof (block) * static_cast <size_t> (_size >> 8);
+      }
 #endif
-      return 0;
+      h.section[SECTION_TAIL].length = static_cast <size_t> (*_length);
+      const void* const data[NUM_SECTIONS] = {_array, _ninfo, _block, _tail};
+      file_header_seal (h, data);
+      const int ret = file_write (fp, h, data);
+      if (std::fclose (fp) != 0) return -1;
+      return ret;
     }
+    // read a file saved by save (); files without the header of cedar_format.h
+    // are read as the legacy tail + array and ".sbl" pair. load_info = false
+    // skips _ninfo and _block, which only update () and erase () use; the
+    // first update () or erase () then rebuilds them by restore ()
     int open (const char* fn, const char* mode = "rb",
-              const size_t offset = 0, size_t size_ = 0) {
+              const size_t offset = 0, size_t size_ = 0, const bool load_info = true) {
       FILE* fp = std::fopen (fn, mode);
       if (! fp) return -1;
+      file_header h;
+      if (const int legacy = file_read_header (fileno (fp), offset, h)) {
+        if (legacy < 0) { std::fclose (fp); return -1; } // corrupted header
+      } else {
+        const int ret = _open_file (fileno (fp), offset, h, false, load_info);
+        std::fclose (fp);
+        return ret;
+      }
       // get size
       if (! size_) {
         if (std::fseek (fp, 0, SEEK_END) != 0) return -1;
@@ -384,17 +818,9 @@ namespace cedar {
       // set array
       clear (false);
       size_ = (size_ - offset - length_) / sizeof (node);
-      _array = static_cast <node*>  (std::malloc (sizeof (node)  * size_));
-      _tail  = static_cast <char*>  (std::malloc (length_));
-      _tail0 = static_cast <int*>   (std::malloc (sizeof (int)));
-#if (USE_FAST_LOAD == 1)
-      _ninfo = static_cast <ninfo*> (std::malloc (sizeof (ninfo) * size_));
-      _block = static_cast <block*> (std::malloc (sizeof (block) * size_));
-      if (! _array || ! _tail || ! _tail0 || ! _ninfo || ! _block)
-#else
-      if (! _array || ! _tail || ! _tail0)
-#endif
-        _err (__FILE__, __LINE__, "memory allocation failed\n");
+      _array = static_cast <node*>  (_allocate (SECTION_ARRAY, sizeof (node)  * size_));
+      _tail  = static_cast <char*>  (_allocate (SECTION_TAIL,  length_));
+      _tail0 = static_cast <int*>   (_allocate (SECTION_TAIL0, sizeof (int)));
       if (std::fseek (fp, static_cast <long> (offset), SEEK_SET) != 0) return -1;
       if (length_ != std::fread (_tail,  sizeof (char), length_, fp) ||
           size_   != std::fread (_array, sizeof (node), size_,   fp))
@@ -403,6 +829,9 @@ namespace cedar {
       _size = static_cast <int> (size_);
       *_length0 = 0;
 #if (USE_FAST_LOAD == 1)
+      if (! load_info) return 0;
+      _ninfo = static_cast <ninfo*> (_allocate (SECTION_NINFO, sizeof (ninfo) * size_));
+      _block = static_cast <block*> (_allocate (SECTION_BLOCK, sizeof (block) * (size_ >> 8)));
       const char* const info
         = std::strcat (std::strcpy (new char[std::strlen (fn) + 5], fn), ".sbl");
       fp = std::fopen (info, mode);
@@ -421,9 +850,26 @@ namespace cedar {
 #endif
       return 0;
     }
-    void restore () { // restore information to update
+    // map all sections of a file saved by save () by one mmap () without
+    // copying, so that processes share one copy on page cache; "offset" must
+    // be page aligned. section checksums are not verified (open () does).
+    // the mapping is private and writable; updates copy only the pages they
+    // touch and never modify the file, and a section moves to heap when it
+    // has to grow
+    int open_with_mmap (const char* fn, const char* mode = "rb", const size_t offset = 0, const bool load_info = true) {
+      FILE* fp = std::fopen (fn, mode);
+      if (! fp) return -1;
+      file_header h;
+      const int legacy = file_read_header (fileno (fp), offset, h);
+      const int ret = legacy ? -1 : _open_file (fileno (fp), offset, h, true, load_info);
+      std::fclose (fp);
+      return legacy > 0 ? open (fn, mode, offset, 0, load_info) : ret; // legacy is not aligned
+    }
+    // restore information to update; _ninfo is rebuilt block by block by
+    // "num_threads" threads (0 for one per core)
+    void restore (unsigned num_threads = 0) {
       if (! _block) _restore_block ();
-      if (! _ninfo) _restore_ninfo ();
+      if (! _ninfo) _restore_ninfo (num_threads);
       _capacity = _size;
       _quota  = *_length;
       _quota0 = 1;
@@ -440,20 +886,20 @@ namespace cedar {
     const void* array () const { return _array; }
     void clear (const bool reuse = true) {
       if (_no_delete) _array = 0, _tail = 0;
-      if (_array) { std::free (_array); _array = 0; }
-      if (_tail)  { std::free (_tail);  _tail  = 0; }
-      if (_tail0) { std::free (_tail0); _tail0 = 0; }
-      if (_ninfo) { std::free (_ninfo); _ninfo = 0; }
-      if (_block) { std::free (_block); _block = 0; }
+      if (_array) { _release (_array, SECTION_ARRAY); _array = 0; }
+      if (_tail)  { _release (_tail,  SECTION_TAIL);  _tail  = 0; }
+      if (_tail0) { _release (_tail0, SECTION_TAIL0); _tail0 = 0; }
+      if (_ninfo) { _release (_ninfo, SECTION_NINFO); _ninfo = 0; }
+      if (_block) { _release (_block, SECTION_BLOCK); _block = 0; }
       _bheadF = _bheadC = _bheadO = _capacity = _size = _quota = _quota0 = 0;
+      _bnumO = _bnumC = 0;
+      _counted = false; // until a loader or _initialize () sets counters
       if (reuse) _initialize ();
       _no_delete = false;
     }
     // return the first child for a tree rooted by a given node
     int begin (npos_t& from, size_t& len) {
-#if (USE_FAST_LOAD == 0)
       if (! _ninfo) _restore_ninfo ();
-#endif
       int base = from >> 32 ? - static_cast <int> (from >> 32) : _array[from].base;
       if (base >= 0) { // on trie
         uchar c = _ninfo[from].child;
@@ -488,8 +934,23 @@ namespace cedar {
       if (! c) return CEDAR_NO_PATH;
       return begin (from = static_cast <size_t> (_array[from].base) ^ c, ++len);
     }
+    // iterate over all keys, or keys starting with "key", in the order of
+    // begin () and next (): for (const auto& kv : trie) ...; updates
+    // invalidate iterators
+    const_iterator begin () const { return const_iterator (*this, 0, "", 0); }
+    const_iterator end   () const { return const_iterator (); }
+    const_iterator predict_begin (const char* key) const
+    { return predict_begin (key, std::strlen (key)); }
+    const_iterator predict_begin (const char* key, size_t len) const {
+      npos_t from = 0;
+      size_t pos  = 0;
+      if (_find (key, from, pos, len) == CEDAR_NO_PATH && pos < len) return end ();
+      return const_iterator (*this, from, key, len);
+    }
     npos_t tracking_node[NUM_TRACKING_NODES + 1];
   private:
+    friend class da_const_iterator <da>;
+    friend class da_matcher <da>;
     // currently disabled; implement these if you need
     da (const da&);
     da& operator= (const da&);
@@ -506,25 +967,138 @@ namespace cedar {
     int     _quota;
     int     _quota0;
     int     _no_delete;
+    static const file_section SECTION_TAIL0 = NUM_SECTIONS; // never saved
+    size_t  _mmap_len[NUM_SECTIONS + 1];  // mapped bytes of each section; 0 if not
+    size_t  _alloc_len[NUM_SECTIONS + 1]; // bytes of each section from _alloc
+    allocator_type _alloc;
+    // counters of stats (); _count () recomputes them for loaded tries
+    mutable size_t _num_keys;
+    mutable size_t _nonzero_size;
+    mutable size_t _nonzero_length;
+    mutable int    _bnumO;  // # blocks on Open but block 0
+    mutable int    _bnumC;  // # blocks on Closed but block 0
+    mutable bool   _counted;
     short   _reject[257];
     //
     static void _err (const char* fn, const int ln, const char* msg)
     { std::fprintf (stderr, "cedar: %s [%d]: %s", fn, ln, msg); std::exit (1); }
+    // return a section to _alloc or unmap a mapped one
+    void _release (void* p, const file_section i) {
+      if (_mmap_len[i]) munmap (p, _mmap_len[i]);
+      else if (p) _alloc.deallocate (p, _alloc_len[i]);
+      _mmap_len[i] = _alloc_len[i] = 0;
+    }
+    // allocate "n" bytes for a section
+    void* _allocate (const file_section i, const size_t n) {
+      void* const p = _alloc.allocate (n);
+      if (! p) _err (__FILE__, __LINE__, "memory allocation failed\n");
+      _alloc_len[i] = n;
+      return p;
+    }
+    // resize a section from "size_p" items to "size_n" items; items added
+    // are value-initialized unless "fill" is false. a mapped section moves
+    // to memory from _alloc, since a mapping cannot grow beyond the file
     template <typename T>
-    static void _realloc_array (T*& p, const int size_n, const int size_p = 0) {
-      void* tmp = std::realloc (p, sizeof (T) * static_cast <size_t> (size_n));
-      if (! tmp)
-        std::free (p), _err (__FILE__, __LINE__, "memory reallocation failed\n");
-      p = static_cast <T*> (tmp);
+    void _grow (T*& p, const file_section i, const int size_n, const int size_p, const bool fill = true) {
+      const size_t n = sizeof (T) * static_cast <size_t> (size_n);
+      void* q = 0;
+      if (! _mmap_len[i])
+        q = _alloc.reallocate (p, _alloc_len[i], n);
+      else if ((q = _alloc.allocate (n)))
+        std::memcpy (q, p, sizeof (T) * static_cast <size_t> (size_p)),
+        munmap (p, _mmap_len[i]), _mmap_len[i] = 0;
+      if (! q) _err (__FILE__, __LINE__, "memory reallocation failed\n");
+      p = static_cast <T*> (q);
+      _alloc_len[i] = n;
       static const T T0 = T ();
-      for (T* q (p + size_p), * const r (p + size_n); q != r; ++q) *q = T0;
+      if (fill) std::fill (p + size_p, p + size_n, T0);
+    }
+    // describe this trie in a header of cedar_format.h
+    void _file_header (file_header& h) const {
+      file_header_init <value_type, node, ninfo, block>
+        (h, TRIE_PREFIX_DA, NO_VALUE, NO_PATH, ORDERED, MAX_TRIAL, NUM_TRACKING_NODES);
+      h.size = _size, h.bheadF = _bheadF, h.bheadC = _bheadC, h.bheadO = _bheadO;
+    }
+    // load sections described by "h" at "offset" of "fd" by reading them or
+    // by mapping them all with one mmap ()
+    int _open_file (const int fd, const size_t offset, const file_header& h, const bool use_mmap, const bool load_info = true) {
+      file_header expected;
+      _file_header (expected);
+      if (file_header_mismatch (h, expected)) return -1;
+      const uint64_t tail_length = h.section[SECTION_TAIL].length;
+      const bool has_info = h.section[SECTION_NINFO].length && h.section[SECTION_BLOCK].length;
+      if (tail_length < sizeof (int) || tail_length > INT_MAX ||
+          (has_info && (h.section[SECTION_NINFO].length != sizeof (ninfo) * static_cast <size_t> (h.size) ||
+                        h.section[SECTION_BLOCK].length != sizeof (block) * static_cast <size_t> (h.size >> 8))))
+        return -1; // inconsistent sections
+      size_t end = 0; // of the last section
+      for (int i = 0; i < NUM_SECTIONS; ++i)
+        if (h.section[i].length) end = h.section[i].offset + h.section[i].length;
+      struct stat st;
+      if (fstat (fd, &st) != 0 || static_cast <size_t> (st.st_size) < offset + end) return -1;
+      clear (false);
+      void* data[NUM_SECTIONS] = {};
+      const bool skip_info = ! has_info || ! load_info;
+      if (use_mmap) {
+        char* const p = static_cast <char*> (mmap (NULL, end, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast <off_t> (offset)));
+        if (p == MAP_FAILED) { _initialize (); return -1; }
+        munmap (p, h.section[SECTION_ARRAY].offset); // header
+        advise_huge_pages (p + h.section[SECTION_ARRAY].offset, end - h.section[SECTION_ARRAY].offset);
+        for (int i = 0; i < NUM_SECTIONS; ++i)
+          if (skip_info && (i == SECTION_NINFO || i == SECTION_BLOCK)) { // unmap them
+            if (h.section[i].length) munmap (p + h.section[i].offset, file_align (h.section[i].length));
+          } else if (h.section[i].length)
+            data[i] = p + h.section[i].offset, _mmap_len[i] = file_align (h.section[i].length);
+      } else {
+        for (int i = 0; i < NUM_SECTIONS; ++i) {
+          if (! h.section[i].length || (skip_info && (i == SECTION_NINFO || i == SECTION_BLOCK))) continue;
+          data[i] = _allocate (static_cast <file_section> (i), h.section[i].length);
+          if (pread (fd, data[i], h.section[i].length, static_cast <off_t> (offset + h.section[i].offset))
+              != static_cast <ssize_t> (h.section[i].length) ||
+              fnv1a (data[i], h.section[i].length) != h.section[i].checksum) { // corrupted
+            for (int j = 0; j <= i; ++j) _release (data[j], static_cast <file_section> (j));
+            _initialize ();
+            return -1;
+          }
+        }
+      }
+      _array = static_cast <node*>  (data[SECTION_ARRAY]);
+      _ninfo = static_cast <ninfo*> (data[SECTION_NINFO]);
+      _block = static_cast <block*> (data[SECTION_BLOCK]);
+      _tail  = static_cast <char*>  (data[SECTION_TAIL]);
+      _grow (_tail0, SECTION_TAIL0, 1, 0);
+      *_length0 = 0;
+      _size  = _capacity = h.size;
+      _quota = *_length;
+      _quota0 = 1;
+      _bheadF = h.bheadF, _bheadC = h.bheadC, _bheadO = h.bheadO;
+      if (file_has_counts (h)) { // otherwise counted on the first query
+        _num_keys       = static_cast <size_t> (h.num_keys);
+        _nonzero_size   = static_cast <size_t> (h.num_nodes);
+        _nonzero_length = static_cast <size_t> (h.tail_length);
+        _count_blocks ();
+        _counted = true;
+      }
+      return 0; // update () restores _ninfo and _block if skipped
+    }
+    // make room for "needed" more bytes on tail
+    void _reserve_tail (const int needed) {
+      if (_quota < *_length + needed) {
+#if (USE_EXACT_FIT == 1)
+        _quota += needed > *_length || needed > MAX_ALLOC_SIZE ? needed :
+                  (*_length >= MAX_ALLOC_SIZE ? MAX_ALLOC_SIZE : *_length);
+#else
+        _quota += _quota >= needed ? _quota : needed;
+#endif
+        _grow (_tail, SECTION_TAIL, _quota, *_length);
+      }
     }
     void _initialize () { // initilize the first special block
-      _realloc_array (_array, 256, 256);
-      _realloc_array (_tail,  sizeof (int));
-      _realloc_array (_tail0, 1);
-      _realloc_array (_ninfo, 256);
-      _realloc_array (_block, 1);
+      _grow (_array, SECTION_ARRAY, 256, 0, false);
+      _grow (_tail,  SECTION_TAIL,  sizeof (int), 0);
+      _grow (_tail0, SECTION_TAIL0, 1, 0);
+      _grow (_ninfo, SECTION_NINFO, 256, 0);
+      _grow (_block, SECTION_BLOCK, 1, 0);
       _array[0] = node (0, -1);
       for (int i = 1; i < 256; ++i)
         _array[i] = node (i == 1 ? -255 : - (i - 1), i == 255 ? -1 : - (i + 1));
@@ -532,6 +1106,9 @@ namespace cedar {
       _block[0].ehead = 1; // bug fix for erase
       _quota  = *_length  = static_cast <int> (sizeof (int));
       _quota0 = 1;
+      _num_keys = _nonzero_size = _nonzero_length = 0;
+      _bnumO = _bnumC = 0;
+      _counted = true;
       for (size_t i = 0 ; i <= NUM_TRACKING_NODES; ++i) tracking_node[i] = 0;
       for (short  i = 0; i <= 256; ++i) _reject[i] = i + 1;
     }
@@ -547,6 +1124,13 @@ namespace cedar {
         to = _resolve (from, base, label, cf);
       return to;
     }
+    // # bytes of "key" that match the tail at "offset"; short keys take the
+    // plain loop, and vectors read no byte past the _quota bytes of _tail
+    size_t _tail_mismatch (const char* key, const size_t offset, const size_t len) const {
+      if (len < 16) return mismatch_scalar (key, &_tail[offset], len);
+      const size_t avail = static_cast <size_t> (_quota) - offset;
+      return tail_mismatch (key, &_tail[offset], len < avail ? len : avail);
+    }
     // find key from double array
     int _find (const char* key, npos_t& from, size_t& pos, const size_t len) const {
       npos_t offset = from >> 32;
@@ -569,7 +1153,7 @@ namespace cedar {
       const size_t pos_orig = pos; // start position in reading _tail
       const char* const tail = &_tail[offset] - pos;
       if (pos < len) {
-        do if (key[pos] != tail[pos]) break; while (++pos < len);
+        pos += _tail_mismatch (key + pos, offset, len - pos);
         if (const npos_t moved = pos - pos_orig) {
           from &= TAIL_OFFSET_MASK;
           from |= (offset + moved) << 32;
@@ -579,20 +1163,111 @@ namespace cedar {
       if (tail[pos]) return CEDAR_NO_VALUE;  // input < tail
       return *reinterpret_cast <const int*> (&tail[len + 1]);
     }
-    void _restore_ninfo () {
-      _realloc_array (_ninfo, _size);
-      for (int to = 0; to < _size; ++to) {
-        const int from = _array[to].check;
-        if (from < 0) continue; // skip empty node
-        const int base = _array[from].base;
-        if (const uchar label = static_cast <uchar> (base ^ to)) // skip leaf
-          _push_sibling (static_cast <size_t> (from), base, label,
-                         ! from || _ninfo[from].child || _array[base ^ 0].check == from);
+    // follow key from "from" as far as the trie has it, leaving the value,
+    // length (= pos) and id of each key that ends on the way; false if the
+    // walk left the trie, so that no longer key can match
+    bool _longest (const char* key, npos_t& from, size_t& pos, const size_t len,
+                   int& value, size_t& length, npos_t& id) const {
+      const uchar* const key_ = reinterpret_cast <const uchar*> (key);
+      npos_t offset = from >> 32;
+      if (! offset) { // node on trie
+        for (; _array[from].base >= 0; ) {
+          if (pos == len) return true;
+          if (! key_[pos]) return false; // would follow the terminal
+          const size_t to = static_cast <size_t> (_array[from].base) ^ key_[pos];
+          if (_array[to].check != static_cast <int> (from)) return false;
+          from = to, ++pos;
+          if (_array[from].base < 0) break;
+          const node& n = _array[_array[from].base ^ 0];
+          if (n.check == static_cast <int> (from)) value = n.base, length = pos, id = from;
+        }
+        offset = static_cast <npos_t> (-_array[from].base);
+      }
+      // on _tail, whose NUL ends the only key below; stop key bytes there
+      size_t moved = pos < len ? _tail_mismatch (key + pos, offset, len - pos) : 0;
+      if (const void* end = std::memchr (&_tail[offset], 0, moved))
+        moved = static_cast <size_t> (static_cast <const char*> (end) - &_tail[offset]);
+      if (moved) {
+        pos += moved, offset += moved;
+        from &= TAIL_OFFSET_MASK;
+        from |= offset << 32;
+      }
+      if (_tail[offset]) return pos == len; // within the tail
+      value = *reinterpret_cast <const int*> (&_tail[offset + 1]), length = pos, id = from;
+      return false;
+    }
+    // visit the keys below from, at depth d, within the bound of rows;
+    // false if visit returned false
+    template <typename F>
+    bool _fuzzy (edit_rows& rows, const size_t from, size_t d, F& visit, size_t& num) const {
+      const int base = _array[from].base;
+      if (base < 0) { // the rest of the only key below is on _tail
+        const char* tail = &_tail[-base];
+        for (; *tail; ++tail)
+          if (! rows.push (++d, static_cast <uchar> (*tail))) return true;
+        if (! rows.within (d)) return true;
+        ++num;
+        return visit (rows.path (d), d, *reinterpret_cast <const value_type*> (tail + 1), rows.distance (d));
+      }
+      uchar c = from ? _ninfo[from].child : _ninfo[0].sibling;
+      if (! from && ! c) return true; // empty
+      do {
+        const size_t to = static_cast <size_t> (base ^ c);
+        if (! c) { // a key ends at from
+          if (rows.within (d)) {
+            ++num;
+            if (! visit (rows.path (d), d, _array[to].value, rows.distance (d))) return false;
+          }
+        } else if (rows.push (d + 1, c) && ! _fuzzy (rows, to, d + 1, visit, num))
+          return false;
+      } while ((c = _ninfo[base ^ c].sibling));
+      return true;
+    }
+    // siblings share a block, so each block rebuilds their chains and the
+    // first child of their parent on its own; threads write disjoint bytes
+    void _restore_ninfo (unsigned num_threads = 1) {
+      _grow (_ninfo, SECTION_NINFO, _size, 0);
+      const int num_blocks = _size >> 8;
+      if (! num_threads) num_threads = std::thread::hardware_concurrency ();
+      num_threads = std::max (1u, std::min (num_threads, static_cast <unsigned> (num_blocks / MIN_RESTORE_BLOCKS)));
+      std::vector <std::thread> threads;
+      for (unsigned t = 1; t < num_threads; ++t)
+        threads.emplace_back (&da::_restore_ninfo_blocks, this,
+                              static_cast <int> (num_blocks * static_cast <int64_t> (t) / num_threads),
+                              static_cast <int> (num_blocks * static_cast <int64_t> (t + 1) / num_threads));
+      _restore_ninfo_blocks (0, static_cast <int> (num_blocks / num_threads));
+      for (size_t t = 0; t < threads.size (); ++t) threads[t].join ();
+    }
+    // push nodes of blocks [bi, bz) in front of their siblings, largest label first
+    void _restore_ninfo_blocks (int bi, const int bz) {
+      for (; bi < bz; ++bi) {
+        const int e0 = bi << 8;
+        if (bi + 1 < bz) // parents of the next block
+          for (int i = 256; i < 512; ++i)
+            if (_array[e0 + i].check >= 0) {
+              CEDAR_PREFETCH (&_array[_array[e0 + i].check]);
+              CEDAR_PREFETCH (&_ninfo[_array[e0 + i].check]);
+            }
+        uchar label[256];
+        short order[256];
+        int   num[257] = {}; // where nodes go, sorted by label in descending order
+        for (int i = 0; i < 256; ++i)
+          if (_array[e0 + i].check >= 0) // skip empty node and the root
+            ++num[256 - (label[i] = static_cast <uchar> (_array[_array[e0 + i].check].base ^ (e0 + i)))];
+        for (int l = 1; l <= 256; ++l) num[l] += num[l - 1];
+        for (int i = 0; i < 256; ++i)
+          if (_array[e0 + i].check >= 0) order[num[255 - label[i]]++] = static_cast <short> (i);
+        for (int k = 0; k < num[256]; ++k) {
+          const int to = e0 + order[k], from = _array[to].check;
+          uchar& c = from ? _ninfo[from].child : _ninfo[0].sibling; // root: 0 ^ 0
+          _ninfo[to].sibling = c, c = label[order[k]];
+        }
       }
     }
     void _restore_block () {
-      _realloc_array (_block, _size >> 8);
+      _grow (_block, SECTION_BLOCK, _size >> 8, 0);
       _bheadF = _bheadC = _bheadO = 0;
+      _bnumO = _bnumC = 0;
       for (int bi (0), e (0); e < _size; ++bi) { // register blocks to full
         block& b = _block[bi];
         b.num = 0;
@@ -602,6 +1277,89 @@ namespace cedar {
         _push_block (bi, head_out, ! head_out && b.num);
       }
     }
+    // count keys, nodes and tails in use, and blocks on Open and Closed, for
+    // a trie loaded without counters
+    void _count () const {
+      _num_keys = _nonzero_size = _nonzero_length = 0;
+      for (int to = 0; to < _size; ++to) {
+        const node& n = _array[to];
+        if (n.check < 0) continue;
+        ++_nonzero_size;
+        if (_array[n.check].base == to) ++_num_keys; // label 0
+        else if (n.base < 0) // leaf with tail
+          ++_num_keys, _nonzero_length += std::strlen (&_tail[-n.base]) + 1 + sizeof (value_type);
+      }
+      _count_blocks ();
+      _counted = true;
+    }
+    void _count_blocks () const {
+      _bnumO = _block ? _num_blocks (_bheadO) : 0;
+      _bnumC = _block ? _num_blocks (_bheadC) : 0;
+    }
+    // # blocks but block 0 that _restore_block () puts on Open and Closed
+    void _count_blocks_in_array (size_t& open, size_t& closed) const {
+      open = closed = 0;
+      for (int bi = 1; bi < (_size >> 8); ++bi) {
+        int num = 0; // empty nodes, up to 2
+        for (int e = bi << 8; e < (bi << 8) + 256 && num < 2; ++e) num += _array[e].check < 0;
+        if (num == 1) ++closed;
+        else if (num) ++open;
+      }
+    }
+    // # blocks on the ring from "head" but block 0; 0 if "head" is 0
+    int _num_blocks (const int head) const {
+      int n = 0;
+      if (head) { int bi = head; do n += bi != 0; while ((bi = _block[bi].next) != head); }
+      return n;
+    }
+    // keep the number of blocks on Open or Closed, as "head" tells, when
+    // block "bi" joins (d = 1) or leaves (d = -1) the list; block 0 stays out
+    void _count_block (const int bi, const int& head, const int d) {
+      if (! bi) return;
+      if (&head == &_bheadO) _bnumO += d;
+      else if (&head == &_bheadC) _bnumC += d;
+    }
+    // freeze () through frozen_minimizer, which takes keys in byte order
+    int _freeze_minimized (frozen_type& t) const {
+      frozen_minimizer <value_type> fm;
+      std::vector <std::pair <std::string, value_type> > keys; // to sort
+      for (const_iterator it = begin (); it != end (); ++it)
+        if (ORDERED) fm.insert (it->key, it->length, it->value);
+        else keys.emplace_back (std::string (it->key, it->length), it->value);
+      std::sort (keys.begin (), keys.end ());
+      for (size_t i = 0; i < keys.size (); ++i)
+        fm.insert (keys[i].first.data (), keys[i].first.size (), keys[i].second);
+      return fm.finish (t) ? 0 : -1;
+    }
+    // hash of the len labels and tail bytes from root down to the
+    // completion at from, or 0 if from is no longer a completion len bytes
+    // under root; never ~0, which marks the end of a cursor
+    uint64_t _path_hash (const npos_t from, uint64_t len, const npos_t root) const {
+      size_t e = from & TAIL_OFFSET_MASK;
+      const size_t r = root & TAIL_OFFSET_MASK;
+      if (e >= static_cast <size_t> (_size) || (e != r && _array[e].check < 0)) return 0;
+      uint64_t h = fnv1a (&len, sizeof (len));
+      const int base = _array[e].base;
+      if (const size_t offset = from >> 32) { // on tail
+        if (base >= 0) return 0;
+        const size_t start = e == r && root >> 32 ? root >> 32 : static_cast <size_t> (-base);
+        if (offset < start || offset - start > len ||
+            offset != static_cast <size_t> (-base) + std::strlen (&_tail[-base])) return 0;
+        h = fnv1a (&_tail[start], offset - start, h);
+        len -= offset - start;
+      } else if (base < 0 || base >= _size || _array[base ^ 0].check != static_cast <int> (e))
+        return 0;
+      for (; len; --len) {
+        const int p = _array[e].check;
+        if (p < 0) return 0;
+        const int label = _array[p].base ^ static_cast <int> (e);
+        h = fnv1a (&label, sizeof (label), h);
+        e = static_cast <size_t> (p);
+      }
+      if (e != r) return 0;
+      h |= 1; // not 0
+      return h == ~uint64_t (0) ? h - 2 : h;
+    }
     void _set_result (result_type* x, value_type r, size_t = 0, npos_t = 0) const
     { *x = r; }
     void _set_result (result_pair_type* x, value_type r, size_t l, npos_t = 0) const
@@ -609,6 +1367,7 @@ namespace cedar {
     void _set_result (result_triple_type* x, value_type r, size_t l, npos_t from) const
     { x->value = r; x->length = l; x->id = from; }
     void _pop_block (const int bi, int& head_in, const bool last) {
+      _count_block (bi, head_in, -1);
       if (last) { // last one poped; Closed or Open
         head_in = 0;
       } else {
@@ -619,6 +1378,7 @@ namespace cedar {
       }
     }
     void _push_block (const int bi, int& head_out, const bool empty) {
+      _count_block (bi, head_out, 1);
       block& b = _block[bi];
       if (empty) { // the destination is empty
         head_out = b.prev = b.next = bi;
@@ -636,9 +1396,9 @@ namespace cedar {
 #else
         _capacity += _capacity;
 #endif
-        _realloc_array (_array, _capacity, _capacity);
-        _realloc_array (_ninfo, _capacity, _size);
-        _realloc_array (_block, _capacity >> 8, _size >> 8);
+        _grow (_array, SECTION_ARRAY, _capacity, _size, false);
+        _grow (_ninfo, SECTION_NINFO, _capacity, _size);
+        _grow (_block, SECTION_BLOCK, _capacity >> 8, _size >> 8);
       }
       _block[_size >> 8].ehead = _size;
       _array[_size] = node (- (_size + 255),  - (_size + 1));
@@ -673,6 +1433,7 @@ namespace cedar {
       if (label) n.base = -1; else n.value = value_type (0);
       n.check = from;
       if (base < 0) _array[from].base = e ^ label;
+      ++_nonzero_size;
       return e;
     }
     // push empty node into empty ring
@@ -694,6 +1455,7 @@ namespace cedar {
         b.trial = 0;
       }
       if (b.reject < _reject[b.num]) b.reject = _reject[b.num];
+      --_nonzero_size;
       _ninfo[e] = ninfo (); // reset ninfo; no child, no sibling
     }
     // push label to from's child
@@ -754,6 +1516,112 @@ namespace cedar {
       }
       return _add_block () << 8;
     }
+    // explore blocks before "limit" on Closed and Open for a base of the
+    // labels from "first" to "last"; -1 if none has room
+    int _find_place_below (const uchar* const first, const uchar* const last, const int limit) {
+      const short nc = static_cast <short> (last - first + 1);
+      const int head[2] = {_bheadC, _bheadO};
+      for (int i = 0; i < 2; ++i) {
+        if (! head[i]) continue;
+        int bi = head[i];
+        do {
+          block& b = _block[bi];
+          if (bi < limit && b.num >= nc && nc < b.reject) {
+            for (int e = b.ehead;;) {
+              const int base = e ^ *first;
+              const uchar* p = first;
+              while (p != last && _array[base ^ *(p + 1)].check < 0) ++p;
+              if (p == last) return e; // no conflict
+              if ((e = -_array[e].check) == b.ehead) break;
+            }
+            b.reject = nc;
+          }
+          bi = b.next;
+        } while (bi != head[i]);
+      }
+      return -1;
+    }
+    // move every node in block "bi" to blocks before it, together with its
+    // siblings; false if some do not fit
+    template <typename T>
+    bool _evacuate_block (const int bi, T& cf) {
+      for (int e = bi << 8; e < (bi << 8) + 256; ++e) {
+        const int from = _array[e].check;
+        if (from < 0) continue;
+        uchar child[256];
+        const int base_p = _array[from].base;
+        const uchar* const last = _set_child (child, base_p, _ninfo[from].child);
+        const int e_ = _find_place_below (child, last, bi);
+        if (e_ < 0) return false;
+        const int base = e_ ^ *child;
+        _array[from].base = base;
+        for (const uchar* p = child; p <= last; ++p) { // to_ => to
+          const int to  = _pop_enode (base, *p, from);
+          const int to_ = base_p ^ *p;
+          _ninfo[to].sibling = p == last ? 0 : *(p + 1);
+          cf (to_, to);
+          node& n  = _array[to];
+          node& n_ = _array[to_];
+          if ((n.base = n_.base) > 0 && *p) { // copy base
+            uchar c = _ninfo[to].child = _ninfo[to_].child;
+            do _array[n.base ^ c].check = to; // adjust grand son's check
+            while ((c = _ninfo[n.base ^ c].sibling));
+          }
+          _track (to_, to);
+          _push_enode (to_);
+        }
+      }
+      return true;
+    }
+    // keep tracking_node on a node moved from "to_" to "to", whose tail
+    // moved by "shift" if any
+    void _track (const int to_, const int to, const npos_t shift = 0) {
+      if (NUM_TRACKING_NODES)
+        for (size_t j = 0; tracking_node[j] != 0; ++j)
+          if (static_cast <int> (tracking_node[j] & TAIL_OFFSET_MASK) == to_) {
+            const npos_t offset = tracking_node[j] >> 32;
+            tracking_node[j] = static_cast <npos_t> (to) | (offset ? (offset + shift) << 32 : 0);
+          }
+    }
+    // give back the room beyond _size; mapped sections stay, since they
+    // would move to memory from _alloc
+    void _shrink_to_fit () {
+      if (_no_delete || _capacity == _size ||
+          _mmap_len[SECTION_ARRAY] || _mmap_len[SECTION_NINFO] || _mmap_len[SECTION_BLOCK]) return;
+      _grow (_array, SECTION_ARRAY, _size, _size, false);
+      _grow (_ninfo, SECTION_NINFO, _size, _size);
+      _grow (_block, SECTION_BLOCK, _size >> 8, _size >> 8);
+      _capacity = _size;
+    }
+    // bytes of the arrays and tail
+    size_t _footprint () const {
+      return (sizeof (node) + sizeof (ninfo)) * static_cast <size_t> (_capacity)
+        + sizeof (block) * static_cast <size_t> (_capacity >> 8) + static_cast <size_t> (_quota);
+    }
+    // explore the last blocks regardless of their lists; build_sorted ()
+    // fills blocks in order as darts does, while a single child takes the
+    // oldest empty node to fill older blocks
+    int _find_place_recent (const uchar* const first, const uchar* const last) {
+      const short nc = static_cast <short> (last - first + 1);
+      if (nc == 1) {
+        if (_bheadC) return _block[_bheadC].ehead;
+        if (_bheadO) return _block[_block[_bheadO].prev].ehead;
+      }
+      const int   bz = _size >> 8;
+      for (int bi = bz > NUM_RECENT_BLOCKS ? bz - NUM_RECENT_BLOCKS : 1; bi < bz; ++bi) {
+        block& b = _block[bi];
+        if (b.num < nc || nc >= b.reject) continue;
+        for (int e = b.ehead;;) {
+          const int base = e ^ *first;
+          const uchar* p = first;
+          while (p != last && _array[base ^ *(p + 1)].check < 0) ++p;
+          if (p == last) return e; // no conflict
+          if ((e = -_array[e].check) == b.ehead) break;
+        }
+        b.reject = nc;
+      }
+      return _add_block () << 8;
+    }
     // resolve conflict on base_n ^ label_n = base_p ^ label_p
     template <typename T>
     int _resolve (npos_t& from_n, const int base_n, const uchar label_n, T& cf) {
@@ -821,5 +1689,148 @@ namespace cedar {
       } while ((c = _ninfo[base ^ c].sibling));
     }
   };
+  // forward iterator over the keys of a subtree; the current key is kept in
+  // a buffer that grows and shrinks with the walk, so a step costs only the
+  // labels (and tail) that change, not a walk back to the root by suffix ()
+  template <typename trie_type>
+  class da_const_iterator {
+  public:
+    typedef std::forward_iterator_tag          iterator_category;
+    typedef typename trie_type::key_value_type value_type;
+    typedef std::ptrdiff_t                     difference_type;
+    typedef const value_type*                  pointer;
+    typedef const value_type&                  reference;
+    da_const_iterator () : _trie (0), _root (0), _from (END), _key (), _kv () {}
+    // the first key below "root", which "prefix" leads to
+    da_const_iterator (const trie_type& trie, const npos_t root, const char* prefix, const size_t len)
+      : _trie (&trie), _root (root), _from (root), _key (prefix, len), _kv () {
+      const int base = _from >> 32 ? - static_cast <int> (_from >> 32) : _trie->_array[_from].base;
+      if (base < 0) { _tail (base); return; }
+      uchar c = _child (static_cast <int> (_from));
+      if (! _from && ! (c = _sibling (base ^ c, 0))) { _from = END; return; } // no entry
+      _down (c);
+    }
+    reference operator*  () const { _kv.key = _key.c_str (); return _kv; } // _key may be copied
+    pointer   operator-> () const { return &**this; }
+    da_const_iterator& operator++ () {
+      uchar c = 0;
+      if (const int offset = static_cast <int> (_from >> 32)) { // on tail
+        if (_root >> 32) { _from = END; return *this; }
+        _from &= TAIL_OFFSET_MASK;
+        _key.resize (_key.size () - static_cast <size_t> (offset + _trie->_array[_from].base));
+      } else
+        c = _sibling (_trie->_array[_from].base ^ 0, static_cast <int> (_from));
+      for (; ! c && _from != _root; _key.resize (_key.size () - 1)) {
+        const int to = static_cast <int> (_from);
+        _from = static_cast <npos_t> (_trie->_array[_from].check);
+        c     = _sibling (to, static_cast <int> (_from));
+      }
+      if (c) _down (c); else _from = END;
+      return *this;
+    }
+    da_const_iterator operator++ (int) { da_const_iterator it (*this); ++*this; return it; }
+    bool operator== (const da_const_iterator& it) const { return _from == it._from; }
+    bool operator!= (const da_const_iterator& it) const { return _from != it._from; }
+  private:
+    static const npos_t END = ~static_cast <npos_t> (0);
+    const trie_type*   _trie;
+    npos_t             _root;
+    npos_t             _from;
+    std::string        _key;
+    mutable value_type _kv;
+    // follow the first children from child "c" of _from down to a key
+    void _down (uchar c) {
+      int base = _trie->_array[_from].base;
+      for (; c && base >= 0; c = _child (static_cast <int> (_from))) {
+        _from = static_cast <npos_t> (base ^ c);
+        _key.push_back (static_cast <char> (c));
+        base  = _trie->_array[_from].base;
+      }
+      if (base >= 0) _set (_trie->_array[base ^ 0].base);
+      else _tail (base);
+    }
+    // the first label below node "from", 0 for the end of a key (the root
+    // heads its own chain, 0 ^ 0, as in _ninfo); and the label after that
+    // of node "to" below its parent "from", 0 if none
+    uchar _child (const int from) const {
+      if (_trie->_ninfo) return _trie->_ninfo[from].child;
+      return from ? _probe (from, 0) : 0;
+    }
+    uchar _sibling (const int to, const int from) const {
+      if (_trie->_ninfo) return _trie->_ninfo[to].sibling;
+      const int label = to ^ _trie->_array[from].base;
+      return label < 255 ? _probe (from, label + 1) : 0;
+    }
+    // the first label from "c" on below "from", 0 if none, for a trie opened
+    // without _ninfo (see restore ()), which a const iterator does not
+    // rebuild; the 256 units of the base block are checked, as frozen_da
+    // finds children
+    uchar _probe (const int from, int c) const {
+      const int base = _trie->_array[from].base;
+      if (base < 0) return 0; // on a tail
+      for (; c < 256; ++c)
+        if (_trie->_array[base ^ c].check == from) return static_cast <uchar> (c);
+      return 0;
+    }
+    // append the rest of the tail at offset -"base"
+    void _tail (const int base) {
+      const char* const tail = &_trie->_tail[-base];
+      const size_t len = std::strlen (tail);
+      _key.append (tail, len);
+      _from &= TAIL_OFFSET_MASK;
+      _from |= static_cast <npos_t> (static_cast <size_t> (-base) + len) << 32;
+      int i;
+      std::memcpy (&i, tail + len + 1, sizeof (int));
+      _set (i);
+    }
+    void _set (const int i) {
+      union { int i; typename trie_type::result_type x; } b;
+      b.i = i;
+      _kv.length = _key.size ();
+      _kv.value  = b.x;
+      _kv.id     = _from;
+    }
+  };
+  // longest-prefix match over input that arrives in chunks, such as network
+  // buffers: feed () walks each chunk on from the node (or tail position)
+  // where the last one stopped, so a key split across chunks needs no copy;
+  // updates of the trie invalidate matchers
+  template <typename trie_type>
+  class da_matcher {
+  public:
+    typedef typename trie_type::result_type value_type;
+    // match keys below "root", e.g. a node that traverse () reached
+    explicit da_matcher (const trie_type& trie, const npos_t root = 0) : _trie (&trie) { reset (root); }
+    void reset (const npos_t root = 0)
+    { _from = _id = root, _pos = _length = 0, _value = trie_type::CEDAR_NO_VALUE, _alive = true; }
+    // walk on through len bytes of chunk; false if no longer key can match
+    bool feed (const char* chunk, const size_t len) {
+      if (! _alive) return false;
+      size_t pos (0), length (0);
+      _alive = _trie->_longest (chunk, _from, pos, len, _value, length, _id);
+      if (length) _length = _pos + length;
+      _pos += pos;
+      return _alive;
+    }
+    bool feed (const char* chunk) { return feed (chunk, std::strlen (chunk)); }
+    bool   alive    () const { return _alive; }
+    bool   found    () const { return _length; }
+    size_t consumed () const { return _pos; }    // bytes followed in the trie
+    size_t length   () const { return _length; } // of the longest match
+    npos_t id       () const { return _id; }     // where it ends; see suffix ()
+    value_type value () const { // of the longest match, or CEDAR_NO_VALUE
+      union { int i; value_type x; } b;
+      b.i = _value;
+      return b.x;
+    }
+  private:
+    const trie_type* _trie;
+    npos_t _from; // node reached, with the position on tail if any
+    size_t _pos;
+    size_t _length;
+    npos_t _id;
+    int    _value;
+    bool   _alive;
+  };
 }
 #endif
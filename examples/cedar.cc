@@ -25,36 +25,36 @@ int main(int argc, char **argv) {
   const size_t num_keys = trie.num_keys();
   //
   std::unique_ptr<trie_t::result_pair_type[]>   result_pair (new trie_t::result_pair_type[num_keys]);
-  std::unique_ptr<trie_t::result_triple_type[]> result_triple (new trie_t::result_triple_type[num_keys]);
 
   trie.dump(result_pair.get(), num_keys);
 
   char line[8192];
   while (std::fgets (line, 8192, stdin)) {
     line[std::strlen (line) - 1] = '\0';
+    // visitors print matches as they are found, with no result arrays
     std::fprintf (stdout, "commonPrefixSearch ():\n");
-    if (const size_t n = trie.commonPrefixSearch (line, result_pair.get(), num_keys)) {
-      std::fprintf (stdout, "%s: found, num=%ld ", line, n);
-      for (size_t i = 0; i < n; ++i) {
-        if (i >= num_keys) { std::fprintf (stdout, " ..truncated"); break; }
-        std::fprintf (stdout, " %d:%ld", result_pair[i].value, result_pair[i].length);
-      }
-      std::fprintf (stdout, "\n");
+    std::fprintf (stdout, "%s:", line);
+    if (const size_t n = trie.commonPrefixSearch (line, std::strlen (line),
+          [] (const int value, const size_t length, const auto) {
+            std::fprintf (stdout, " %d:%ld", value, length);
+            return true;
+          })) {
+      std::fprintf (stdout, " found, num=%ld\n", n);
     } else {
-      std::fprintf (stdout, "%s: not found\n", line);
+      std::fprintf (stdout, " not found\n");
     }
     char suffix[1024];
     std::fprintf (stdout, "commonPrefixPredict ():\n");
-    if (const size_t n = trie.commonPrefixPredict (line, result_triple.get(), num_keys)) {
-      std::fprintf (stdout, "%s: found, num=%ld ", line, n);
-      for (size_t i = 0; i < n; ++i) {
-        if (i >= num_keys) { std::fprintf (stdout, " ..truncated"); break; }
-        trie.suffix (suffix, result_triple[i].length, result_triple[i].id);
-        std::fprintf (stdout, " %d:%ld:%ld:%s", result_triple[i].value, result_triple[i].length, result_triple[i].id, suffix);
-      }
-      std::fprintf (stdout, "\n");
+    std::fprintf (stdout, "%s:", line);
+    if (const size_t n = trie.commonPrefixPredict (line, std::strlen (line),
+          [&] (const int value, const size_t length, const auto id) {
+            trie.suffix (suffix, length, id);
+            std::fprintf (stdout, " %d:%ld:%ld:%s", value, length, id, suffix);
+            return true;
+          })) {
+      std::fprintf (stdout, " found, num=%ld\n", n);
     } else {
-      std::fprintf (stdout, "%s: not found\n", line);
+      std::fprintf (stdout, " not found\n");
     }
   }
   return 0;
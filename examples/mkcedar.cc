@@ -3,6 +3,8 @@
 // Copyright (c) 2013-2014 Naoki Yoshinaga <ynaga@tkl.iis.u-tokyo.ac.jp>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
+#include <vector>
 
 #ifdef USE_PREFIX_TRIE
 #include <cedarpp.h>
@@ -12,17 +14,31 @@
 
 #include <gflags/gflags.h>
 
+DEFINE_bool(sorted, false, "keys are sorted in byte order; build the trie at once");
+
 int main (int argc, char **argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
   if (argc < 3)
-    { std::fprintf (stderr, "Usage: %s keys trie\n", argv[0]); std::exit (1); }
+    { std::fprintf (stderr, "Usage: %s [--sorted] keys trie\n", argv[0]); std::exit (1); }
   //
   cedar::da <int> trie;
   int n = 0;
   FILE* fp = argv[1][0] == '-' ? stdin : std::fopen (argv[1], "r");
   char line[8192];
-  while (std::fgets (line, 8192, fp))
-    trie.update (line, std::strlen (line) - 1, n++);
+  if (FLAGS_sorted) {
+    std::vector <std::string> keys;
+    while (std::fgets (line, 8192, fp))
+      keys.push_back (std::string (line, std::strlen (line) - 1));
+    std::vector <const char*> key;
+    std::vector <size_t> len;
+    for (size_t i = 0; i < keys.size (); ++i)
+      key.push_back (keys[i].c_str ()), len.push_back (keys[i].size ());
+    if (trie.build_sorted (key.size (), key.data (), len.data ()) != 0)
+      { std::fprintf (stderr, "keys are not sorted or not unique: %s\n", argv[1]); std::exit (1); }
+  } else {
+    while (std::fgets (line, 8192, fp))
+      trie.update (line, std::strlen (line) - 1, n++);
+  }
   std::fclose (fp);
   //
   if (trie.save (argv[2]) != 0)
@@ -49,27 +49,25 @@ public:
 class trie {
 private:
   trie_t* _t;
-  size_t  _num_keys;
 public:
-  trie  () : _t (new cedar::da <int> ()), _num_keys (0) {}
+  trie  () : _t (new cedar::da <int> ()) {}
   ~trie () { delete _t; }
   // read/write
   bool open (const char* fn) { return _t->open (fn, "rb") == 0; }
   bool save (const char* fn) { return _t->save (fn, "wb") == 0; }
   // get statistics
-  size_t num_keys () const { return _num_keys; } // O(1)
+  size_t num_keys () const { return _t->num_keys (); } // O(1)
   // low-level predicates
   int  insert (const char* key, int n = 0) {
     npos_t from = 0;
     size_t pos (0), len (std::strlen (key));
     const int n_ = _t->traverse (key, from, pos, len);
     bool flag = n_ == trie_t::CEDAR_NO_VALUE || n_ == trie_t::CEDAR_NO_PATH;
-    if (flag) ++_num_keys;
     _t->update (key, from, pos, len) = n;
     return flag ? 0 : -1;
   }
   int  erase  (const char* key)
-  { if (_t->erase (key)) return -1; else { --_num_keys; return 0; } }
+  { return _t->erase (key) ? -1 : 0; }
   int  lookup (const char* key) const
   { return _t->exactMatchSearch <trie_t::result_type> (key); }
   // high-level (trie-specific) predicates
@@ -84,14 +82,8 @@ public:
     return result;
   }
   result_t longest_prefix (const char* key) const {
-    result_t r (_t, 0, 0, trie_t::CEDAR_NO_VALUE); // result for not found
-    npos_t from = 0;
-    for (size_t pos (0), len (std::strlen (key)); pos < len; ) {
-      const int n = _t->traverse (key, from, pos, pos + 1);
-      if (n == trie_t::CEDAR_NO_PATH)  break;
-      if (n != trie_t::CEDAR_NO_VALUE) r.reset (from, pos, n);
-    }
-    return r;
+    const trie_t::result_triple_type r_ = _t->longestPrefixSearch <trie_t::result_triple_type> (key);
+    return result_t (_t, r_.id, r_.length, r_.value); // CEDAR_NO_VALUE if not found
   }
   trie_iterator predict (const char* key) {
     npos_t from = 0;
@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+
+#include <cedar_aho.h>
+
+typedef std::tuple<size_t, size_t, int> occurrence_t;
+
+/* every (start, end, value) by commonPrefixSearch () at each byte */
+std::vector<occurrence_t> find_all(const trie_int_t& trie, const std::string& text) {
+	std::vector<occurrence_t> found;
+	for (size_t i = 0; i < text.length(); i++) {
+		trie.commonPrefixSearch(text.c_str() + i, text.length() - i,
+			[&found, i] (int value, size_t length, size_t) {
+				found.emplace_back(i, i + length, value);
+				return true;
+			});
+	}
+	std::sort(found.begin(), found.end());
+	return found;
+}
+
+/**
+ * scan () reports each occurrence of a key in a text once, as a search
+ * from every byte does, also when the text comes in chunks.
+ */
+TEST(cedar, aho_corasick) {
+	trie_int_t trie;
+	std::vector<std::string> keys = {"he", "she", "his", "hers", "s", "ushers",
+		"a", "ab", "abc", "bc", "c", "caa", "xyz"};
+	for (int i = 0; i < 3000; i++) {
+		keys.push_back(std::to_string(i * 7919 % 3000));
+	}
+	for (size_t i = 0; i < keys.size(); i++) {
+		trie.update(keys[i].c_str(), keys[i].length(), static_cast<int>(i));
+	}
+	cedar::aho_corasick<trie_int_t> aho(trie);
+	EXPECT_GT(aho.total_size(), 0u);
+
+	std::string text = "ushers and his sheep; abcaab, 1234567890 xy xyz";
+	for (int i = 0; i < 200; i++) {
+		text += std::to_string(i * 31337) + (i % 3 ? " she " : "abc");
+	}
+	text += std::string("h\0ers", 5);
+	const std::vector<occurrence_t> expected = find_all(trie, text);
+	ASSERT_GT(expected.size(), text.length());
+
+	std::vector<occurrence_t> found;
+	auto visit = [&found] (size_t start, size_t end, int value) {
+		found.emplace_back(start, end, value);
+		return true;
+	};
+	EXPECT_EQ(aho.scan(text.c_str(), text.length(), visit), expected.size());
+	std::sort(found.begin(), found.end());
+	EXPECT_EQ(found, expected);
+
+	for (size_t chunk : {1, 3, 64}) {
+		found.clear();
+		size_t state = 0;
+		for (size_t pos = 0; pos < text.length(); pos += chunk) {
+			aho.scan(text.c_str() + pos, std::min(chunk, text.length() - pos), visit,
+				state, pos);
+		}
+		std::sort(found.begin(), found.end());
+		EXPECT_EQ(found, expected) << "in chunks of " << chunk;
+	}
+
+	/* stop at the first occurrence */
+	size_t calls = 0;
+	EXPECT_EQ(aho.scan("xx ushers", [&calls] (size_t start, size_t end, int value) {
+		/* "s", the first key to end */
+		EXPECT_EQ(start, 4u);
+		EXPECT_EQ(end, 5u);
+		EXPECT_EQ(value, 4);
+		return ++calls < 1;
+	}), 1u);
+
+	/* values are read from the trie */
+	trie.update("she", 3, 100);
+	EXPECT_FALSE(aho.stale());
+	/* new keys, which may relocate nodes, rebuild the links */
+	trie.update("ushe", 4, 7);
+	EXPECT_TRUE(aho.stale());
+	for (int i = 0; i < 3000; i++) {
+		const std::string key = "k" + std::to_string(i);
+		trie.update(key.c_str(), key.length(), i);
+	}
+	found.clear();
+	aho.scan(text.c_str(), text.length(), visit);
+	EXPECT_FALSE(aho.stale());
+	std::sort(found.begin(), found.end());
+	EXPECT_EQ(found, find_all(trie, text));
+
+	/* and so do erased keys */
+	for (size_t i = 13; i < keys.size(); i += 3) {
+		trie.erase(keys[i].c_str());
+	}
+	trie.erase("she");
+	EXPECT_TRUE(aho.stale());
+	found.clear();
+	aho.scan(text.c_str(), text.length(), visit);
+	std::sort(found.begin(), found.end());
+	EXPECT_EQ(found, find_all(trie, text));
+
+	/* a trie opened without _ninfo, which a const trie does not rebuild */
+	const std::string file = ::testing::TempDir() + "cedar_aho_test." + std::to_string(getpid());
+	ASSERT_EQ(trie.save(file.c_str()), 0);
+	trie_int_t loaded;
+	ASSERT_EQ(loaded.open(file.c_str(), "rb", 0, 0, false), 0);
+	const trie_int_t& read_only = loaded;
+	cedar::aho_corasick<trie_int_t> from_file(read_only);
+	found.clear();
+	from_file.scan(text.c_str(), text.length(), visit);
+	std::sort(found.begin(), found.end());
+	EXPECT_EQ(found, find_all(trie, text));
+	std::remove(file.c_str());
+
+	trie_int_t empty;
+	cedar::aho_corasick<trie_int_t> none(empty);
+	EXPECT_EQ(none.scan("abc", visit), 0u);
+}
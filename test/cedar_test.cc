@@ -8,6 +8,15 @@
 
 #include "suffix_test.cc"
 #include "match_and_predict_test.cc"
+#include "concurrent_test.cc"
+#include "sharded_test.cc"
+#include "file_format_test.cc"
+#include "persistent_test.cc"
+#include "memory_test.cc"
+#include "compact_test.cc"
+#include "frozen_test.cc"
+#include "aho_test.cc"
+#include "top_k_test.cc"
 
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
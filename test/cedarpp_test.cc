@@ -9,6 +9,10 @@
 
 #include "suffix_test.cc"
 #include "match_and_predict_test.cc"
+#include "file_format_test.cc"
+#include "compact_test.cc"
+#include "frozen_test.cc"
+#include "tail_test.cc"
 
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,126 @@
+#include <map>
+#include <string>
+#include <unordered_map>
+
+/* records where compaction moves nodes */
+struct compact_moves {
+	std::unordered_map<int, int> to;
+	void operator()(const int from, const int to_) { to[from] = to_; }
+};
+
+/**
+ * After heavy churn, compact_step () cuts blocks off the end of the array
+ * and compact () rebuilds it densely; keys, values and counters survive,
+ * node ids move as the callback says, and the trie stays updatable.
+ */
+TEST(cedar, compact) {
+	typedef cedar::da<int> trie_t;
+	typedef decltype(trie_t::result_triple_type().id) npos_type;
+	trie_t trie;
+	std::map<std::string, int> keys;
+	for (int i = 0; i < 60000; i++) {
+		const std::string key = "k" + std::to_string(i * 7919 % 60007) + "_" + std::to_string(i % 7);
+		trie.update(key.c_str(), key.length(), i);
+		keys[key] = i;
+	}
+	int n = 0;
+	for (auto it = keys.begin(); it != keys.end(); n++) {
+		if (n % 4) {
+			EXPECT_EQ(trie.erase(it->first.c_str()), 0);
+			it = keys.erase(it);
+		} else {
+			++it;
+		}
+	}
+	auto expect_keys = [&keys] (trie_t& trie) {
+		EXPECT_EQ(trie.num_keys(), keys.size());
+		for (const auto& kv : keys) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(kv.first.c_str()), kv.second);
+		}
+		EXPECT_EQ(trie.exactMatchSearch<int>("k1_1"), trie_t::CEDAR_NO_VALUE);
+	};
+
+	/* ids of the nodes of keys, to be followed through compact () */
+	std::vector<npos_type> ids;
+	for (const auto& kv : keys) {
+		npos_type from = 0;
+		size_t pos = 0;
+		trie.traverse(kv.first.c_str(), from, pos);
+		ids.push_back(from);
+	}
+	compact_moves moves;
+	const size_t before = trie.size();
+	EXPECT_GT(trie.compact(moves), 0u);
+	EXPECT_LT(trie.size(), before);
+	EXPECT_EQ(trie.capacity(), trie.size());
+	EXPECT_EQ(trie.stats().num_free_nodes, trie.size() - trie.nonzero_size() - 1);
+	expect_keys(trie);
+	size_t i = 0;
+	for (const auto& kv : keys) {
+		npos_type from = 0;
+		size_t pos = 0;
+		trie.traverse(kv.first.c_str(), from, pos);
+		const int id = static_cast<int>(ids[i++] & 0xffffffff);
+		ASSERT_EQ(moves.to.count(id), 1u);
+		EXPECT_EQ(static_cast<int>(from & 0xffffffff), moves.to[id]);
+	}
+
+	/* and it takes updates and erases as before */
+	for (int i = 0; i < 20000; i++) {
+		const std::string key = "z" + std::to_string(i);
+		trie.update(key.c_str(), key.length(), i);
+		keys[key] = i;
+	}
+	n = 0;
+	for (auto it = keys.begin(); it != keys.end(); n++) {
+		if (n % 3) {
+			EXPECT_EQ(trie.erase(it->first.c_str()), 0);
+			it = keys.erase(it);
+		} else {
+			++it;
+		}
+	}
+	expect_keys(trie);
+
+	const size_t size = trie.size();
+	size_t cut = 0;
+	for (size_t step; (step = trie.compact_step(8)) > 0; ) {
+		cut += step;
+	}
+	EXPECT_GT(cut, 0u);
+	EXPECT_EQ(trie.size(), size - cut * 256);
+	EXPECT_EQ(trie.capacity(), trie.size());
+	expect_keys(trie);
+	trie.update("z0", 2, 1);
+	EXPECT_EQ(trie.exactMatchSearch<int>("z0"), 1);
+}
+
+/**
+ * compact () keeps tracking_node on the nodes it tracked, though their
+ * new ids may be the old ids of other nodes.
+ */
+TEST(cedar, compact_tracking_node) {
+	typedef cedar::da<int, -1, -2, true, 1, 2> trie_t;
+	typedef decltype(trie_t::result_triple_type().id) npos_type;
+	trie_t trie;
+	for (int i = 0; i < 5000; i++) {
+		const std::string key = "key" + std::to_string(i);
+		trie.update(key.c_str(), key.length(), i);
+	}
+	for (int i = 0; i < 5000; i += 2) {
+		const std::string key = "key" + std::to_string(i);
+		EXPECT_EQ(trie.erase(key.c_str()), 0);
+	}
+	auto find = [&trie] (const char* key) {
+		npos_type from = 0;
+		size_t pos = 0;
+		EXPECT_NE(trie.traverse(key, from, pos), trie_t::CEDAR_NO_PATH);
+		return from;
+	};
+	trie.tracking_node[0] = find("key4999");
+	trie.tracking_node[1] = find("key49"); // an inner node
+	EXPECT_GT(trie.compact(), 0u);
+	EXPECT_EQ(trie.tracking_node[0], find("key4999"));
+	EXPECT_EQ(trie.tracking_node[1], find("key49"));
+	EXPECT_EQ(trie.exactMatchSearch<int>("key4999"), 4999);
+}
@@ -0,0 +1,73 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cedar_concurrent.h>
+
+/**
+ * Readers look up keys while a single writer inserts and erases keys.
+ * A key whose update () has returned must be found with its value, and
+ * a key erased before the lookup began must not be found.
+ */
+TEST(cedar, concurrent_readers_single_writer) {
+	typedef cedar::concurrent_da<int> concurrent_trie_t;
+	concurrent_trie_t trie;
+
+	constexpr int kNumKeys = 100000;
+	constexpr int kNumReaders = 4;
+	std::vector<std::string> keys;
+	for (int i = 0; i < kNumKeys; i++) {
+		keys.emplace_back("key" + std::to_string(i * 7919 % kNumKeys));
+	}
+
+	std::atomic<int> inserted{0};  // keys [0, inserted) are in trie
+	std::atomic<int> erased{0};    // odd keys [0, erased) are not;
+	                               // erase (erased) may be running
+	std::atomic<bool> done{false};
+	std::atomic<size_t> failures{0};
+
+	auto reader = [&] (int seed) {
+		for (unsigned n = seed; ! done.load(); n = n * 1103515245 + 12345) {
+			const int e = erased.load();
+			const int i = inserted.load();
+			if (i == 0) {
+				continue;
+			}
+			const int k = static_cast<int>((n >> 8) % i);
+			const int v = trie.exactMatchSearch<int>(keys[k].c_str(), keys[k].length());
+			if (k % 2 == 0 || k > erased.load()) {
+				failures += v != k + 1;
+			} else if (k < e) {
+				failures += v != concurrent_trie_t::CEDAR_NO_VALUE;
+			}
+			/* the writer waits for lookups; lets it run on fewer cores than threads */
+			std::this_thread::yield();
+		}
+	};
+	std::vector<std::thread> readers;
+	for (int r = 0; r < kNumReaders; r++) {
+		readers.emplace_back(reader, r + 1);
+	}
+
+	for (int i = 0; i < kNumKeys; i++) {
+		trie.update(keys[i].c_str(), keys[i].length(), i + 1);
+		inserted.store(i + 1);
+	}
+	for (int i = 1; i < kNumKeys; i += 2) {
+		erased.store(i);
+		EXPECT_EQ(trie.erase(keys[i].c_str(), keys[i].length()), 0);
+		erased.store(i + 1);
+	}
+	done.store(true);
+	for (auto& t : readers) {
+		t.join();
+	}
+
+	EXPECT_EQ(failures.load(), 0u);
+	EXPECT_EQ(trie.num_keys(), static_cast<size_t>(kNumKeys / 2));
+	for (int i = 0; i < kNumKeys; i++) {
+		const int v = trie.exactMatchSearch<int>(keys[i].c_str());
+		EXPECT_EQ(v, i % 2 ? concurrent_trie_t::CEDAR_NO_VALUE : i + 1);
+	}
+}
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * A trie saved as one file loads back by open () and open_with_mmap (),
+ * and a file that does not match the loading trie is refused.
+ */
+TEST(cedar, save_and_open_single_file) {
+	typedef cedar::da<int> trie_t;
+	const std::string file = ::testing::TempDir() + "cedar_file_format_test." + std::to_string(getpid()) + ".trie";
+
+	std::vector<std::string> keys;
+	for (int i = 0; i < 5000; i++) {
+		keys.emplace_back("key" + std::to_string(i * 31 % 5000));
+	}
+	{
+		trie_t trie;
+		for (size_t i = 0; i < keys.size(); i++) {
+			trie.update(keys[i].c_str(), keys[i].length(), i);
+		}
+		ASSERT_EQ(trie.save(file.c_str()), 0);
+	}
+
+	auto expect_all_keys = [&keys] (trie_t& trie) {
+		EXPECT_EQ(trie.num_keys(), keys.size());
+		for (size_t i = 0; i < keys.size(); i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()),
+				static_cast<int>(i));
+		}
+	};
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open(file.c_str()), 0);
+		expect_all_keys(trie);
+		/* a trie read into memory stays updatable */
+		EXPECT_EQ(trie.update("new key", 7, 3), 3);
+		EXPECT_EQ(trie.exactMatchSearch<int>("new key"), 3);
+	}
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open_with_mmap(file.c_str()), 0);
+		expect_all_keys(trie);
+	}
+	{
+		/* a different value_type is refused instead of read as garbage */
+		cedar::da<float> trie;
+		EXPECT_EQ(trie.open(file.c_str()), -1);
+		EXPECT_EQ(trie.open_with_mmap(file.c_str()), -1);
+		EXPECT_EQ(trie.num_keys(), 0u);
+	}
+
+	/* flip a byte of the array section; open () verifies checksums */
+	FILE* fp = std::fopen(file.c_str(), "r+b");
+	ASSERT_NE(fp, nullptr);
+	ASSERT_EQ(std::fseek(fp, cedar::FILE_ALIGN + 100, SEEK_SET), 0);
+	const int c = std::fgetc(fp);
+	ASSERT_EQ(std::fseek(fp, cedar::FILE_ALIGN + 100, SEEK_SET), 0);
+	std::fputc(c ^ 0xff, fp);
+	std::fclose(fp);
+	{
+		trie_t trie;
+		EXPECT_EQ(trie.open(file.c_str()), -1);
+	}
+
+	/* and the header carries its own checksum */
+	fp = std::fopen(file.c_str(), "r+b");
+	ASSERT_NE(fp, nullptr);
+	ASSERT_EQ(std::fseek(fp, offsetof(cedar::file_header, size), SEEK_SET), 0);
+	std::fputc(0x7f, fp);
+	std::fclose(fp);
+	{
+		trie_t trie;
+		EXPECT_EQ(trie.open_with_mmap(file.c_str()), -1);
+	}
+	std::remove(file.c_str());
+}
+
+/**
+ * A mapped trie takes updates; pages are copied on write and sections
+ * move to heap when they grow, leaving the file as saved.
+ */
+TEST(cedar, update_after_open_with_mmap) {
+	typedef cedar::da<int> trie_t;
+	const std::string file = ::testing::TempDir() + "cedar_mmap_update_test." + std::to_string(getpid()) + ".trie";
+
+	std::vector<std::string> keys;
+	for (int i = 0; i < 2000; i++) {
+		keys.emplace_back("base" + std::to_string(i));
+	}
+	{
+		trie_t trie;
+		for (size_t i = 0; i < keys.size(); i++) {
+			trie.update(keys[i].c_str(), keys[i].length(), i);
+		}
+		ASSERT_EQ(trie.save(file.c_str()), 0);
+	}
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open_with_mmap(file.c_str()), 0);
+		/* in place: overwrite values and erase keys */
+		EXPECT_EQ(trie.update("base1", 5, 10), 11);
+		EXPECT_EQ(trie.erase("base2"), 0);
+		EXPECT_EQ(trie.exactMatchSearch<int>("base1"), 11);
+		EXPECT_EQ(trie.exactMatchSearch<int>("base2"), trie_t::CEDAR_NO_VALUE);
+		/* growth: many new keys with long suffixes */
+		for (int i = 0; i < 5000; i++) {
+			const std::string key = "added" + std::to_string(i) + "_with_a_long_suffix";
+			trie.update(key.c_str(), key.length(), i);
+		}
+		for (int i = 0; i < 5000; i++) {
+			const std::string key = "added" + std::to_string(i) + "_with_a_long_suffix";
+			EXPECT_EQ(trie.exactMatchSearch<int>(key.c_str()), i);
+		}
+		for (size_t i = 3; i < keys.size(); i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()),
+				static_cast<int>(i));
+		}
+		EXPECT_EQ(trie.num_keys(), keys.size() - 1 + 5000);
+	}
+	{
+		/* the file is untouched */
+		trie_t trie;
+		ASSERT_EQ(trie.open(file.c_str()), 0);
+		EXPECT_EQ(trie.num_keys(), keys.size());
+		EXPECT_EQ(trie.exactMatchSearch<int>("base1"), 1);
+		EXPECT_EQ(trie.exactMatchSearch<int>("base2"), 2);
+		EXPECT_EQ(trie.exactMatchSearch<int>("added0_with_a_long_suffix"),
+			trie_t::CEDAR_NO_VALUE);
+	}
+	std::remove(file.c_str());
+}
+
+/**
+ * A trie opened without _ninfo and _block serves lookups, rebuilds them
+ * as they were on its first update, and stays updatable.
+ */
+TEST(cedar, open_without_update_info) {
+	typedef cedar::da<int> trie_t;
+	const std::string file = ::testing::TempDir() + "cedar_no_info_test." + std::to_string(getpid()) + ".trie";
+	const std::string restored = ::testing::TempDir() + "cedar_no_info_test." + std::to_string(getpid()) + ".restored";
+
+	std::vector<std::string> keys;
+	for (int i = 0; i < 20000; i++) {
+		keys.emplace_back(std::to_string(i * 7919 % 20000));
+		keys.emplace_back("k" + std::to_string(i % 300) + "_" + std::to_string(i));
+	}
+	{
+		trie_t trie;
+		for (size_t i = 0; i < keys.size(); i++) {
+			trie.update(keys[i].c_str(), keys[i].length(), i);
+		}
+		for (size_t i = 0; i < keys.size(); i += 7) {
+			trie.erase(keys[i].c_str());
+		}
+		ASSERT_EQ(trie.save(file.c_str()), 0);
+	}
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open(file.c_str(), "rb", 0, 0, false), 0);
+		for (size_t i = 0; i < keys.size(); i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()),
+				i % 7 ? static_cast<int>(i) : trie_t::CEDAR_NO_VALUE);
+		}
+		/* a const trie is iterated without _ninfo, which it does not rebuild */
+		std::vector<std::string> live;
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (i % 7) {
+				live.push_back(keys[i]);
+			}
+		}
+		std::sort(live.begin(), live.end());
+		const trie_t& read_only = trie;
+		size_t n = 0;
+		for (const auto& kv : read_only) {
+			ASSERT_LT(n, live.size());
+			EXPECT_EQ(std::string(kv.key, kv.length), live[n++]);
+		}
+		EXPECT_EQ(n, live.size());
+		n = 0;
+		for (auto it = read_only.predict_begin("k12_"); it != read_only.end(); ++it) {
+			EXPECT_EQ(std::string(it->key, 4), "k12_");
+			n++;
+		}
+		EXPECT_EQ(n, static_cast<size_t>(std::count_if(live.begin(), live.end(),
+			[] (const std::string& key) { return key.compare(0, 4, "k12_") == 0; })));
+		trie.restore();
+		ASSERT_EQ(trie.save(restored.c_str()), 0);
+	}
+
+	/* the rebuilt sibling chains are those saved */
+	FILE* fp = std::fopen(file.c_str(), "rb");
+	FILE* rp = std::fopen(restored.c_str(), "rb");
+	ASSERT_NE(fp, nullptr);
+	ASSERT_NE(rp, nullptr);
+	cedar::file_header h, r;
+	ASSERT_EQ(cedar::file_read_header(fileno(fp), 0, h), 0);
+	ASSERT_EQ(cedar::file_read_header(fileno(rp), 0, r), 0);
+	EXPECT_EQ(h.section[cedar::SECTION_NINFO].checksum,
+		r.section[cedar::SECTION_NINFO].checksum);
+	std::fclose(fp);
+	std::fclose(rp);
+
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open(file.c_str(), "rb", 0, 0, false), 0);
+		for (size_t i = 0; i < keys.size(); i += 7) {
+			EXPECT_EQ(trie.update(keys[i].c_str(), keys[i].length(), 1), 1);
+		}
+		EXPECT_EQ(trie.erase(keys[1].c_str()), 0);
+		EXPECT_EQ(trie.num_keys(), keys.size() - 1);
+		for (size_t i = 2; i < keys.size(); i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()),
+				i % 7 ? static_cast<int>(i) : 1);
+		}
+	}
+	{
+		/* erase () is the first to touch them */
+		trie_t trie;
+		ASSERT_EQ(trie.open(file.c_str(), "rb", 0, 0, false), 0);
+		for (size_t i = 1; i < keys.size(); i += 7) {
+			EXPECT_EQ(trie.erase(keys[i].c_str()), 0);
+		}
+		for (size_t i = 1; i < keys.size(); i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()),
+				i % 7 == 1 || i % 7 == 0 ? trie_t::CEDAR_NO_VALUE : static_cast<int>(i));
+		}
+		EXPECT_EQ(trie.update(keys[1].c_str(), keys[1].length(), 1), 1);
+	}
+	{
+		/* and build_sorted () on an empty trie */
+		trie_t trie;
+		ASSERT_EQ(trie.save(file.c_str()), 0);
+		ASSERT_EQ(trie.open(file.c_str(), "rb", 0, 0, false), 0);
+		const char* sorted[] = {"a", "ab", "b"};
+		ASSERT_EQ(trie.build_sorted(3, sorted), 0);
+		EXPECT_EQ(trie.exactMatchSearch<int>("ab"), 1);
+		EXPECT_EQ(trie.num_keys(), 3u);
+	}
+	std::remove(file.c_str());
+	std::remove(restored.c_str());
+}
+
+/* bytes of tails in use, for the tries of cedarpp.h */
+template <typename T>
+auto stats_tail_used(const T& s, int) -> decltype(s.tail_used) { return s.tail_used; }
+template <typename T>
+size_t stats_tail_used(const T&, long) { return 0; }
+
+/**
+ * Counters kept by update () and erase () match those counted from the
+ * array, which is what a trie loaded from a version 1 file does.
+ */
+TEST(cedar, stats_counters) {
+	typedef cedar::da<int> trie_t;
+	const std::string file = ::testing::TempDir() + "cedar_stats_test." + std::to_string(getpid()) + ".trie";
+	const std::string v1 = ::testing::TempDir() + "cedar_stats_test_v1." + std::to_string(getpid()) + ".trie";
+
+	trie_t trie;
+	std::set<std::string> keys;
+	/* numbers are prefixes of one another, which splits tails */
+	for (int i = 0; i < 30000; i++) {
+		const std::string key = std::to_string(i * 7919 % 100003);
+		trie.update(key.c_str(), key.length(), i);
+		trie.update(key.c_str(), key.length(), 1); /* not a new key */
+		keys.insert(key);
+	}
+	for (int i = 0; i < 30000; i += 3) {
+		const std::string key = std::to_string(i * 7919 % 100003);
+		EXPECT_EQ(trie.erase(key.c_str()), 0);
+		EXPECT_EQ(trie.erase(key.c_str()), -1);
+		keys.erase(key);
+	}
+	for (int i = 0; i < 30000; i += 9) { /* back in again */
+		const std::string key = std::to_string(i * 7919 % 100003);
+		trie.update(key.c_str(), key.length(), i);
+		keys.insert(key);
+	}
+	const trie_t::stats_type st = trie.stats();
+	EXPECT_EQ(st.num_keys, keys.size());
+	EXPECT_EQ(trie.num_keys(), keys.size());
+	EXPECT_EQ(st.num_nodes, trie.nonzero_size());
+	EXPECT_EQ(st.size, trie.size());
+	EXPECT_EQ(st.num_free_nodes, st.size - st.num_nodes - 1);
+	EXPECT_EQ(st.num_blocks, st.size / 256);
+	EXPECT_EQ(st.num_blocks_open + st.num_blocks_closed + st.num_blocks_full,
+		st.num_blocks - 1);
+	ASSERT_EQ(trie.save(file.c_str()), 0);
+
+	/* rewrite the header as version 1, which has no counters */
+	std::vector<char> data;
+	FILE* fp = std::fopen(file.c_str(), "rb");
+	ASSERT_NE(fp, nullptr);
+	for (int c; (c = std::fgetc(fp)) != EOF; ) {
+		data.push_back(static_cast<char>(c));
+	}
+	std::fclose(fp);
+	cedar::file_header h;
+	std::memcpy(&h, data.data(), sizeof(h));
+	h.version = 1;
+	h.header_size = cedar::FILE_HEADER_SIZE_V1;
+	h.num_keys = h.num_nodes = h.tail_length = 0;
+	h.checksum = 0;
+	h.checksum = cedar::fnv1a(&h, cedar::FILE_HEADER_SIZE_V1);
+	std::memcpy(data.data(), &h, sizeof(h));
+	fp = std::fopen(v1.c_str(), "wb");
+	ASSERT_NE(fp, nullptr);
+	ASSERT_EQ(std::fwrite(data.data(), 1, data.size(), fp), data.size());
+	std::fclose(fp);
+
+	auto expect_stats = [&st] (const trie_t& trie) {
+		const trie_t::stats_type s = trie.stats();
+		EXPECT_EQ(s.num_keys, st.num_keys);
+		EXPECT_EQ(s.num_nodes, st.num_nodes);
+		EXPECT_EQ(s.num_free_nodes, st.num_free_nodes);
+		EXPECT_EQ(s.size, st.size);
+#if (USE_FAST_LOAD == 1)
+		EXPECT_EQ(s.num_blocks_open, st.num_blocks_open);
+		EXPECT_EQ(s.num_blocks_closed, st.num_blocks_closed);
+		EXPECT_EQ(s.num_blocks_full, st.num_blocks_full);
+#else
+		/* without _block, blocks are counted as restore () lists them */
+		EXPECT_EQ(s.num_blocks_open + s.num_blocks_closed + s.num_blocks_full,
+			s.num_blocks - 1);
+#endif
+		EXPECT_EQ(stats_tail_used(s, 0), stats_tail_used(st, 0));
+	};
+	for (const std::string& fn : {file, v1}) {
+		trie_t loaded;
+		ASSERT_EQ(loaded.open(fn.c_str()), 0);
+		expect_stats(loaded);
+		ASSERT_EQ(loaded.open_with_mmap(fn.c_str()), 0);
+		expect_stats(loaded);
+#if (USE_FAST_LOAD == 0)
+		const trie_t::stats_type s = loaded.stats();
+		loaded.restore();
+		EXPECT_EQ(loaded.stats().num_blocks_open, s.num_blocks_open);
+		EXPECT_EQ(loaded.stats().num_blocks_closed, s.num_blocks_closed);
+		EXPECT_EQ(loaded.stats().num_blocks_full, s.num_blocks_full);
+#endif
+		/* counters go on from where they were loaded */
+		loaded.update("new key", 7, 1);
+		EXPECT_EQ(loaded.num_keys(), keys.size() + 1);
+	}
+
+	trie_t sorted;
+	std::vector<const char*> sorted_keys;
+	for (const std::string& key : keys) {
+		sorted_keys.push_back(key.c_str());
+	}
+	ASSERT_EQ(sorted.build_sorted(sorted_keys.size(), sorted_keys.data()), 0);
+	EXPECT_EQ(sorted.num_keys(), keys.size());
+	std::remove(file.c_str());
+	std::remove(v1.c_str());
+}
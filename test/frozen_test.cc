@@ -0,0 +1,240 @@
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/* the frozen trie answers as "trie" with "keys" does */
+template <typename trie_t, typename frozen_t>
+void expect_frozen_same(trie_t& trie, const std::map<std::string, int>& keys,
+		const frozen_t& frozen) {
+	EXPECT_EQ(frozen.num_keys(), keys.size());
+	for (const auto& kv : keys) {
+		EXPECT_EQ(frozen.template exactMatchSearch<int>(kv.first.c_str()), kv.second);
+		const std::string miss = kv.first + "#";
+		EXPECT_EQ(frozen.template exactMatchSearch<int>(miss.c_str()),
+			trie_t::CEDAR_NO_VALUE);
+	}
+	EXPECT_EQ(frozen.template exactMatchSearch<int>("a\0b", 3), trie_t::CEDAR_NO_VALUE);
+
+	const size_t result_len = 64;
+	typename trie_t::result_pair_type r[result_len];
+	typename frozen_t::result_pair_type s[result_len];
+	std::vector<std::string> queries = {"abcdefghij", "k123456789", "k29", "zzz", ""};
+	size_t i = 0;
+	for (const auto& kv : keys) {
+		if (i++ % 97 == 0) {
+			queries.push_back(kv.first + "xyz");
+		}
+	}
+	for (const auto& key : queries) {
+		const size_t n = trie.commonPrefixSearch(key.c_str(), r, result_len);
+		ASSERT_EQ(frozen.commonPrefixSearch(key.c_str(), s, result_len), n);
+		for (size_t i = 0; i < n && i < result_len; i++) {
+			EXPECT_EQ(s[i].value, r[i].value);
+			EXPECT_EQ(s[i].length, r[i].length);
+		}
+	}
+
+	std::vector<typename trie_t::result_triple_type> t(keys.size());
+	std::vector<typename frozen_t::result_triple_type> u(keys.size());
+	for (const char* key : {"k1", "k2999", "a", "b", "", "x", "re", "walk"}) {
+		const size_t n = trie.commonPrefixPredict(key, t.data(), t.size());
+		ASSERT_EQ(frozen.commonPrefixPredict(key, u.data(), u.size()), n);
+		for (size_t i = 0; i < n; i++) {
+			EXPECT_EQ(u[i].value, t[i].value);
+			EXPECT_EQ(u[i].length, t[i].length);
+			/* ids are where keys end, and resume searches */
+			EXPECT_EQ(frozen.template exactMatchSearch<int>("", 0, u[i].id), u[i].value);
+		}
+		/* and visitors see the same */
+		size_t j = 0;
+		EXPECT_EQ(frozen.commonPrefixPredict(key, std::strlen(key),
+			[&u, &j] (int value, size_t length, size_t id) {
+				EXPECT_EQ(value, u[j].value);
+				EXPECT_EQ(length, u[j].length);
+				EXPECT_EQ(id, u[j].id);
+				return ++j < 3;
+			}), std::min<size_t>(n, 3));
+	}
+
+	/* traverse () one byte at a time */
+	i = 0;
+	for (const auto& kv : keys) {
+		if (i++ % 101) {
+			continue;
+		}
+		const std::string key = kv.first + "s";
+		size_t from = 0;
+		for (size_t pos = 0; pos < key.length(); ) {
+			const int v = frozen.traverse(key.c_str(), from, pos, pos + 1);
+			if (v == trie_t::CEDAR_NO_PATH) {
+				break;
+			}
+			EXPECT_EQ(v, trie.template exactMatchSearch<int>(key.c_str(), pos));
+		}
+	}
+	size_t pos = 0;
+	size_t from = 0;
+	EXPECT_EQ(frozen.traverse("\x01\x02", from, pos), trie_t::CEDAR_NO_PATH);
+	EXPECT_EQ(pos, 0u);
+}
+
+/**
+ * A frozen trie answers exactMatchSearch (), commonPrefixSearch (),
+ * commonPrefixPredict () and traverse () as the trie it is frozen from,
+ * in less space, and loads back from a file by open () and
+ * open_with_mmap ().
+ */
+TEST(cedar, freeze) {
+	typedef cedar::da<int> trie_t;
+	typedef trie_t::frozen_type frozen_t;
+	const std::string file = ::testing::TempDir() + "cedar_frozen_test." + std::to_string(getpid()) + ".trie";
+
+	trie_t trie;
+	std::map<std::string, int> keys;
+	for (int i = 0; i < 30000; i++) {
+		const std::string key = "k" + std::to_string(i * 7919 % 30011);
+		keys[key] = i;
+		/* and some of its prefixes */
+		keys[key.substr(0, 1 + i % key.length())] = i;
+	}
+	keys["a"] = 1;
+	keys["ab"] = 2;
+	keys["abcdefgh"] = 3;
+	keys["b\xff\x80"] = 2147483647;
+	for (const auto& kv : keys) {
+		trie.update(kv.first.c_str(), kv.first.length(), kv.second);
+	}
+
+	auto expect_same = [&trie, &keys] (const frozen_t& frozen) {
+		expect_frozen_same(trie, keys, frozen);
+	};
+
+	{
+		frozen_t frozen;
+		ASSERT_EQ(trie.freeze(frozen), 0);
+		expect_same(frozen);
+		/* 4-byte units, and no _ninfo, _block or tail */
+		EXPECT_LT(frozen.total_size(), trie.total_size());
+		ASSERT_EQ(frozen.save(file.c_str()), 0);
+	}
+	{
+		frozen_t frozen;
+		ASSERT_EQ(frozen.open(file.c_str()), 0);
+		expect_same(frozen);
+	}
+	{
+		frozen_t frozen;
+		ASSERT_EQ(frozen.open_with_mmap(file.c_str()), 0);
+		expect_same(frozen);
+		/* the trie itself is not frozen */
+		EXPECT_EQ(trie.update("new key", 7, 5), 5);
+		EXPECT_EQ(frozen.exactMatchSearch<int>("new key"), trie_t::CEDAR_NO_VALUE);
+	}
+	{
+		/* neither kind of trie loads the file of the other */
+		trie_t other;
+		EXPECT_EQ(other.open(file.c_str()), -1);
+		ASSERT_EQ(trie.save(file.c_str()), 0);
+		frozen_t frozen;
+		EXPECT_EQ(frozen.open(file.c_str()), -1);
+		EXPECT_EQ(frozen.open_with_mmap(file.c_str()), -1);
+	}
+	std::remove(file.c_str());
+
+	/* values take 31 bits */
+	trie.update("negative", 8, -5);
+	frozen_t frozen;
+	EXPECT_EQ(trie.freeze(frozen), -1);
+
+	/* an empty trie freezes to one block */
+	trie_t empty;
+	ASSERT_EQ(empty.freeze(frozen), 0);
+	EXPECT_EQ(frozen.num_keys(), 0u);
+	EXPECT_EQ(frozen.exactMatchSearch<int>("a"), trie_t::CEDAR_NO_VALUE);
+	frozen_t::result_triple_type v[1];
+	EXPECT_EQ(frozen.commonPrefixPredict("", v, 1), 0u);
+}
+
+/**
+ * freeze (t, true) merges equal subtrees, such as those below stems that
+ * take the same suffixes, and still returns the value of each key.
+ */
+TEST(cedar, freeze_minimized) {
+	typedef cedar::da<int> trie_t;
+	typedef trie_t::frozen_type frozen_t;
+	const std::string file = ::testing::TempDir() + "cedar_frozen_minimized_test." + std::to_string(getpid()) + ".trie";
+	const char* suffixes[] = {"", "s", "ed", "ing", "er", "ers", "ation", "ations", "ly", "ness"};
+
+	trie_t trie;
+	std::map<std::string, int> keys;
+	/* enough keys for ranks of 2^15 or more */
+	for (int i = 0; i < 4000; i++) {
+		const std::string stem = "walk" + std::to_string(i * 7919 % 4001);
+		for (const char* suffix : suffixes) {
+			keys[stem + suffix] = static_cast<int>(keys.size());
+		}
+		keys["re" + stem] = 100000 + i;
+	}
+	for (const auto& kv : keys) {
+		trie.update(kv.first.c_str(), kv.first.length(), kv.second);
+	}
+
+	frozen_t plain;
+#if (USE_REDUCED_TRIE == 0)
+	/* values of any sign; a reduced trie keeps non-negative ones only */
+	ASSERT_EQ(trie.update("negative", 8, -5), -5);
+	EXPECT_EQ(trie.freeze(plain), -1);
+	keys["negative"] = -5;
+#endif
+	{
+		frozen_t frozen;
+		ASSERT_EQ(trie.freeze(frozen, true), 0);
+		EXPECT_TRUE(frozen.minimized());
+		expect_frozen_same(trie, keys, frozen);
+		ASSERT_EQ(frozen.save(file.c_str()), 0);
+
+#if (USE_REDUCED_TRIE == 0)
+		trie.erase("negative");
+		keys.erase("negative");
+#endif
+		ASSERT_EQ(trie.freeze(plain), 0);
+		ASSERT_EQ(trie.freeze(frozen, true), 0);
+		/* every stem shares one subtree of suffixes */
+		EXPECT_LT(frozen.size() * 4, plain.size());
+		EXPECT_LT(frozen.total_size() * 2, plain.total_size());
+	}
+#if (USE_REDUCED_TRIE == 0)
+	trie.update("negative", 8, -5);
+	keys["negative"] = -5;
+#endif
+	{
+		frozen_t frozen;
+		ASSERT_EQ(frozen.open(file.c_str()), 0);
+		EXPECT_TRUE(frozen.minimized());
+		expect_frozen_same(trie, keys, frozen);
+	}
+	{
+		frozen_t frozen;
+		ASSERT_EQ(frozen.open_with_mmap(file.c_str()), 0);
+		expect_frozen_same(trie, keys, frozen);
+	}
+	std::remove(file.c_str());
+
+	/* an unordered trie is sorted first */
+	cedar::da<int, -1, -2, false> unordered;
+	for (const auto& kv : keys) {
+		unordered.update(kv.first.c_str(), kv.first.length(), kv.second);
+	}
+	frozen_t frozen;
+	ASSERT_EQ(unordered.freeze(frozen, true), 0);
+	expect_frozen_same(trie, keys, frozen);
+
+	trie_t empty;
+	ASSERT_EQ(empty.freeze(frozen, true), 0);
+	EXPECT_EQ(frozen.num_keys(), 0u);
+	EXPECT_EQ(frozen.exactMatchSearch<int>(""), trie_t::CEDAR_NO_VALUE);
+	frozen_t::result_triple_type v[1];
+	EXPECT_EQ(frozen.commonPrefixPredict("", v, 1), 0u);
+}
@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <functional>
+#include <map>
 #include <set>
+#include <unistd.h>
 
 typedef cedar::da <int> trie_int_t;
 
@@ -174,3 +177,563 @@ TEST(cedarpp, match_and_predict) {
 		EXPECT_EQ(num_res, 0);
 	}
 }
+
+/**
+ * batched lookups must agree with one-at-a-time lookups,
+ * for hits, misses and keys ending on inner nodes
+ */
+TEST(cedar, batch_exact_match) {
+	trie_int_t trie;
+
+	std::vector<std::string> keys;
+	for (char a = 'a'; a <= 'z'; a++) {
+		for (char b = 'a'; b <= 'z'; b += 3) {
+			std::string key{a, b};
+			for (size_t n = 0; n < static_cast<size_t>(a % 7); n++) {
+				key += static_cast<char>('a' + n);
+			}
+			keys.emplace_back(key);
+		}
+	}
+	for (size_t i = 0; i < keys.size(); i += 2) {
+		trie.update(keys[i].c_str(), keys[i].length(), i);
+	}
+	// probe inserted keys, missing keys, and prefixes of inserted keys
+	keys.emplace_back("zzzzzzzzz");
+	keys.emplace_back("a");
+	keys.emplace_back("ab");
+
+	std::vector<const char*> queries;
+	std::vector<size_t> lengths;
+	for (auto& key : keys) {
+		queries.emplace_back(key.c_str());
+		lengths.emplace_back(key.length());
+	}
+
+	std::vector<trie_int_t::result_triple_type> batched(keys.size());
+	trie.exactMatchSearch(queries.data(), batched.data(), queries.size(),
+			lengths.data());
+
+	std::vector<int> values(keys.size());
+	trie.exactMatchSearch(queries.data(), values.data(), queries.size());
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		trie_int_t::result_triple_type r;
+		r = trie.exactMatchSearch<decltype(r)>(keys[i].c_str(), keys[i].length());
+		EXPECT_EQ(batched[i].value, r.value);
+		EXPECT_EQ(batched[i].length, r.length);
+		EXPECT_EQ(values[i], r.value);
+		if (i % 2 == 0 && i < keys.size() - 3) {
+			EXPECT_EQ(r.value, static_cast<int>(i));
+		}
+	}
+}
+
+TEST(cedar, build_sorted) {
+	std::vector<std::string> keys;
+	for (int i = 0; i < 20000; i++) {
+		keys.emplace_back(std::to_string(i * 7919 % 20000));
+		keys.emplace_back("k" + std::to_string(i % 300) + "_" + std::to_string(i));
+	}
+	keys.emplace_back("k");
+	keys.emplace_back("\xff\xfe");
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<const char*> key_ptrs;
+	std::vector<int> values;
+	for (size_t i = 0; i < keys.size(); i++) {
+		key_ptrs.emplace_back(keys[i].c_str());
+		values.emplace_back(static_cast<int>(i) * 3);
+	}
+
+	trie_int_t trie;
+	ASSERT_EQ(trie.build_sorted(keys.size(), key_ptrs.data(), nullptr,
+			values.data()), 0);
+	EXPECT_EQ(trie.num_keys(), keys.size());
+	for (size_t i = 0; i < keys.size(); i++) {
+		EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()),
+			static_cast<int>(i) * 3);
+	}
+
+	/* predict enumerates keys in order */
+	std::vector<trie_int_t::result_triple_type> result(keys.size());
+	ASSERT_EQ(trie.commonPrefixPredict("", result.data(), result.size()),
+		keys.size());
+	for (size_t i = 0; i < keys.size(); i++) {
+		EXPECT_EQ(result[i].value, static_cast<int>(i) * 3);
+		EXPECT_EQ(result[i].length, keys[i].length());
+	}
+
+	/* the trie stays updatable */
+	EXPECT_EQ(trie.update("k1_", 3, 5), 5);
+	EXPECT_EQ(trie.update("k1_x", 4, 1), 1);
+	EXPECT_EQ(trie.update("k1_1", 4, 1), static_cast<int>(
+		(std::lower_bound(keys.begin(), keys.end(), "k1_1") - keys.begin()) * 3 + 1));
+	EXPECT_EQ(trie.erase("k"), 0);
+	EXPECT_EQ(trie.exactMatchSearch<int>("k"), trie_int_t::CEDAR_NO_VALUE);
+	EXPECT_EQ(trie.exactMatchSearch<int>("k1_"), 5);
+	EXPECT_EQ(trie.exactMatchSearch<int>("k1_x"), 1);
+	EXPECT_EQ(trie.num_keys(), keys.size() + 1);
+
+	/* unsorted or duplicate keys are rejected */
+	trie_int_t unsorted;
+	const char* bad[] = {"b", "a"};
+	EXPECT_EQ(unsorted.build_sorted(2, bad), -1);
+	const char* dup[] = {"a", "a"};
+	EXPECT_EQ(unsorted.build_sorted(2, dup), -1);
+}
+
+/**
+ * Iterators enumerate every key with its value in order, and
+ * predict_begin () the keys that start with a prefix.
+ */
+TEST(cedar, const_iterator) {
+	trie_int_t trie;
+	EXPECT_TRUE(trie.begin() == trie.end());
+
+	std::map<std::string, int> keys;
+	for (int i = 0; i < 3000; i++) {
+		keys[std::to_string(i * 7919 % 3000)] = i;
+		keys["pre" + std::to_string(i % 50) + "fix_with_a_long_tail" + std::to_string(i)] = 3000 + i;
+	}
+	keys["p"] = 7;
+	for (const auto& kv : keys) {
+		trie.update(kv.first.c_str(), kv.first.length(), kv.second);
+	}
+
+	auto it = keys.begin();
+	for (const auto& kv : trie) {
+		ASSERT_NE(it, keys.end());
+		EXPECT_EQ(std::string(kv.key, kv.length), it->first);
+		EXPECT_EQ(std::strlen(kv.key), kv.length);
+		EXPECT_EQ(kv.value, it->second);
+		++it;
+	}
+	EXPECT_EQ(it, keys.end());
+
+	for (const char* prefix : {"pre1", "pre12fix_with", "pre12fix_with_a_long_tail1012", "p", "12", "x", ""}) {
+		std::vector<std::string> expected, found;
+		for (const auto& kv : keys) {
+			if (kv.first.compare(0, std::strlen(prefix), prefix) == 0) {
+				expected.push_back(kv.first);
+			}
+		}
+		for (auto i = trie.predict_begin(prefix); i != trie.end(); i++) {
+			found.emplace_back(i->key, i->length);
+			/* a copy keeps its own key */
+			const trie_int_t::const_iterator copy = i;
+			EXPECT_EQ(found.back(), copy->key);
+		}
+		EXPECT_EQ(found, expected) << prefix;
+	}
+}
+
+/**
+ * Keys of random bytes give nodes of up to 255 children, whose siblings
+ * are relocated again and again; keys survive erasing, compact_step (),
+ * saving and reloading in between.
+ */
+TEST(cedar, high_fanout_relocation) {
+	trie_int_t trie;
+	std::map<std::string, int> keys;
+	unsigned int x = 12345;
+	for (int i = 0; i < 40000; i++) {
+		std::string key(3, '\0');
+		for (auto& c : key) {
+			x = x * 1103515245 + 12345;
+			c = static_cast<char>(1 + (x >> 16) % 255);
+		}
+		if (keys.emplace(key, i).second) { /* update () adds to a value */
+			trie.update(key.c_str(), key.length(), i);
+		}
+	}
+	int n = 0;
+	for (auto it = keys.begin(); it != keys.end(); n++) {
+		if (n % 3 == 0) {
+			EXPECT_EQ(trie.erase(it->first.c_str(), it->first.length()), 0);
+			it = keys.erase(it);
+		} else {
+			++it;
+		}
+	}
+	trie.compact_step(4);
+	const std::string file = ::testing::TempDir() + "cedar_fanout_test." + std::to_string(getpid()) + ".trie";
+	ASSERT_EQ(trie.save(file.c_str()), 0);
+	trie_int_t loaded;
+	ASSERT_EQ(loaded.open(file.c_str()), 0);
+	/* erased nodes are empty until the file is read back over them */
+	n = 0;
+	for (auto it = keys.begin(); it != keys.end(); ++it, n++) {
+		if (n % 7 == 1) {
+			EXPECT_EQ(trie.erase(it->first.c_str(), it->first.length()), 0);
+		}
+	}
+	ASSERT_EQ(trie.open(file.c_str()), 0);
+	std::remove(file.c_str());
+	for (int i = 0; i < 20000; i++) {
+		std::string key(3, '\0');
+		for (auto& c : key) {
+			x = x * 1103515245 + 12345;
+			c = static_cast<char>(1 + (x >> 16) % 255);
+		}
+		key += static_cast<char>('a' + i % 26);
+		if (keys.emplace(key, i + 3).second) {
+			trie.update(key.c_str(), key.length(), i + 3);
+			loaded.update(key.c_str(), key.length(), i + 3);
+		}
+	}
+	for (trie_int_t* t : {&trie, &loaded}) {
+		EXPECT_EQ(t->num_keys(), keys.size());
+		for (const auto& kv : keys) {
+			EXPECT_EQ(t->exactMatchSearch<int>(kv.first.c_str(), kv.first.length()), kv.second);
+		}
+	}
+}
+
+/**
+ * longestPrefixSearch () finds the last key commonPrefixSearch () does, and
+ * a matcher fed the same query in chunks of any size finds it too.
+ */
+TEST(cedar, longest_prefix_match) {
+	trie_int_t trie;
+	std::vector<std::string> keys;
+	for (int i = 0; i < 2000; i++) {
+		const std::string key = "/path/" + std::to_string(i * 7919 % 2000);
+		keys.push_back(key);
+		keys.push_back(key + "/index_with_a_long_tail.html");
+		if (i % 3 == 0) {
+			keys.push_back(key.substr(0, 7 + i % 3));
+		}
+	}
+	keys.push_back("/");
+	for (size_t i = 0; i < keys.size(); i++) {
+		trie.update(keys[i].c_str(), keys[i].length(), static_cast<int>(i));
+	}
+
+	std::vector<std::string> queries = {"", "x", "/", "//", "/path", "/path/"};
+	for (size_t i = 0; i < keys.size(); i += 7) {
+		queries.push_back(keys[i]);
+		queries.push_back(keys[i] + "/index_with_a_long_tail.html?q=1");
+		queries.push_back(keys[i] + "/index_with_a_long");
+		queries.push_back(keys[i].substr(0, keys[i].length() - 1));
+	}
+	trie_int_t::result_triple_type r[64];
+	char key[256];
+	for (const auto& query : queries) {
+		const size_t n = trie.commonPrefixSearch(query.c_str(), r, 64, query.length());
+		ASSERT_LT(n, 64u);
+		const int value = n ? r[n - 1].value : trie_int_t::CEDAR_NO_VALUE;
+		const size_t length = n ? r[n - 1].length : 0;
+
+		const auto l = trie.longestPrefixSearch<trie_int_t::result_triple_type>(
+			query.c_str(), query.length());
+		EXPECT_EQ(l.value, value) << query;
+		EXPECT_EQ(l.length, length) << query;
+		EXPECT_EQ(trie.longestPrefixSearch<int>(query.c_str(), query.length()), value);
+		if (n) {
+			trie.suffix(key, l.length, l.id);
+			EXPECT_EQ(std::string(key), query.substr(0, length));
+		}
+
+		for (size_t chunk : {1, 2, 5, 64}) {
+			trie_int_t::matcher m(trie);
+			for (size_t pos = 0; pos < query.length(); pos += chunk) {
+				const size_t len = std::min(chunk, query.length() - pos);
+				if (! m.feed(query.c_str() + pos, len)) {
+					break;
+				}
+			}
+			EXPECT_EQ(m.found(), n > 0);
+			EXPECT_EQ(m.value(), value) << query << " in chunks of " << chunk;
+			EXPECT_EQ(m.length(), length) << query << " in chunks of " << chunk;
+			EXPECT_EQ(m.id(), l.id);
+			EXPECT_LE(m.consumed(), query.length());
+		}
+	}
+
+	/* no key has a NUL byte */
+	const std::string nul("/path/1\0/index", 14);
+	EXPECT_EQ(trie.longestPrefixSearch<int>(nul.c_str(), nul.length()),
+		trie.exactMatchSearch<int>("/path/1"));
+	const std::string nul_tail = keys[1] + std::string(1, '\0') + "x";
+	EXPECT_EQ(trie.longestPrefixSearch<int>(nul_tail.c_str(), nul_tail.length()), 1);
+
+	/* a matcher stops once no longer key can match */
+	trie_int_t::matcher m(trie);
+	EXPECT_TRUE(m.feed("/pa"));
+	EXPECT_TRUE(m.feed("th/1"));
+	EXPECT_EQ(m.value(), trie.exactMatchSearch<int>("/path/1"));
+	EXPECT_FALSE(m.feed("x/"));
+	EXPECT_FALSE(m.alive());
+	EXPECT_FALSE(m.feed("/"));
+	EXPECT_EQ(m.consumed(), 7u);
+	EXPECT_EQ(m.length(), 7u);
+	m.reset();
+	EXPECT_FALSE(m.found());
+	EXPECT_TRUE(m.feed("/"));
+	EXPECT_EQ(m.length(), 1u);
+}
+
+/**
+ * Visitors see the matches that commonPrefixSearch () and
+ * commonPrefixPredict () store, in the same order, and stop them early by
+ * returning false.
+ */
+TEST(cedar, prefix_visitors) {
+	trie_int_t trie;
+	for (int i = 0; i < 5000; i++) {
+		const std::string key = std::to_string(i * 7919 % 5000);
+		trie.update(key.c_str(), key.length(), i);
+		const std::string longer = key + "_with_a_long_tail";
+		trie.update(longer.c_str(), longer.length(), 5000 + i);
+	}
+
+	std::vector<trie_int_t::result_triple_type> r(trie.num_keys());
+	for (const char* key : {"1234_with_a_long_tail", "123", "1", "", "9", "x", "4999_with"}) {
+		const size_t len = std::strlen(key);
+		std::vector<trie_int_t::result_triple_type> found;
+		auto visit = [&found] (int value, size_t length, decltype(r[0].id) id) {
+			found.push_back({value, length, id});
+			return true;
+		};
+
+		size_t n = trie.commonPrefixSearch(key, r.data(), r.size());
+		ASSERT_EQ(trie.commonPrefixSearch(key, visit), n);
+		ASSERT_EQ(found.size(), n);
+		for (size_t i = 0; i < n; i++) {
+			EXPECT_EQ(found[i].value, r[i].value);
+			EXPECT_EQ(found[i].length, r[i].length);
+			EXPECT_EQ(found[i].id, r[i].id);
+		}
+
+		found.clear();
+		n = trie.commonPrefixPredict(key, r.data(), r.size());
+		ASSERT_EQ(trie.commonPrefixPredict(key, len, visit), n);
+		ASSERT_EQ(found.size(), n);
+		for (size_t i = 0; i < n; i++) {
+			EXPECT_EQ(found[i].value, r[i].value);
+			EXPECT_EQ(found[i].length, r[i].length);
+			EXPECT_EQ(found[i].id, r[i].id);
+		}
+
+		/* stop at the second match */
+		size_t calls = 0;
+		auto two = [&calls] (int, size_t, decltype(r[0].id)) { return ++calls < 2; };
+		EXPECT_EQ(trie.commonPrefixPredict(key, len, two), std::min<size_t>(n, 2));
+		EXPECT_EQ(calls, std::min<size_t>(n, 2));
+	}
+
+	/* a tokenizer: the longest key at each position, with no result array */
+	const std::string text = "12_with_a_long_tail345x";
+	std::vector<size_t> tokens;
+	for (size_t pos = 0; pos < text.length(); ) {
+		size_t longest = 1;
+		trie.commonPrefixSearch(text.c_str() + pos, text.length() - pos,
+			[&longest] (int, size_t length, decltype(r[0].id)) {
+				longest = length;
+				return true;
+			});
+		tokens.push_back(longest);
+		pos += longest;
+	}
+	EXPECT_EQ(tokens, (std::vector<size_t>{19, 3, 1}));
+}
+
+/**
+ * predictPage () returns the completions of commonPrefixPredict () a page
+ * at a time, and tells a cursor that updates of its own path have
+ * invalidated.
+ */
+TEST(cedar, predict_page) {
+	trie_int_t trie;
+	for (int i = 0; i < 5000; i++) {
+		const std::string key = "p" + std::to_string(i * 7919 % 5003);
+		trie.update(key.c_str(), key.length(), i);
+		/* long suffixes, which cedarpp.h keeps in tails */
+		const std::string longer = key + "_with_a_long_tail";
+		trie.update(longer.c_str(), longer.length(), 5000 + i);
+	}
+
+	std::vector<trie_int_t::result_triple_type> all(20000);
+	for (const char* key : {"", "p", "p1", "p12", "p123", "p1234", "p1234_with", "q"}) {
+		const size_t n = trie.commonPrefixPredict(key, all.data(), all.size());
+		for (size_t limit : {1, 7, 100}) {
+			std::vector<trie_int_t::result_triple_type> page(limit);
+			trie_int_t::cursor cur;
+			size_t i = 0;
+			int m;
+			while ((m = trie.predictPage(key, cur, page.data(), limit)) > 0) {
+				ASSERT_LE(static_cast<size_t>(m), limit);
+				for (int j = 0; j < m; j++, i++) {
+					ASSERT_LT(i, n);
+					EXPECT_EQ(page[j].value, all[i].value);
+					EXPECT_EQ(page[j].length, all[i].length);
+					EXPECT_EQ(page[j].id, all[i].id);
+				}
+				/* a cursor is plain bytes */
+				char token[sizeof(cur)];
+				std::memcpy(token, &cur, sizeof(cur));
+				std::memcpy(&cur, token, sizeof(cur));
+			}
+			EXPECT_EQ(m, 0);
+			EXPECT_EQ(i, n) << key << " " << limit;
+			EXPECT_TRUE(cur.end());
+			EXPECT_EQ(trie.predictPage(key, cur, page.data(), limit), 0);
+		}
+	}
+
+	trie_int_t::result_triple_type page[10];
+	trie_int_t::cursor cur;
+	ASSERT_EQ(trie.predictPage("p1", cur, page, 10), 10);
+	/* of another prefix */
+	trie_int_t::cursor other = cur;
+	EXPECT_EQ(trie.predictPage("p2", other, page, 10), -1);
+	/* values change in place */
+	trie.update("p1", 2, 5);
+	ASSERT_EQ(trie.predictPage("p1", cur, page, 10), 10);
+	/* erasing keys outside the path to the last completion does not
+	   invalidate the cursor */
+	std::vector<trie_int_t::result_triple_type> p1(30);
+	ASSERT_GE(trie.commonPrefixPredict("p1", p1.data(), p1.size()), p1.size());
+	trie.erase("p2");
+	trie.erase("p3_with_a_long_tail");
+	ASSERT_EQ(trie.predictPage("p1", cur, page, 10), 10);
+	for (int j = 0; j < 10; j++) {
+		EXPECT_EQ(page[j].value, p1[20 + j].value);
+	}
+	/* erasing the last completion does */
+	char erased[64] = "p1";
+	trie.suffix(erased + 2, page[9].length, page[9].id);
+	ASSERT_EQ(trie.erase(erased), 0);
+	EXPECT_EQ(trie.predictPage("p1", cur, page, 10), -1);
+	/* and a new cursor starts over */
+	cur = trie_int_t::cursor();
+	EXPECT_EQ(trie.predictPage("p1", cur, page, 10), 10);
+	EXPECT_EQ(page[0].value, trie.exactMatchSearch<int>("p1"));
+
+	/* a key inserted between pages shows up on a later page if it sorts
+	   after the last completion, and moves that completion's node only
+	   now and then, which invalidates the cursor */
+	trie_int_t grow;
+	std::vector<std::string> words;
+	std::map<std::string, int> sorted;
+	unsigned int x = 1;
+	auto add_word = [&] () {
+		std::string w(5, 'a');
+		for (auto& c : w) {
+			x = x * 1103515245 + 12345;
+			c = static_cast<char>('a' + (x >> 16) % 26);
+		}
+		if (sorted.emplace(w, static_cast<int>(words.size())).second) {
+			grow.update(w.c_str(), w.length(), static_cast<int>(words.size()));
+			words.push_back(w);
+		}
+	};
+	for (int i = 0; i < 3000; i++) {
+		add_word();
+	}
+	size_t resumed = 0, invalidated = 0;
+	cur = trie_int_t::cursor();
+	std::string last;
+	for (int step = 0; step < 2000 && ! cur.end(); step++) {
+		trie_int_t::result_triple_type next[16];
+		const bool fresh = ! cur.path;
+		const int m = grow.predictPage("", cur, next, 16);
+		if (m < 0) {
+			invalidated++;
+			cur = trie_int_t::cursor();
+			continue;
+		}
+		resumed += ! fresh;
+		auto it = fresh ? sorted.begin() : sorted.upper_bound(last);
+		for (int j = 0; j < m; j++, ++it) {
+			ASSERT_NE(it, sorted.end());
+			ASSERT_EQ(next[j].value, it->second) << step << " " << j;
+		}
+		EXPECT_EQ(m, static_cast<int>(std::min<size_t>(16, std::distance(it, sorted.end()) + m)));
+		if (m) {
+			last = words[next[m - 1].value];
+		}
+		add_word();
+	}
+	EXPECT_GT(resumed, 10 * invalidated);
+}
+
+/* Levenshtein distance of "a" and "b", for checking fuzzySearch () */
+size_t edit_distance(const std::string& a, const std::string& b) {
+	std::vector<size_t> row(b.length() + 1);
+	for (size_t j = 0; j <= b.length(); j++) {
+		row[j] = j;
+	}
+	for (size_t i = 1; i <= a.length(); i++) {
+		size_t diag = row[0];
+		row[0] = i;
+		for (size_t j = 1; j <= b.length(); j++) {
+			const size_t up = row[j];
+			row[j] = std::min(std::min(row[j], row[j - 1]) + 1, diag + (a[i - 1] != b[j - 1]));
+			diag = up;
+		}
+	}
+	return row[b.length()];
+}
+
+/**
+ * fuzzySearch () finds every key within the bound, with its distance,
+ * including keys whose last bytes are in tails of cedarpp.h.
+ */
+TEST(cedar, fuzzy_search) {
+	trie_int_t trie;
+	std::map<std::string, int> keys;
+	for (int i = 0; i < 3000; i++) {
+		std::string key = std::to_string(i * 7919 % 3001);
+		key = key + std::string(1, 'a' + i % 5) + key.substr(0, i % 4);
+		keys[key] = i;
+	}
+	keys["x"] = 1;
+	keys["xy"] = 2;
+	keys["a_key_with_a_long_tail"] = 3;
+	for (const auto& kv : keys) {
+		trie.update(kv.first.c_str(), kv.first.length(), kv.second);
+	}
+
+	struct match {
+		std::string key;
+		int value;
+		size_t distance;
+		bool operator==(const match& m) const {
+			return key == m.key && value == m.value && distance == m.distance;
+		}
+	};
+	for (const char* query : {"", "x", "12a1", "123b12", "2999e29", "99a", "a_key_with_a_lung_tale",
+			"a_key_with_a_long_tailxx", "zzzz"}) {
+		for (size_t max_edits : {0, 1, 2, 3}) {
+			std::vector<match> want;
+			for (const auto& kv : keys) {
+				const size_t d = edit_distance(query, kv.first);
+				if (d <= max_edits) {
+					want.push_back(match {kv.first, kv.second, d});
+				}
+			}
+			std::vector<match> found;
+			const size_t n = trie.fuzzySearch(query, max_edits,
+				[&found] (const char* key, size_t length, int value, size_t distance) {
+					EXPECT_EQ(std::strlen(key), length);
+					found.push_back(match {key, value, distance});
+					return true;
+				});
+			EXPECT_EQ(n, found.size());
+			/* in the order of keys */
+			EXPECT_TRUE(found == want) << query << " " << max_edits << " " << found.size() << " " << want.size();
+		}
+	}
+
+	/* stop at the first match */
+	size_t calls = 0;
+	EXPECT_EQ(trie.fuzzySearch("12a1", 2, [&calls] (const char*, size_t, int, size_t) {
+		return ++calls < 1;
+	}), 1u);
+	EXPECT_EQ(calls, 1u);
+
+	trie_int_t empty;
+	EXPECT_EQ(empty.fuzzySearch("a", 2, [] (const char*, size_t, int, size_t) { return true; }), 0u);
+}
@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <cstring>
+
+#include <cedar_memory.h>
+
+/**
+ * Huge page mappings stay 2 MB aligned and keep their contents as they
+ * grow, whether in place or moved.
+ */
+TEST(cedar, huge_pages_grow) {
+	size_t len = 0;
+	char* p = static_cast<char*>(cedar::huge_pages_grow(0, len, 100));
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(len, cedar::HUGE_PAGE_SIZE);
+	std::memset(p, 'a', len);
+	/* fits in what is mapped */
+	EXPECT_EQ(cedar::huge_pages_grow(p, len, len), p);
+	for (size_t n = 2; n <= 8; n++) {
+		const size_t prev = len;
+		p = static_cast<char*>(cedar::huge_pages_grow(p, len,
+			n * cedar::HUGE_PAGE_SIZE - 1));
+		ASSERT_NE(p, nullptr);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % cedar::HUGE_PAGE_SIZE, 0u);
+		EXPECT_EQ(len, n * cedar::HUGE_PAGE_SIZE);
+		EXPECT_EQ(p[0], 'a');
+		EXPECT_EQ(p[prev - 1], n == 2 ? 'a' : static_cast<char>('a' + n - 2));
+		EXPECT_EQ(p[prev], 0); /* added bytes are zero */
+		std::memset(p + prev, 'a' + n - 1, len - prev);
+	}
+	munmap(p, len);
+}
+
+/**
+ * A trie gets all its memory from its allocator, and gives all of it back.
+ */
+TEST(cedar, counting_allocator) {
+	typedef cedar::counting_allocator<> allocator_type;
+	typedef cedar::da<int, -1, -2, true, 1, 0, allocator_type> trie_t;
+	trie_t trie;
+	EXPECT_GE(trie.allocator().allocated(), trie.capacity() * trie.unit_size());
+	char key[16];
+	for (int i = 0; i < 100000; i++) {
+		std::snprintf(key, sizeof(key), "%d", i * 7919);
+		trie.update(key, std::strlen(key), i);
+	}
+	const allocator_type& alloc = trie.allocator();
+	EXPECT_GE(alloc.allocated(), trie.capacity() * trie.unit_size());
+	EXPECT_GE(alloc.peak(), alloc.allocated());
+	for (int i = 0; i < 100000; i += 997) {
+		std::snprintf(key, sizeof(key), "%d", i * 7919);
+		EXPECT_EQ(trie.exactMatchSearch<int>(key), i);
+	}
+	/* so do the annotations of topKPredict (), which grow with the trie */
+	const size_t annotated = alloc.allocated();
+	trie_t::result_triple_type top[4];
+	EXPECT_EQ(trie.topKPredict("1", top, 4), 4u);
+	EXPECT_GE(alloc.allocated(), annotated + trie.size() * sizeof(int));
+	trie.update("1x", 2, 1);
+	trie.clear(false);
+	EXPECT_EQ(alloc.allocated(), 0u);
+}
+
+/**
+ * Tries on huge pages behave the same whatever the default allocator is.
+ */
+TEST(cedar, huge_page_allocator) {
+	cedar::da<int, -1, -2, true, 1, 0, cedar::huge_page_allocator> trie;
+	char key[16];
+	for (int i = 0; i < 200000; i++) {
+		std::snprintf(key, sizeof(key), "k%d", i);
+		trie.update(key, std::strlen(key), i);
+	}
+	EXPECT_EQ(trie.num_keys(), 200000u);
+	for (int i = 0; i < 200000; i += 101) {
+		std::snprintf(key, sizeof(key), "k%d", i);
+		EXPECT_EQ(trie.exactMatchSearch<int>(key), i);
+	}
+}
+
+/**
+ * Blocks of reserved_allocator grow in place within their reservation,
+ * and keep their contents when they outgrow it or shrink.
+ */
+TEST(cedar, reserved_allocator) {
+	cedar::reserved_allocator alloc(4 * cedar::HUGE_PAGE_SIZE);
+	size_t n = 1000;
+	char* p = static_cast<char*>(alloc.allocate(n));
+	ASSERT_NE(p, nullptr);
+	std::memset(p, 'a', n);
+	char* const q = static_cast<char*>(alloc.reallocate(p, n, 4 * cedar::HUGE_PAGE_SIZE));
+	ASSERT_NE(q, nullptr);
+	EXPECT_EQ(q[n - 1], 'a');
+	n = 4 * cedar::HUGE_PAGE_SIZE;
+	std::memset(q, 'b', n);
+	for (size_t m = n - 100; m > cedar::HUGE_PAGE_SIZE; m -= cedar::HUGE_PAGE_SIZE) {
+		/* within the reservation */
+		EXPECT_EQ(alloc.reallocate(q, n, m), q);
+		EXPECT_EQ(alloc.reallocate(q, m, n), q);
+	}
+	EXPECT_EQ(q[0], 'b');
+	EXPECT_EQ(q[n - 1], 0); /* the last page was given back */
+	q[n - 1] = 'b';
+	/* beyond the reservation */
+	p = static_cast<char*>(alloc.reallocate(q, n, 3 * n));
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(p[0], 'b');
+	EXPECT_EQ(p[n - 1], 'b');
+	EXPECT_EQ(p[3 * n - 1], 0);
+	p = static_cast<char*>(alloc.reallocate(p, 3 * n, 100));
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(p[99], 'b');
+	alloc.deallocate(p, 100);
+
+	/* a trie whose array outgrows a reservation of two huge pages */
+	cedar::da<int, -1, -2, true, 1, 0, cedar::reserved_allocator> trie(
+		cedar::reserved_allocator(2 * cedar::HUGE_PAGE_SIZE));
+	char key[24]; /* "r" and up to 20 digits */
+	for (int i = 0; i < 300000; i++) {
+		std::snprintf(key, sizeof(key), "r%zu", static_cast<size_t>(i) * 7919);
+		trie.update(key, std::strlen(key), i);
+	}
+	EXPECT_GT(trie.capacity() * trie.unit_size(), 2 * cedar::HUGE_PAGE_SIZE);
+	for (int i = 0; i < 300000; i += 97) {
+		std::snprintf(key, sizeof(key), "r%zu", static_cast<size_t>(i) * 7919);
+		EXPECT_EQ(trie.exactMatchSearch<int>(key), i);
+	}
+}
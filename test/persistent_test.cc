@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+/**
+ * A trie kept by open_persistent () grows in its file and survives
+ * reopening without save ().
+ */
+TEST(cedar, open_persistent) {
+	typedef cedar::da<int> trie_t;
+	const std::string file = ::testing::TempDir() + "cedar_persistent_test." + std::to_string(getpid()) + ".trie";
+	const std::string saved = ::testing::TempDir() + "cedar_persistent_test_saved." + std::to_string(getpid()) + ".trie";
+	std::remove(file.c_str());
+
+	auto key_of = [] (int i) { return "persistent" + std::to_string(i); };
+	{
+		trie_t trie;
+		trie.update("before", 6, 1);
+		ASSERT_EQ(trie.open_persistent(file.c_str()), 0);
+		EXPECT_TRUE(trie.persistent());
+		EXPECT_EQ(trie.exactMatchSearch<int>("before"), 1);
+		/* grow the file a few times */
+		for (int i = 0; i < 20000; i++) {
+			const std::string key = key_of(i);
+			trie.update(key.c_str(), key.length(), i);
+		}
+		EXPECT_EQ(trie.sync(), 0);
+		trie.update("after sync", 10, 2);
+	}
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open_persistent(file.c_str()), 0);
+		EXPECT_EQ(trie.num_keys(), 20002u);
+		EXPECT_EQ(trie.exactMatchSearch<int>("after sync"), 2);
+		for (int i = 0; i < 20000; i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(key_of(i).c_str()), i);
+		}
+		EXPECT_EQ(trie.erase("before"), 0);
+		for (int i = 20000; i < 40000; i++) {
+			const std::string key = key_of(i);
+			trie.update(key.c_str(), key.length(), i);
+		}
+	}
+	{
+		/* the file stays readable as an ordinary trie file */
+		trie_t trie;
+		ASSERT_EQ(trie.open(file.c_str()), 0);
+		EXPECT_FALSE(trie.persistent());
+		EXPECT_EQ(trie.num_keys(), 40001u);
+		EXPECT_EQ(trie.exactMatchSearch<int>("before"), trie_t::CEDAR_NO_VALUE);
+		for (int i = 0; i < 40000; i++) {
+			EXPECT_EQ(trie.exactMatchSearch<int>(key_of(i).c_str()), i);
+		}
+		ASSERT_EQ(trie.save(saved.c_str()), 0);
+	}
+	{
+		/* and a file written by save () can be kept persistent */
+		trie_t trie;
+		ASSERT_EQ(trie.open_persistent(saved.c_str()), 0);
+		trie.update("grown", 5, 7);
+		EXPECT_EQ(trie.num_keys(), 40002u);
+	}
+	{
+		trie_t trie;
+		ASSERT_EQ(trie.open_with_mmap(saved.c_str()), 0);
+		EXPECT_EQ(trie.exactMatchSearch<int>("grown"), 7);
+		EXPECT_EQ(trie.exactMatchSearch<int>(key_of(39999).c_str()), 39999);
+	}
+	std::remove(file.c_str());
+	std::remove(saved.c_str());
+}
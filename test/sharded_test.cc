@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cedar_sharded.h>
+
+/**
+ * Threads insert disjoint sets of keys into a sharded trie; every key must
+ * then be found, prefix search must stay within a shard, and for_each ()
+ * must visit keys in lexicographic order.
+ */
+TEST(cedar, sharded_multi_threaded_update) {
+	typedef cedar::sharded_da<int, 8> sharded_trie_t;
+	sharded_trie_t trie;
+
+	constexpr int kNumKeys = 50000;
+	constexpr int kNumThreads = 4;
+	std::vector<std::string> keys;
+	for (int i = 0; i < kNumKeys; i++) {
+		keys.emplace_back(std::string(1, static_cast<char>('a' + i % 26)) +
+			std::to_string(i));
+	}
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < kNumThreads; t++) {
+		threads.emplace_back([&, t] () {
+			for (int i = t; i < kNumKeys; i += kNumThreads) {
+				trie.update(keys[i].c_str(), keys[i].length(), i + 1);
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(trie.num_keys(), static_cast<size_t>(kNumKeys));
+	for (int i = 0; i < kNumKeys; i++) {
+		EXPECT_EQ(trie.exactMatchSearch<int>(keys[i].c_str()), i + 1);
+	}
+	EXPECT_EQ(trie.exactMatchSearch<int>("zz"), sharded_trie_t::CEDAR_NO_VALUE);
+
+	/* "b27" is the only other key that prefixes "b2731" */
+	sharded_trie_t::result_pair_type result[4];
+	auto n = trie.commonPrefixSearch("b2731", result, 4);
+	ASSERT_EQ(n, 2u);
+	EXPECT_EQ(result[0].value, 28);
+	EXPECT_EQ(result[0].length, 3u);
+	EXPECT_EQ(result[1].value, 2732);
+	EXPECT_EQ(result[1].length, 5u);
+
+	std::vector<std::string> visited;
+	trie.for_each([&] (const char* key, size_t len, int value) {
+		visited.emplace_back(key, len);
+		EXPECT_EQ(keys[value - 1], visited.back());
+	});
+	std::sort(keys.begin(), keys.end());
+	EXPECT_EQ(visited, keys);
+
+	EXPECT_EQ(trie.erase("b1"), 0);
+	EXPECT_EQ(trie.exactMatchSearch<int>("b1"), sharded_trie_t::CEDAR_NO_VALUE);
+	EXPECT_EQ(trie.num_keys(), static_cast<size_t>(kNumKeys - 1));
+}
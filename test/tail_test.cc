@@ -0,0 +1,66 @@
+#include <map>
+#include <string>
+
+#include <cedar_simd.h>
+
+/**
+ * tail_mismatch () agrees with the plain loop for every length and position
+ * of the first difference, whichever kernel the processor runs
+ */
+TEST(cedar, tail_kernels) {
+	char a[160], b[160];
+	for (size_t i = 0; i < sizeof(a); i++) {
+		a[i] = b[i] = static_cast<char>('a' + i % 26);
+	}
+	for (size_t n = 0; n <= 100; n++) {
+		const size_t at = 30; /* not aligned */
+		EXPECT_EQ(cedar::tail_mismatch(a + at, b + at, n), n);
+		for (size_t i = 0; i < n; i++) {
+			b[at + i] = '#';
+			EXPECT_EQ(cedar::tail_mismatch(a + at, b + at, n), i);
+			EXPECT_EQ(cedar::tail_mismatch(a + at, b + at, n), cedar::mismatch_scalar(a + at, b + at, n));
+			b[at + i] = a[at + i];
+		}
+	}
+}
+
+/**
+ * keys with long suffixes, as URLs have, are found, and keys that leave
+ * them at any byte are not
+ */
+TEST(cedar, long_tails) {
+	cedar::da<int> trie;
+	std::map<std::string, int> keys;
+	for (int i = 0; i < 200; i++) {
+		const std::string key = "http://" + std::to_string(i * 7919 % 211) +
+			".example.com/a/rather/long/path/to/some/page/" + std::string(i % 50, 'x') + ".html";
+		keys[key] = i;
+		trie.update(key.c_str(), key.length(), i);
+	}
+	for (const auto& kv : keys) {
+		const std::string& key = kv.first;
+		EXPECT_EQ(trie.exactMatchSearch<int>(key.c_str(), key.length()), kv.second);
+		for (size_t i = 8; i < key.length(); i += 3) {
+			std::string other = key;
+			other[i] = '#';
+			EXPECT_EQ(trie.exactMatchSearch<int>(other.c_str(), other.length()), -1);
+			/* a prefix of a key is not a key */
+			EXPECT_EQ(trie.exactMatchSearch<int>(key.c_str(), i), -1);
+		}
+	}
+	/* keys that end within a tail split it */
+	for (const auto& kv : keys) {
+		const std::string key = kv.first.substr(0, kv.first.length() - 5);
+		trie.update(key.c_str(), key.length(), 1000);
+		EXPECT_EQ(trie.exactMatchSearch<int>(key.c_str(), key.length()), 1000);
+		EXPECT_EQ(trie.exactMatchSearch<int>(kv.first.c_str(), kv.first.length()), kv.second);
+	}
+	size_t n = 0;
+	for (auto it = trie.begin(); it != trie.end(); ++it) {
+		const std::string key(it->key, it->length);
+		EXPECT_EQ(trie.exactMatchSearch<int>(key.c_str(), key.length()), it->value);
+		n++;
+	}
+	EXPECT_EQ(n, keys.size() * 2);
+	EXPECT_EQ(trie.num_keys(), n);
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * topKPredict () returns the completions of commonPrefixPredict () with
+ * the largest values, and keeps doing so as values change, keys go and
+ * nodes move.
+ */
+TEST(cedar, top_k_predict) {
+	typedef cedar::da<int> trie_t;
+	trie_t trie;
+	std::map<std::string, int> keys;
+	for (int i = 0; i < 20000; i++) {
+		const std::string key = "q" + std::to_string(i * 7919 % 20011);
+		keys[key] = i * 7919 % 10007;
+	}
+
+	/* the values of the k largest completions, by sorting all of them */
+	auto expect_top = [&trie] (const char* prefix, size_t k) {
+		std::vector<trie_t::result_triple_type> all(65536);
+		const size_t n = std::min(trie.commonPrefixPredict(prefix, all.data(), all.size()), all.size());
+		std::vector<int> want;
+		for (size_t i = 0; i < n; i++) {
+			want.push_back(all[i].value);
+		}
+		std::sort(want.begin(), want.end(), std::greater<int>());
+		want.resize(std::min(n, k));
+
+		std::vector<trie_t::result_triple_type> top(k + 1);
+		const size_t m = trie.topKPredict(prefix, top.data(), k);
+		ASSERT_EQ(m, want.size()) << prefix;
+		for (size_t i = 0; i < m; i++) {
+			EXPECT_EQ(top[i].value, want[i]) << prefix << " " << i;
+			/* the completion ends where the result says */
+			size_t from = top[i].id;
+			EXPECT_EQ(trie.exactMatchSearch<int>("", 0, from), top[i].value);
+		}
+	};
+	auto expect_all = [&expect_top] () {
+		for (const char* prefix : {"", "q", "q1", "q12", "q123", "q1234", "q12345", "x"}) {
+			for (size_t k : {1, 3, 10, 100}) {
+				expect_top(prefix, k);
+			}
+		}
+	};
+
+	/* the first call annotates the trie */
+	for (const auto& kv : keys) {
+		trie.update(kv.first.c_str(), kv.first.length(), kv.second);
+	}
+	expect_all();
+
+	/* updates that raise and lower values, and new keys, which relocate nodes */
+	for (int i = 0; i < 20000; i += 7) {
+		const std::string key = "q" + std::to_string(i * 7919 % 20011);
+		trie.update(key.c_str(), key.length(), i % 2 ? 5000 : 0);
+		const std::string longer = key + "x" + std::to_string(i);
+		trie.update(longer.c_str(), longer.length(), i % 20000);
+	}
+	expect_all();
+
+	/* keys that held the largest values go */
+	for (int i = 0; i < 20000; i += 3) {
+		const std::string key = "q" + std::to_string(i * 7919 % 20011);
+		trie.erase(key.c_str());
+	}
+	expect_all();
+
+	trie.compact_step(8);
+	expect_all();
+	trie.compact();
+	expect_all();
+
+	trie.clear();
+	trie_t::result_triple_type r[1];
+	EXPECT_EQ(trie.topKPredict("", r, 1), 0u);
+	trie.update("a", 1, 7);
+	EXPECT_EQ(trie.topKPredict("", r, 1), 1u);
+	EXPECT_EQ(r[0].value, 7);
+	EXPECT_EQ(r[0].length, 1u);
+	EXPECT_EQ(trie.topKPredict("a", r, 0), 0u);
+}